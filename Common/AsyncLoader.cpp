@@ -0,0 +1,166 @@
+/*
+** 异步加载
+**
+** author : gouki04 2011-12-30
+*/
+
+#include "AsyncLoader.h"
+
+#include <stdio.h>
+
+AsyncLoader::AsyncLoader(int workerCount) : totalJobs(0), finishedJobs(0)
+{
+    if (workerCount < 1)
+        workerCount = 1;
+
+    for (int i = 0; i < workerCount; ++i)
+    {
+        Worker* worker = new Worker;
+        worker->loader = this;
+        worker->index = i;
+        worker->active = false;
+        workers.push_back(worker);
+    }
+
+    uploading.job = 0;
+    uploading.ok = false;
+}
+
+AsyncLoader::~AsyncLoader()
+{
+    {
+        ScopedLock lock(mutex);
+        for (size_t i = 0; i < pending.size(); ++i)
+            delete pending[i];
+        pending.clear();
+    }
+
+    // 正在执行的 load() 无法打断，只能等它结束
+    for (size_t i = 0; i < workers.size(); ++i)
+    {
+        workers[i]->thread.join();
+        delete workers[i];
+    }
+
+    for (size_t i = 0; i < loaded.size(); ++i)
+        delete loaded[i].job;
+
+    delete uploading.job;
+}
+
+void AsyncLoader::submit(LoadJob* job)
+{
+    // 上一批已经全部完成，进度从头算
+    if (!busy())
+        totalJobs = finishedJobs = 0;
+
+    ++totalJobs;
+
+    {
+        ScopedLock lock(mutex);
+        pending.push_back(job);
+    }
+
+    startWorkers();
+}
+
+void AsyncLoader::startWorkers()
+{
+    ScopedLock lock(mutex);
+
+    // 队列空了工作线程就会退出，有新任务时重新启动空闲的线程
+    size_t wanted = pending.size();
+    for (size_t i = 0; i < workers.size() && wanted > 0; ++i)
+    {
+        Worker* worker = workers[i];
+        if (worker->active)
+        {
+            --wanted;
+            continue;
+        }
+
+        // 线程在置 active 为 false 之后就不再持有锁，这里的 join 不会死锁
+        worker->thread.join();
+        worker->active = worker->thread.start(workerMain, worker);
+        if (worker->active)
+            --wanted;
+    }
+}
+
+void AsyncLoader::workerMain(void* arg)
+{
+    Worker* worker = static_cast<Worker*>(arg);
+    AsyncLoader* loader = worker->loader;
+
+    char name[32];
+    sprintf(name, "loader %d", worker->index);
+    TraceRecorder::setThreadName(name);
+
+    for (;;)
+    {
+        LoadJob* job;
+        {
+            ScopedLock lock(loader->mutex);
+            if (loader->pending.empty())
+            {
+                worker->active = false;
+                TraceRecorder::threadExit();
+                return;
+            }
+
+            job = loader->pending.front();
+            loader->pending.pop_front();
+        }
+
+        Loaded result;
+        result.job = job;
+        {
+            TRACE_SCOPE("load job");
+            result.ok = job->load();
+        }
+
+        ScopedLock lock(loader->mutex);
+        loader->loaded.push_back(result);
+    }
+}
+
+void AsyncLoader::update(double budget)
+{
+    double start = getTicks();
+
+    do
+    {
+        if (!uploading.job)
+        {
+            ScopedLock lock(mutex);
+            if (loaded.empty())
+                break;
+
+            uploading = loaded.front();
+            loaded.pop_front();
+        }
+
+        TRACE_SCOPE("upload job");
+
+        bool done = true;
+        if (uploading.ok)
+            done = uploading.job->upload();
+        else
+            uploading.job->fail();
+
+        if (done)
+        {
+            delete uploading.job;
+            uploading.job = 0;
+            ++finishedJobs;
+        }
+    } while (getTicks() - start < budget);
+}
+
+float AsyncLoader::progress() const
+{
+    if (totalJobs == 0)
+        return 1.0f;
+
+    return static_cast<float>(finishedJobs) / static_cast<float>(totalJobs);
+}
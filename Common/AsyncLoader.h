@@ -0,0 +1,87 @@
+/*
+** 异步加载
+** 每个加载任务分两步：load() 在工作线程中读文件、解析数据，不能调用任何图形接口；
+** upload() 在主线程中把结果交给显卡，每次只做一小步，由 update() 按时间预算分摊到多帧。
+**
+** HGE 的 Resource_Load 内部共用一个路径缓冲区，加载期间主线程不要再按文件名读资源
+** （Texture_Load 从内存读入不受影响）。
+**
+** author : gouki04 2011-12-30
+*/
+
+#ifndef ASYNCLOADER_H
+#define ASYNCLOADER_H
+
+#include <deque>
+#include <vector>
+
+#include "Platform.h"
+#include "TraceRecorder.h"
+
+class LoadJob
+{
+public:
+    virtual ~LoadJob() {}
+
+    // 工作线程中执行，失败时返回 false
+    virtual bool load() = 0;
+
+    // 主线程中执行一步，全部完成时返回 true
+    virtual bool upload() = 0;
+
+    // load() 失败时在主线程中调用
+    virtual void fail() {}
+};
+
+class AsyncLoader
+{
+public:
+    explicit AsyncLoader(int workerCount = 2);
+
+    // 丢弃还没有完成的任务，等待工作线程结束
+    ~AsyncLoader();
+
+    // 提交任务，任务由加载器负责释放
+    void submit(LoadJob* job);
+
+    // 主线程每帧调用，在 budget 秒内执行上传，至少执行一步
+    void update(double budget);
+
+    bool busy() const { return finishedJobs < totalJobs; }
+
+    // 当前这一批任务的完成比例
+    float progress() const;
+
+private:
+    AsyncLoader(const AsyncLoader&);
+    AsyncLoader& operator=(const AsyncLoader&);
+
+    struct Worker
+    {
+        AsyncLoader* loader;
+        int index;
+        Thread thread;
+        bool active;
+    };
+
+    struct Loaded
+    {
+        LoadJob* job;
+        bool ok;
+    };
+
+    static void workerMain(void* arg);
+
+    void startWorkers();
+
+    Mutex mutex;
+    std::deque<LoadJob*> pending;   // 等待工作线程读入
+    std::deque<Loaded> loaded;      // 等待主线程上传
+    std::vector<Worker*> workers;
+
+    // 以下只在主线程中访问
+    Loaded uploading;
+    int totalJobs, finishedJobs;
+};
+
+#endif
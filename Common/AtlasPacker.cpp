@@ -0,0 +1,154 @@
+/*
+** 纹理图集打包
+**
+** author : gouki04 2011-12-30
+*/
+
+#include "AtlasPacker.h"
+
+#include <algorithm>
+#include <math.h>
+
+namespace
+{
+    int nextPowerOfTwo(int n)
+    {
+        int p = 1;
+        while (p < n) p <<= 1;
+        return p;
+    }
+
+    struct TallerFirst
+    {
+        const std::vector<AtlasRect>* rects;
+
+        bool operator()(int a, int b) const
+        {
+            const AtlasRect& ra = (*rects)[a];
+            const AtlasRect& rb = (*rects)[b];
+            if (ra.h != rb.h) return ra.h > rb.h;
+            if (ra.w != rb.w) return ra.w > rb.w;
+            return a < b;
+        }
+    };
+}
+
+AtlasPacker::AtlasPacker(int maxPageSize, int padding) : maxSize(maxPageSize), pad(padding)
+{
+}
+
+void AtlasPacker::clear()
+{
+    rects.clear();
+    pages.clear();
+}
+
+int AtlasPacker::add(int w, int h)
+{
+    AtlasRect rect = { -1, 0, 0, w, h };
+    rects.push_back(rect);
+    return static_cast<int>(rects.size()) - 1;
+}
+
+bool AtlasPacker::pack()
+{
+    pages.clear();
+    if (rects.empty())
+        return true;
+
+    std::vector<int> order(rects.size());
+    int maxWidth = 0;
+    double area = 0;
+
+    for (size_t i = 0; i < rects.size(); ++i)
+    {
+        order[i] = static_cast<int>(i);
+
+        int w = rects[i].w + pad * 2;
+        int h = rects[i].h + pad * 2;
+        if (w > maxSize || h > maxSize || rects[i].w <= 0 || rects[i].h <= 0)
+            return false;
+
+        if (w > maxWidth) maxWidth = w;
+        area += static_cast<double>(w) * h;
+    }
+
+    TallerFirst cmp;
+    cmp.rects = &rects;
+    std::sort(order.begin(), order.end(), cmp);
+
+    // 页宽取能容纳所有小图的最小的2的幂，高度按实际用到的行数决定
+    int width = nextPowerOfTwo(static_cast<int>(ceil(sqrt(area))));
+    if (width < nextPowerOfTwo(maxWidth)) width = nextPowerOfTwo(maxWidth);
+    if (width > maxSize) width = maxSize;
+
+    int page = 0, x = 0, y = 0, shelfHeight = 0;
+    Page current = { width, 0 };
+
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        AtlasRect& rect = rects[order[i]];
+        int w = rect.w + pad * 2;
+        int h = rect.h + pad * 2;
+
+        // 当前行放不下，换行
+        if (x + w > width)
+        {
+            y += shelfHeight;
+            x = 0;
+            shelfHeight = 0;
+        }
+
+        // 当前页放不下，换页
+        if (y + h > maxSize)
+        {
+            current.height = nextPowerOfTwo(y);
+            pages.push_back(current);
+
+            ++page;
+            x = y = shelfHeight = 0;
+        }
+
+        rect.page = page;
+        rect.x = x + pad;
+        rect.y = y + pad;
+
+        x += w;
+        if (h > shelfHeight) shelfHeight = h;
+    }
+
+    current.height = nextPowerOfTwo(y + shelfHeight);
+    pages.push_back(current);
+
+    return true;
+}
+
+void AtlasPacker::restore(const AtlasRect* packed, int n, const int* pageSizes, int pageCount)
+{
+    rects.assign(packed, packed + n);
+
+    pages.resize(pageCount);
+    for (int i = 0; i < pageCount; ++i)
+    {
+        pages[i].width = pageSizes[i * 2];
+        pages[i].height = pageSizes[i * 2 + 1];
+    }
+}
+
+void AtlasPacker::blit(int id, const AtlasPixel* src, int srcPitch, AtlasPixel* page, int pagePitch) const
+{
+    const AtlasRect& rect = rects[id];
+
+    for (int y = -pad; y < rect.h + pad; ++y)
+    {
+        int sy = y < 0 ? 0 : (y >= rect.h ? rect.h - 1 : y);
+        const AtlasPixel* srcRow = src + sy * srcPitch;
+        AtlasPixel* dstRow = page + (rect.y + y) * pagePitch + rect.x;
+
+        for (int x = -pad; x < rect.w + pad; ++x)
+        {
+            int sx = x < 0 ? 0 : (x >= rect.w ? rect.w - 1 : x);
+            dstRow[x] = srcRow[sx];
+        }
+    }
+}
@@ -0,0 +1,67 @@
+/*
+** 纹理图集打包
+** 把许多小图（地图元件、高亮框……）排进尽量少的大纹理页中，
+** 每张小图四周留出 padding 像素，并用边缘像素填满，防止纹理过滤时相邻元件串色。
+**
+** 这里只负责排布和像素拷贝，不依赖HGE，离线工具也可以直接使用。
+**
+** author : gouki04 2011-12-30
+*/
+
+#ifndef ATLASPACKER_H
+#define ATLASPACKER_H
+
+#include <vector>
+
+// 32位ARGB像素
+typedef unsigned int AtlasPixel;
+
+// 小图在图集中的位置（不含四周的边距）
+struct AtlasRect
+{
+    int page;
+    int x, y, w, h;
+};
+
+class AtlasPacker
+{
+public:
+    AtlasPacker(int maxPageSize = 2048, int padding = 2);
+
+    void clear();
+
+    // 添加一张 w*h 的小图，返回编号，pack() 之后才有位置
+    int add(int w, int h);
+
+    // 按高度从大到小逐行排布，一页放不下时新开一页
+    bool pack();
+
+    // 直接恢复之前打包好的结果（从缓存读入时用）
+    void restore(const AtlasRect* packed, int n, const int* pageSizes, int pageCount);
+
+    int count() const { return static_cast<int>(rects.size()); }
+    const AtlasRect& rect(int id) const { return rects[id]; }
+
+    int pageCount() const { return static_cast<int>(pages.size()); }
+    int padding() const { return pad; }
+    int pageWidth(int page) const { return pages[page].width; }
+    int pageHeight(int page) const { return pages[page].height; }
+
+    // 把小图像素拷到页面上对应的位置，并向四周扩展边缘像素
+    // srcPitch 和 pagePitch 以像素为单位
+    void blit(int id, const AtlasPixel* src, int srcPitch, AtlasPixel* page, int pagePitch) const;
+
+private:
+    struct Page
+    {
+        int width, height;
+    };
+
+    int maxSize;
+    int pad;
+
+    std::vector<AtlasRect> rects;
+    std::vector<Page> pages;
+};
+
+#endif
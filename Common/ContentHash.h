@@ -0,0 +1,28 @@
+/*
+** 按内容计算的64位哈希（FNV-1a），用于内容寻址和缓存校验
+**
+** author : gouki04 2011-12-30
+*/
+
+#ifndef CONTENTHASH_H
+#define CONTENTHASH_H
+
+#include <stddef.h>
+
+typedef unsigned long long ContentHash;
+
+#define CONTENT_HASH_SEED 14695981039346656037ULL
+
+// h 用于把多段数据接起来计算
+inline ContentHash hashBytes(const void* data, size_t size, ContentHash h = CONTENT_HASH_SEED)
+{
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i)
+    {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+#endif
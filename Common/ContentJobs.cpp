@@ -0,0 +1,87 @@
+/*
+** 编辑器用到的异步加载任务
+**
+** author : gouki04 2011-12-30
+*/
+
+#include "ContentJobs.h"
+
+HGE* AtlasJob::hge = 0;
+
+AtlasJob::AtlasJob(TileAtlas& a, const char* path, void (*func)(bool))
+    : atlas(a), cachePath(path ? path : ""), useCache(path != 0), cached(false), start(getTicks()), done(func)
+{
+    hge = hgeCreate(HGE_VERSION);
+}
+
+AtlasJob::~AtlasJob()
+{
+    hge->Release();
+}
+
+bool AtlasJob::load()
+{
+    // 读不到源图片时 build() 会再按文件名试一次，并在那里报告失败
+    cached = atlas.prepare(useCache ? cachePath.c_str() : 0);
+    return true;
+}
+
+bool AtlasJob::upload()
+{
+    bool ok;
+
+    if (cached)
+    {
+        // 命中缓存时每次只上传一页
+        ok = atlas.uploadPage();
+        if (ok && atlas.pagesPending())
+            return false;
+    }
+    else
+    {
+        ok = atlas.build();
+        if (ok && useCache)
+            atlas.saveCache(cachePath.c_str());
+    }
+
+    hge->System_Log("atlas loaded from %s in %.2f ms", cached ? "cache" : "png", (getTicks() - start) * 1000.0);
+
+    done(ok);
+    return true;
+}
+
+void AtlasJob::fail()
+{
+    done(false);
+}
+
+MapJob::MapJob(const char* file, const TileGraphics& graphics, int originX, int originY, void (*func)(TileEditor*))
+    : path(file), editor(0), done(func)
+{
+    // 文件头很小，直接在主线程读入并创建对应格式的编辑器，工作线程只负责读地图数据
+    editor = createTileEditorFor(file, graphics, originX, originY);
+}
+
+MapJob::~MapJob()
+{
+    delete editor;
+}
+
+bool MapJob::load()
+{
+    return editor && editor->load(path.c_str());
+}
+
+bool MapJob::upload()
+{
+    TileEditor* loaded = editor;
+    editor = 0;
+
+    done(loaded);
+    return true;
+}
+
+void MapJob::fail()
+{
+    done(0);
+}
@@ -0,0 +1,61 @@
+/*
+** 编辑器用到的异步加载任务
+** AtlasJob：工作线程读入源图片和图集缓存，主线程逐页上传；没有有效缓存时在主线程打包并写缓存。
+** MapJob：工作线程读入地图存档，主线程替换编辑器，地图块的渲染缓存之后按需重绘。
+**
+** author : gouki04 2011-12-30
+*/
+
+#ifndef CONTENTJOBS_H
+#define CONTENTJOBS_H
+
+#include "..\hge\hge.h"
+
+#include <string>
+
+#include "AsyncLoader.h"
+#include "TileAtlas.h"
+#include "TileEditor.h"
+
+class AtlasJob : public LoadJob
+{
+public:
+    // cachePath 为 0 时不使用缓存，每次都从PNG打包
+    // 图集可以使用（或者确定加载失败）时在主线程调用 done
+    AtlasJob(TileAtlas& atlas, const char* cachePath, void (*done)(bool ok));
+    virtual ~AtlasJob();
+
+    virtual bool load();
+    virtual bool upload();
+    virtual void fail();
+
+private:
+    static HGE* hge;
+
+    TileAtlas& atlas;
+    std::string cachePath;
+    bool useCache;
+    bool cached;
+    double start;
+    void (*done)(bool ok);
+};
+
+class MapJob : public LoadJob
+{
+public:
+    // 读入成功时把新的编辑器交给 done，由调用者负责释放；失败时传入 0
+    MapJob(const char* path, const TileGraphics& graphics, int originX, int originY,
+           void (*done)(TileEditor* editor));
+    virtual ~MapJob();
+
+    virtual bool load();
+    virtual bool upload();
+    virtual void fail();
+
+private:
+    std::string path;
+    TileEditor* editor;
+    void (*done)(TileEditor* editor);
+};
+
+#endif
@@ -0,0 +1,31 @@
+/*
+** 输入对应的编辑操作
+**
+** author : gouki04 2011-12-30
+*/
+
+#include "EditInput.h"
+#include "TileAutomaton.h"
+
+EditActions EditInput::actions(const InputFrame& frame)
+{
+    EditActions a;
+    a.toggleChunkCache = frame.key == EDIT_KEY_CHUNK_CACHE;
+    a.zoom = frame.key == EDIT_KEY_ZOOM_OUT ? 1 : frame.key == EDIT_KEY_ZOOM_IN ? -1 : 0;
+
+    a.generate = frame.key == EDIT_KEY_GENERATE;
+    if (a.generate)
+    {
+        a.noise = TerrainNoise(++terrainSeed);
+        a.noise.wavelength = EDIT_TERRAIN_WAVELENGTH;
+        a.noise.octaves = EDIT_TERRAIN_OCTAVES;
+    }
+
+    a.rule = frame.key == EDIT_KEY_SMOOTH ? AUTOMATON_SMOOTH : frame.key == EDIT_KEY_ERODE ? AUTOMATON_ERODE
+        : frame.key == EDIT_KEY_GROW ? AUTOMATON_GROW : -1;
+
+    a.mouseX = frame.mouseX;
+    a.mouseY = frame.mouseY;
+    a.stamp = (frame.buttons & INPUT_LBUTTON) ? 1 : (frame.buttons & INPUT_RBUTTON) ? 0 : -1;
+    return a;
+}
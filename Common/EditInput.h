@@ -0,0 +1,53 @@
+/*
+** 输入对应的编辑操作
+** 编辑器每帧把输入整理成一个 InputFrame（录制的也是它），由 EditInput 换算成这一帧要执行的编辑操作；
+** TileBench replay 对记录的每一帧用同一个 EditInput 换算，按键的解释、执行顺序和地形种子只有这一份，
+** 回放不会和编辑器各自解释输入。
+** 只包括影响地图内容和绘制结果的操作，保存、读取、性能面板等按键只在编辑器中处理。
+**
+** author : gouki04 2011-12-30
+*/
+
+#ifndef EDITINPUT_H
+#define EDITINPUT_H
+
+#include "InputTrace.h"
+#include "TileGen.h"
+
+// 编辑按键的 HGE 键码，TileBench 不依赖 HGE，这里直接写数值
+#define EDIT_KEY_CHUNK_CACHE 0x43   // HGEK_C，切换块缓存
+#define EDIT_KEY_ZOOM_OUT 0x5A      // HGEK_Z，缩小
+#define EDIT_KEY_ZOOM_IN 0x58       // HGEK_X，放大
+#define EDIT_KEY_GENERATE 0x4E      // HGEK_N，程序生成地形
+#define EDIT_KEY_SMOOTH 0x4D        // HGEK_M，元胞自动机平滑一步
+#define EDIT_KEY_ERODE 0x45         // HGEK_E，侵蚀一步
+#define EDIT_KEY_GROW 0x46          // HGEK_F，生长一步
+
+#define EDIT_TERRAIN_WAVELENGTH 8   // 生成地形的噪声参数
+#define EDIT_TERRAIN_OCTAVES 2
+
+// 一帧的编辑操作，按成员的顺序执行
+struct EditActions
+{
+    bool toggleChunkCache;
+    int zoom;               // 缩放级数的变化：1 缩小，-1 放大，0 不变
+    bool generate;          // 用 noise 重新生成整张地图
+    TerrainNoise noise;
+    int rule;               // 执行一步元胞自动机的规则 AUTOMATON_*，没有时为 -1
+    int mouseX, mouseY;     // 选中元件的鼠标位置
+    int stamp;              // 在选中的元件上 1 绘制，0 清除，-1 不动
+};
+
+class EditInput
+{
+public:
+    EditInput() : terrainSeed(0) {}
+
+    // 换算一帧的输入，按N时依次取种子1、2、3……
+    EditActions actions(const InputFrame& frame);
+
+private:
+    unsigned int terrainSeed;
+};
+
+#endif
@@ -0,0 +1,487 @@
+/*
+** 编辑器程序
+**
+** author : gouki04 2011-12-30
+*/
+
+#include "EditorApp.h"
+#include "ContentJobs.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define SAFE_DELETE(T) { if (T) { delete T; T = 0; } }
+
+#define HIGHLIGHT_TEX_FILE "highlight.png"  // 高亮框图片
+#define ATLAS_CACHE_FILE "tiles.atlascache" // 打包好的图集缓存
+#define RESOURCE_PACK "AutoTile.paq"        // 资源包，存在时优先从包里读图片
+#define HUD_FONT_FILE "font1.fnt"           // 性能面板字体
+#define TRACE_FILE "trace.json"             // 按T输出的时间线
+#define INPUT_TRACE_FILE "session.input"    // 命令行加 -record 时记录的输入
+#define LOG_FILE "AutoTileEditor.log"
+
+#define MAP_LT_X 0  // 地图左上角x坐标
+#define MAP_LT_Y 0  // 地图左上角y坐标
+
+#define LOAD_WORKERS 2      // 加载线程数
+#define LOAD_BUDGET 0.004   // 每帧用于上传资源的时间（秒）
+
+#define TRACE_HITCH_TIME 0.05   // 一帧超过这个时间（秒）时自动输出时间线
+#define TRACE_HITCH_GAP 5.0     // 两次自动输出至少间隔多少秒
+
+#define MINIMAP_DISPLAY_SIZE 128    // 小地图在屏幕上的最大边长
+
+namespace
+{
+    const char* phaseNames[] = { "load", "input", "stamp", "commit", "cache", "map", "overlay", "minimap" };
+}
+
+EditorApp* EditorApp::app = 0;
+
+EditorApp::EditorApp(const EditorAppConfig& c)
+    : config(c),
+      screenWidth(MAP_LT_X + (c.cols << c.tileShift)),
+      screenHeight(MAP_LT_Y + (c.rows << c.tileShift)),
+      highlight(0), useAtlasCache(true), useEditThread(true),
+      firstTile(0), highlightTile(0), loader(0), mapLoading(false),
+      hud(profiler, HUD_FONT_FILE),
+      frameStart(0), lastHitchDump(-TRACE_HITCH_GAP), hitchCount(0), recordInputTrace(false),
+      retainedFrame(screenWidth, screenHeight), retainedMode(true), editor(0)
+{
+    hge = hgeCreate(HGE_VERSION);
+}
+
+EditorApp::~EditorApp()
+{
+    hge->Release();
+}
+
+bool EditorApp::frameFunc() { return app->frame(); }
+bool EditorApp::gfxRestoreFunc() { app->restore(); return false; }
+void EditorApp::atlasLoaded(bool ok) { app->onAtlasLoaded(ok); }
+void EditorApp::mapLoaded(TileEditor* loaded) { app->onMapLoaded(loaded); }
+
+bool EditorApp::renderFunc()
+{
+    app->render();
+    return false;
+}
+
+// 保留模式下重画一个脏矩形，只画和它相交的地图块
+void EditorApp::paintDirty(const DirtyRect& rect)
+{
+    app->editor->setViewport(rect.x1, rect.y1, rect.x2, rect.y2);
+    app->drawEditor();
+    app->editor->setViewport(0, 0, app->screenWidth, app->screenHeight);
+}
+
+// 设备丢失后渲染目标的内容也丢失了，需要重绘
+void EditorApp::restore()
+{
+    if (editor)
+        editor->invalidateCache();
+    retainedFrame.invalidate();
+}
+
+// 图集可以使用了，创建编辑器
+void EditorApp::onAtlasLoaded(bool ok)
+{
+    int tileSize = 1 << config.tileShift;
+
+    if (ok)
+    {
+        atlas.fillTileSet(tiles, firstTile, config.tileCount);
+        highlight = atlas.createSprite(highlightTile);
+    }
+    else
+    {
+        // 打包失败时退回到分别加载
+        HTEXTURE tex = hge->Texture_Load(config.tilesetFile);
+        tiles.loadGrid(tex, config.tileCount, tileSize, tileSize);
+
+        tex = hge->Texture_Load(HIGHLIGHT_TEX_FILE);
+        highlight = new hgeSprite(tex, 0, 0, 32, 32);
+    }
+
+    highlight->SetColor(0x77FFFFFF);
+
+    graphics.tiles = &tiles;
+    graphics.highlight = highlight;
+
+    editor = createTileEditor(config.mode, config.cellBits, config.tileShift, config.rows, config.cols,
+                              graphics, MAP_LT_X, MAP_LT_Y);
+    if (useEditThread)
+        editor->startEditThread();
+    retainedFrame.invalidate();
+
+    // 从空白地图开始记录，回放时才能得到同样的结果
+    if (recordInputTrace)
+    {
+        InputTraceHeader header = { TILE_EDITOR_TAG(editor->mode(), editor->cellBits(), editor->tileShift()),
+            editor->rows(), editor->cols(), MAP_LT_X, MAP_LT_Y };
+        if (inputRecorder.open(INPUT_TRACE_FILE, header))
+            hge->System_Log("recording input to %s", INPUT_TRACE_FILE);
+    }
+}
+
+// 存档读完了，换掉当前的编辑器（读入期间仍然可以继续编辑旧地图）
+void EditorApp::onMapLoaded(TileEditor* loaded)
+{
+    mapLoading = false;
+
+    if (loaded)
+    {
+        // 读入存档后的编辑无法重现，停止记录
+        if (inputRecorder.recording())
+        {
+            inputRecorder.close(editor->contentHash());
+            hge->System_Log("input recording stopped after %d frames", inputRecorder.frameCount());
+        }
+
+        delete editor;
+        editor = loaded;
+        if (useEditThread)
+            editor->startEditThread();
+        retainedFrame.invalidate();
+        hge->System_Log("map loaded");
+    }
+    else
+    {
+        hge->System_Log("map load failed");
+    }
+}
+
+bool EditorApp::frame()
+{
+    frameStart = getTicks();
+    TRACE_SCOPE("FrameFunc");
+
+    if (hge->Input_GetKeyState(HGEK_ESCAPE))
+        return true;
+
+    // T输出时间线，没有在记录时开始记录
+    if (hge->Input_KeyDown(HGEK_T))
+    {
+        if (TraceRecorder::enabled() && TraceRecorder::dump(TRACE_FILE))
+            hge->System_Log("trace written to %s", TRACE_FILE);
+        TraceRecorder::setEnabled(true);
+    }
+
+    // P切换性能面板
+    if (hge->Input_KeyDown(HGEK_P))
+        hud.toggle();
+
+    {
+        PROFILE_SCOPE(profiler, PHASE_LOAD);
+        loader->update(LOAD_BUDGET);
+    }
+
+    if (!editor)
+        return false;
+
+    // 编辑只看这一帧的 InputFrame，回放时按记录的 InputFrame 得到同样的编辑操作
+    InputFrame input = readInput();
+    if (inputRecorder.recording())
+        inputRecorder.record(input);
+    EditActions actions = editInput.actions(input);
+
+    {
+        PROFILE_SCOPE(profiler, PHASE_INPUT);
+        handleKeys(actions);
+
+        // 更新高亮位置
+        editor->updateHighlight(static_cast<float>(actions.mouseX), static_cast<float>(actions.mouseY));
+    }
+
+    {
+        PROFILE_SCOPE(profiler, PHASE_STAMP);
+
+        // 将中心点周围的小格填为1（左键）或0（右键）
+        if (actions.stamp != -1)
+            editor->stamp(actions.stamp == 1);
+    }
+
+    // 本帧修改过的块按内容重新合并，有编辑线程时只是提交命令
+    {
+        PROFILE_SCOPE(profiler, PHASE_COMMIT);
+        editor->commit();
+    }
+
+    return false;
+}
+
+InputFrame EditorApp::readInput()
+{
+    float mx, my;
+    hge->Input_GetMousePos(&mx, &my);
+
+    InputFrame frame;
+    frame.dt = hge->Timer_GetDelta();
+    frame.mouseX = static_cast<short>(mx);
+    frame.mouseY = static_cast<short>(my);
+    frame.buttons = (hge->Input_GetKeyState(HGEK_LBUTTON) ? INPUT_LBUTTON : 0)
+        | (hge->Input_GetKeyState(HGEK_RBUTTON) ? INPUT_RBUTTON : 0);
+    frame.key = static_cast<unsigned char>(hge->Input_GetKey());
+    return frame;
+}
+
+void EditorApp::handleKeys(const EditActions& actions)
+{
+    // C切换块缓存
+    if (actions.toggleChunkCache)
+        editor->setChunkCache(!editor->chunkCache());
+
+    // R切换保留模式
+    if (hge->Input_KeyDown(HGEK_R))
+    {
+        retainedMode = !retainedMode;
+        retainedFrame.invalidate();
+    }
+
+    // Z缩小，X放大
+    if (actions.zoom != 0)
+    {
+        editor->setZoom(editor->zoom() + actions.zoom);
+        retainedFrame.invalidate();
+    }
+
+    // S保存，L读取（读入的存档可以是任意模式和格式）
+    if (hge->Input_KeyDown(HGEK_S))
+    {
+        if (editor->save(config.mapFile))
+            hge->System_Log("map saved");
+    }
+    else if (hge->Input_KeyDown(HGEK_L) && !mapLoading)
+    {
+        mapLoading = true;
+        loader->submit(new MapJob(config.mapFile, graphics, MAP_LT_X, MAP_LT_Y, mapLoaded));
+    }
+
+    // G显示岛和湖的统计，区域在每次 commit 时由编辑线程增量维护
+    if (hge->Input_KeyDown(HGEK_G))
+    {
+        RegionStats stats = editor->regionStats();
+        hge->System_Log("%d islands (largest %d), %d lakes (largest %d)",
+            stats.islands, stats.largestIsland, stats.lakes, stats.largestLake);
+    }
+
+    // N用下一个种子程序生成地形，生成的地图可以接着手工编辑
+    if (actions.generate)
+    {
+        double start = getTicks();
+        if (editor->generate(actions.noise))
+        {
+            hge->System_Log("terrain generated from seed %u in %.1f ms", actions.noise.seed, (getTicks() - start) * 1000.0);
+            retainedFrame.invalidate();
+        }
+    }
+
+    // M平滑、E侵蚀、F生长地形，每按一次执行一步元胞自动机
+    if (actions.rule != -1 && editor->simulate(actions.rule, 1))
+    {
+        AutomatonStats stats = editor->automatonStats();
+        hge->System_Log("automaton step %d: %d corners changed in %.2f ms, %d chunks retiled in %.2f ms",
+            stats.steps, stats.changedCorners, stats.stepTime * 1000.0, stats.storedChunks, stats.storeTime * 1000.0);
+    }
+}
+
+// 在窗口底部绘制加载进度条
+void EditorApp::drawProgress(float progress)
+{
+    hgeQuad quad;
+    quad.tex = 0;
+    quad.blend = BLEND_DEFAULT;
+
+    float y1 = static_cast<float>(screenHeight - 6);
+    float y2 = static_cast<float>(screenHeight);
+    float x2 = screenWidth * progress;
+
+    quad.v[0].x = 0;  quad.v[0].y = y1;
+    quad.v[1].x = x2; quad.v[1].y = y1;
+    quad.v[2].x = x2; quad.v[2].y = y2;
+    quad.v[3].x = 0;  quad.v[3].y = y2;
+
+    for (int i = 0; i < 4; ++i)
+    {
+        quad.v[i].z = 0.5f;
+        quad.v[i].col = 0xFF3080FF;
+        quad.v[i].tx = quad.v[i].ty = 0;
+    }
+
+    hge->Gfx_RenderQuad(&quad);
+}
+
+// 卡顿的帧自动输出时间线
+void EditorApp::checkHitch()
+{
+    double now = getTicks();
+    if (!TraceRecorder::enabled() || now - frameStart < TRACE_HITCH_TIME || now - lastHitchDump < TRACE_HITCH_GAP)
+        return;
+
+    char path[64];
+    sprintf(path, "hitch_%d.json", ++hitchCount);
+    if (TraceRecorder::dump(path))
+        hge->System_Log("%.1f ms frame, trace written to %s", (now - frameStart) * 1000.0, path);
+
+    lastHitchDump = getTicks();
+}
+
+void EditorApp::drawEditor()
+{
+    // 绘制地图
+    {
+        PROFILE_SCOPE(profiler, PHASE_MAP);
+        editor->drawMap();
+    }
+
+    // 绘制网格、笔刷范围和高亮框
+    {
+        PROFILE_SCOPE(profiler, PHASE_OVERLAY);
+        editor->drawOverlay();
+    }
+}
+
+// 小地图画在右下角，保持地图的长宽比
+void EditorApp::drawMinimap()
+{
+    int longest = editor->rows() > editor->cols() ? editor->rows() : editor->cols();
+    float w = static_cast<float>(MINIMAP_DISPLAY_SIZE * editor->cols() / longest);
+    float h = static_cast<float>(MINIMAP_DISPLAY_SIZE * editor->rows() / longest);
+    float x = screenWidth - w - 4, y = screenHeight - h - 4;
+
+    editor->drawMinimap(x, y, x + w, y + h);
+}
+
+void EditorApp::renderScene()
+{
+    TRACE_SCOPE("RenderFunc");
+
+    if (editor)
+    {
+        {
+            PROFILE_SCOPE(profiler, PHASE_CACHE);
+            editor->updateCache();
+        }
+
+        {
+            PROFILE_SCOPE(profiler, PHASE_MINIMAP);
+            editor->updateMinimap();
+        }
+
+        // 不在保留模式时也要取走，否则变化的区域会一直累积
+        DirtyRegion damage;
+        editor->takeDamage(damage);
+
+        if (retainedMode)
+        {
+            retainedFrame.addDirty(damage);
+            retainedFrame.update(paintDirty);
+        }
+    }
+
+    hge->Gfx_BeginScene();
+    hge->Gfx_Clear(0xFFFFFFFF);
+
+    if (editor)
+    {
+        if (retainedMode)
+            retainedFrame.render();
+        else
+            drawEditor();
+
+        drawMinimap();
+    }
+
+    if (loader->busy())
+        drawProgress(loader->progress());
+
+    hud.render(4, 4);
+
+    hge->Gfx_EndScene();
+}
+
+void EditorApp::render()
+{
+    renderScene();
+
+    profiler.endFrame();
+    checkHitch();
+}
+
+void EditorApp::loadContent()
+{
+    for (int i = 0; i < PHASE_COUNT; ++i)
+        profiler.addPhase(phaseNames[i]);
+
+    hge->Resource_AttachPack(RESOURCE_PACK);
+
+    // 地图元件横向排开，高亮框为32*32，合并成一张图集
+    int tileSize = 1 << config.tileShift;
+    firstTile = atlas.addSheet(config.tilesetFile, tileSize, tileSize, config.tileCount);
+    highlightTile = atlas.addImage(HIGHLIGHT_TEX_FILE);
+
+    // 优先读缓存，缓存不存在或过期时从PNG打包并重新生成缓存
+    loader = new AsyncLoader(LOAD_WORKERS);
+    loader->submit(new AtlasJob(atlas, useAtlasCache ? ATLAS_CACHE_FILE : 0, atlasLoaded));
+}
+
+void EditorApp::unLoadContent()
+{
+    // 先等加载线程结束，没有完成的任务里可能还持有编辑器
+    SAFE_DELETE(loader);
+
+    if (editor && inputRecorder.recording())
+        inputRecorder.close(editor->contentHash());
+
+    // 渲染目标和纹理要在 System_Shutdown() 之前释放
+    SAFE_DELETE(editor);
+    retainedFrame.release();
+    hud.release();
+    tiles.release();
+
+    SAFE_DELETE(highlight);
+    atlas.release();
+}
+
+int EditorApp::run(const char* cmdLine)
+{
+    if (cmdLine && strstr(cmdLine, "-nocache"))
+        useAtlasCache = false;
+    if (cmdLine && strstr(cmdLine, "-syncedit"))
+        useEditThread = false;
+
+    app = this;
+
+    TraceRecorder::setThreadName("main");
+    TraceRecorder::setEnabled(cmdLine && strstr(cmdLine, "-trace") != 0);
+    recordInputTrace = cmdLine && strstr(cmdLine, "-record") != 0;
+
+    hge->System_SetState(HGE_FRAMEFUNC, frameFunc);
+    hge->System_SetState(HGE_RENDERFUNC, renderFunc);
+    hge->System_SetState(HGE_GFXRESTOREFUNC, gfxRestoreFunc);
+    hge->System_SetState(HGE_TITLE, config.title);
+    hge->System_SetState(HGE_SCREENWIDTH, screenWidth);
+    hge->System_SetState(HGE_SCREENHEIGHT, screenHeight);
+    hge->System_SetState(HGE_FPS, 60);
+    hge->System_SetState(HGE_HIDEMOUSE, false);
+    hge->System_SetState(HGE_WINDOWED, true);
+    hge->System_SetState(HGE_USESOUND, false);
+    hge->System_SetState(HGE_LOGFILE, LOG_FILE);
+    hge->System_SetState(HGE_SHOWSPLASH, false);
+
+    if (hge->System_Initiate())
+    {
+        loadContent();
+        hge->System_Start();
+    }
+    else
+    {
+        MessageBox(NULL, hge->System_GetErrorMessage(), "Error", MB_OK | MB_ICONERROR | MB_APPLMODAL);
+    }
+
+    unLoadContent();
+    hge->System_Shutdown();
+
+    app = 0;
+    return 0;
+}
@@ -0,0 +1,147 @@
+/*
+** 编辑器程序
+** 窗口、资源加载、每帧的输入处理、编辑和绘制，简单模式和魔兽模式的编辑器共用，
+** 两个编辑器只在 EditorAppConfig 里的地图模式、格子位数、元件大小、地图大小和文件名上不同。
+**
+** 左键绘制，右键清除；C 切换块缓存，R 切换保留模式，Z/X 缩放，S/L 保存和读取，
+** G 输出岛和湖的统计，N 程序生成地形，M/E/F 执行一步元胞自动机，P 性能面板，T 输出时间线。
+** 命令行：-nocache 不用图集缓存，-syncedit 在主线程编辑，-trace 从启动开始记录时间线，-record 记录输入。
+**
+** HGE 的回调是普通函数，同一时间只能运行一个 EditorApp。
+**
+** author : gouki04 2011-12-30
+*/
+
+#ifndef EDITORAPP_H
+#define EDITORAPP_H
+
+#include "..\hge\hge.h"
+#include "..\hge\hgesprite.h"
+
+#include "AsyncLoader.h"
+#include "EditInput.h"
+#include "FrameProfiler.h"
+#include "InputTrace.h"
+#include "ProfilerHud.h"
+#include "RetainedFrame.h"
+#include "TileAtlas.h"
+#include "TileEditor.h"
+#include "TileSet.h"
+
+struct EditorAppConfig
+{
+    const char* title;          // 窗口标题
+    int mode;                   // 地图模式 TILEMODE_*
+    int cellBits;               // 每个格子的位数
+    int tileShift;              // 地图元件宽高为 1 << tileShift
+    int rows, cols;             // 地图行数和列数，也决定窗口大小
+    int tileCount;              // 地图元件个数
+    const char* tilesetFile;    // 地图元件图片，tileCount 个元件横向排开
+    const char* mapFile;        // 地图存档
+};
+
+class EditorApp
+{
+public:
+    explicit EditorApp(const EditorAppConfig& config);
+    ~EditorApp();
+
+    // 按命令行参数运行，窗口关闭后返回
+    int run(const char* cmdLine);
+
+private:
+    EditorApp(const EditorApp&);
+    EditorApp& operator=(const EditorApp&);
+
+    // 每帧各阶段耗时，按P显示或隐藏
+    enum
+    {
+        PHASE_LOAD,
+        PHASE_INPUT,
+        PHASE_STAMP,
+        PHASE_COMMIT,
+        PHASE_CACHE,
+        PHASE_MAP,
+        PHASE_OVERLAY,
+        PHASE_MINIMAP,
+        PHASE_COUNT
+    };
+
+    // HGE 和加载任务的回调，转给正在运行的 app
+    static bool frameFunc();
+    static bool renderFunc();
+    static bool gfxRestoreFunc();
+    static void atlasLoaded(bool ok);
+    static void mapLoaded(TileEditor* loaded);
+    static void paintDirty(const DirtyRect& rect);
+
+    bool frame();
+    void render();
+    void restore();
+    void onAtlasLoaded(bool ok);
+    void onMapLoaded(TileEditor* loaded);
+
+    InputFrame readInput();
+    void handleKeys(const EditActions& actions);
+    void drawProgress(float progress);
+    void checkHitch();
+    void drawEditor();
+    void drawMinimap();
+    void renderScene();
+
+    void loadContent();
+    void unLoadContent();
+
+    static EditorApp* app;
+
+    EditorAppConfig config;
+    HGE* hge;
+
+    // 窗口宽度和高度
+    int screenWidth, screenHeight;
+
+    // 高亮框，地图元件和高亮框打包在同一张纹理里
+    hgeSprite* highlight;
+    TileAtlas atlas;
+
+    // 命令行加 -nocache 时不使用图集缓存，每次都从PNG解码（用于对比启动时间）
+    bool useAtlasCache;
+
+    // 编辑在单独的线程中执行，命令行加 -syncedit 时在主线程中执行（用于对比）
+    bool useEditThread;
+
+    // 地图元件的UV表
+    TileSet tiles;
+    int firstTile;
+    int highlightTile;
+
+    // 图片和地图存档在后台线程读入，主线程每帧上传一部分
+    AsyncLoader* loader;
+    bool mapLoading;
+
+    // 每帧的输入换算成编辑操作，与 TileBench replay 回放时相同
+    EditInput editInput;
+
+    FrameProfiler profiler;
+    ProfilerHud hud;
+
+    // 时间线，命令行加 -trace 时从启动开始记录，按T输出；记录期间卡顿的帧自动输出到 hitch_N.json
+    double frameStart;
+    double lastHitchDump;
+    int hitchCount;
+
+    // 输入记录，可以用 TileBench replay 在没有窗口的情况下重放
+    InputRecorder inputRecorder;
+    bool recordInputTrace;
+
+    // 保留模式：地图、网格和高亮框画在一个渲染目标里，每帧只重画变化的区域，按R切换
+    RetainedFrame retainedFrame;
+    bool retainedMode;
+
+    // 地图编辑器，按块存储地图数据，内容相同的块只保存一份
+    // 图集上传完成后才创建，在此之前只显示加载进度
+    TileGraphics graphics;
+    TileEditor* editor;
+};
+
+#endif
@@ -0,0 +1,75 @@
+/*
+** 每帧分阶段计时
+**
+** author : gouki04 2011-12-30
+*/
+
+#include "FrameProfiler.h"
+
+#include <algorithm>
+
+FrameProfiler::FrameProfiler() : next(0), frames(0), on(false)
+{
+}
+
+int FrameProfiler::addPhase(const char* name)
+{
+    names.push_back(name);
+    current.push_back(0);
+    samples.assign(names.size() * FRAME_PROFILER_FRAMES, 0.f);
+    next = frames = 0;
+
+    return phaseCount() - 1;
+}
+
+void FrameProfiler::setEnabled(bool enable)
+{
+    if (enable && !on)
+    {
+        std::fill(current.begin(), current.end(), 0.0);
+        next = frames = 0;
+    }
+    on = enable;
+}
+
+void FrameProfiler::endFrame()
+{
+    if (!on)
+        return;
+
+    float* row = &samples[next * names.size()];
+    for (size_t i = 0; i < names.size(); ++i)
+    {
+        row[i] = static_cast<float>(current[i] * 1000.0);
+        current[i] = 0;
+    }
+
+    next = (next + 1) % FRAME_PROFILER_FRAMES;
+    if (frames < FRAME_PROFILER_FRAMES)
+        ++frames;
+}
+
+PhaseStats FrameProfiler::stats(int phase) const
+{
+    PhaseStats result = { 0, 0, 0 };
+    if (frames == 0)
+        return result;
+
+    float values[FRAME_PROFILER_FRAMES];
+    float sum = 0;
+    for (int f = 0; f < frames; ++f)
+    {
+        values[f] = samples[f * names.size() + phase];
+        sum += values[f];
+    }
+
+    // 99分位：排好序后第 ceil(0.99 * n) 个
+    int rank = (frames * 99 + 99) / 100 - 1;
+    std::nth_element(values, values + rank, values + frames);
+
+    result.p99 = values[rank];
+    result.min = *std::min_element(values, values + frames);
+    result.avg = sum / frames;
+
+    return result;
+}
@@ -0,0 +1,105 @@
+/*
+** 每帧分阶段计时
+** 用 PROFILE_SCOPE 包住要统计的代码段，同一阶段一帧内多次进入时累加，
+** endFrame() 把本帧结果存入最近 FRAME_PROFILER_FRAMES 帧的环形缓冲，可以查询最小、平均和99分位耗时。
+**
+** 打开了 TraceRecorder 时，每个阶段同时记入时间线。
+**
+** 关闭时每个计时点只多一次判断；定义 TILE_NO_PROFILER 时 PROFILE_SCOPE 完全不生成代码。
+**
+** author : gouki04 2011-12-30
+*/
+
+#ifndef FRAMEPROFILER_H
+#define FRAMEPROFILER_H
+
+#include <vector>
+
+#include "Platform.h"
+#include "TraceRecorder.h"
+
+#define FRAME_PROFILER_FRAMES 120   // 统计最近多少帧
+
+// 一个阶段的统计结果，单位为毫秒
+struct PhaseStats
+{
+    float min;
+    float avg;
+    float p99;
+};
+
+class FrameProfiler
+{
+public:
+    FrameProfiler();
+
+    // 添加一个阶段，返回阶段编号，name 必须是常量字符串
+    int addPhase(const char* name);
+
+    int phaseCount() const { return static_cast<int>(names.size()); }
+    const char* phaseName(int phase) const { return names[phase]; }
+
+    // 关闭时不计时，重新打开时清空旧数据
+    void setEnabled(bool enable);
+    bool enabled() const { return on; }
+
+    // 累加本帧某个阶段的耗时（秒）
+    void add(int phase, double seconds) { current[phase] += seconds; }
+
+    // 一帧结束
+    void endFrame();
+
+    // 已经记录的帧数
+    int frameCount() const { return frames; }
+
+    PhaseStats stats(int phase) const;
+
+private:
+    std::vector<const char*> names;
+    std::vector<double> current;    // 本帧各阶段的累计耗时
+    std::vector<float> samples;     // [帧][阶段]，单位为毫秒
+    int next;                       // 下一帧写入的位置
+    int frames;
+    bool on;
+};
+
+// 作用域计时
+class ProfileScope
+{
+public:
+    ProfileScope(FrameProfiler& p, int ph) : profiler(p), phase(ph), start(0)
+    {
+        if (profiler.enabled() || TraceRecorder::enabled())
+            start = getTicks();
+    }
+
+    ~ProfileScope()
+    {
+        if (start == 0)
+            return;
+
+        double end = getTicks();
+        if (profiler.enabled())
+            profiler.add(phase, end - start);
+        if (TraceRecorder::enabled())
+            TraceRecorder::record(profiler.phaseName(phase), start, end);
+    }
+
+private:
+    ProfileScope(const ProfileScope&);
+    ProfileScope& operator=(const ProfileScope&);
+
+    FrameProfiler& profiler;
+    int phase;
+    double start;
+};
+
+#ifdef TILE_NO_PROFILER
+#define PROFILE_SCOPE(profiler, phase)
+#else
+#define PROFILE_SCOPE_NAME2(line) profileScope##line
+#define PROFILE_SCOPE_NAME(line) PROFILE_SCOPE_NAME2(line)
+#define PROFILE_SCOPE(profiler, phase) ProfileScope PROFILE_SCOPE_NAME(__LINE__)(profiler, phase)
+#endif
+
+#endif
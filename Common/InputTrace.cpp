@@ -0,0 +1,121 @@
+/*
+** 编辑操作的输入记录
+**
+** author : gouki04 2011-12-30
+*/
+
+#include "InputTrace.h"
+
+#include <string.h>
+
+#define INPUT_TRACE_VERSION 1
+
+namespace
+{
+    // 每帧记录的字节数：类型(1) 帧间隔(4) 鼠标(2 + 2) 按键状态(1) 按下的键(1)
+    const int FRAME_BYTES = 11;
+}
+
+InputRecorder::InputRecorder() : file(0), frames(0)
+{
+}
+
+InputRecorder::~InputRecorder()
+{
+    // 没有正常结束的记录仍然可以回放，只是无法校验结果
+    if (file)
+        fclose(file);
+}
+
+bool InputRecorder::open(const char* path, const InputTraceHeader& header)
+{
+    if (file)
+        fclose(file);
+
+    frames = 0;
+    file = fopen(path, "wb");
+    if (!file)
+        return false;
+
+    int version = INPUT_TRACE_VERSION;
+    fwrite("TINP", 4, 1, file);
+    fwrite(&version, sizeof(version), 1, file);
+    fwrite(&header, sizeof(header), 1, file);
+
+    return true;
+}
+
+void InputRecorder::record(const InputFrame& frame)
+{
+    if (!file)
+        return;
+
+    // 逐个字段写入，不受结构体对齐的影响
+    unsigned char data[FRAME_BYTES];
+    data[0] = 'F';
+    memcpy(data + 1, &frame.dt, 4);
+    memcpy(data + 5, &frame.mouseX, 2);
+    memcpy(data + 7, &frame.mouseY, 2);
+    data[9] = frame.buttons;
+    data[10] = frame.key;
+
+    fwrite(data, FRAME_BYTES, 1, file);
+    ++frames;
+}
+
+void InputRecorder::close(ContentHash finalHash)
+{
+    if (!file)
+        return;
+
+    fputc('E', file);
+    fwrite(&finalHash, sizeof(finalHash), 1, file);
+    fclose(file);
+    file = 0;
+}
+
+InputTrace::InputTrace() : complete(false), hash(0)
+{
+    memset(&head, 0, sizeof(head));
+}
+
+bool InputTrace::load(const char* path)
+{
+    frames.clear();
+    complete = false;
+
+    FILE* file = fopen(path, "rb");
+    if (!file)
+        return false;
+
+    char magic[4];
+    int version = 0;
+    bool ok = fread(magic, 4, 1, file) == 1 && memcmp(magic, "TINP", 4) == 0
+        && fread(&version, sizeof(version), 1, file) == 1 && version == INPUT_TRACE_VERSION
+        && fread(&head, sizeof(head), 1, file) == 1;
+
+    while (ok)
+    {
+        int type = fgetc(file);
+        if (type == 'E')
+        {
+            complete = fread(&hash, sizeof(hash), 1, file) == 1;
+            break;
+        }
+
+        unsigned char data[FRAME_BYTES];
+        if (type != 'F' || fread(data + 1, FRAME_BYTES - 1, 1, file) != 1)
+            break;
+
+        InputFrame frame;
+        memcpy(&frame.dt, data + 1, 4);
+        memcpy(&frame.mouseX, data + 5, 2);
+        memcpy(&frame.mouseY, data + 7, 2);
+        frame.buttons = data[9];
+        frame.key = data[10];
+        frames.push_back(frame);
+    }
+
+    fclose(file);
+    return ok;
+}
@@ -0,0 +1,91 @@
+/*
+** 编辑操作的输入记录
+** 编辑器每帧把鼠标位置、按键状态、按下的键和帧间隔写入文件，
+** 回放工具（TileBench replay）不开窗口，按同样的输入重新编辑地图并统计耗时，
+** 结束时比较地图内容哈希，确认结果与录制时一致。
+**
+** 文件格式：文件头，每帧一条 'F' 记录，结束时一条 'E' 记录（地图内容哈希）
+**
+** author : gouki04 2011-12-30
+*/
+
+#ifndef INPUTTRACE_H
+#define INPUTTRACE_H
+
+#include <stdio.h>
+#include <vector>
+
+#include "ContentHash.h"
+
+// 鼠标按键
+enum
+{
+    INPUT_LBUTTON = 0x1,
+    INPUT_RBUTTON = 0x2
+};
+
+// 一帧的输入
+struct InputFrame
+{
+    float dt;                   // 帧间隔（秒）
+    short mouseX, mouseY;       // 鼠标位置（屏幕像素）
+    unsigned char buttons;      // INPUT_LBUTTON | INPUT_RBUTTON
+    unsigned char key;          // 本帧按下的键（HGE键码），没有时为0
+};
+
+// 录制时编辑器的格式和位置，回放时按这个创建地图
+struct InputTraceHeader
+{
+    int tag;                    // TILE_EDITOR_TAG
+    int rows, cols;
+    int originX, originY;
+};
+
+class InputRecorder
+{
+public:
+    InputRecorder();
+    ~InputRecorder();
+
+    bool open(const char* path, const InputTraceHeader& header);
+
+    // 写入结束记录并关闭文件
+    void close(ContentHash finalHash);
+
+    bool recording() const { return file != 0; }
+    int frameCount() const { return frames; }
+
+    void record(const InputFrame& frame);
+
+private:
+    InputRecorder(const InputRecorder&);
+    InputRecorder& operator=(const InputRecorder&);
+
+    FILE* file;
+    int frames;
+};
+
+class InputTrace
+{
+public:
+    InputTrace();
+
+    bool load(const char* path);
+
+    const InputTraceHeader& header() const { return head; }
+
+    int frameCount() const { return static_cast<int>(frames.size()); }
+    const InputFrame& frame(int i) const { return frames[i]; }
+
+    // 录制正常结束时才有结束哈希
+    bool hasFinalHash() const { return complete; }
+    ContentHash finalHash() const { return hash; }
+
+private:
+    InputTraceHeader head;
+    std::vector<InputFrame> frames;
+    bool complete;
+    ContentHash hash;
+};
+
+#endif
@@ -0,0 +1,198 @@
+/*
+** 带优先级的工作窃取任务调度
+**
+** author : gouki04 2011-12-30
+*/
+
+#include "JobScheduler.h"
+
+#include <stdio.h>
+#include <algorithm>
+
+JobScheduler::JobScheduler(int workerCount, const char* name)
+    : threadName(name), queuedJobs(0), stopping(0), submitted(0), stopped(false)
+{
+    if (workerCount < 1)
+        workerCount = hardwareThreads() > 2 ? hardwareThreads() - 2 : 1;
+
+    for (int i = 0; i < workerCount; ++i)
+    {
+        Worker* worker = new Worker;
+        worker->scheduler = this;
+        worker->index = i;
+        workers.push_back(worker);
+    }
+
+    // 所有 Worker 都建好之后再启动线程，线程一启动就可能去别的线程那里偷任务
+    for (size_t i = 0; i < workers.size(); ++i)
+        workers[i]->thread.start(workerMain, workers[i]);
+}
+
+JobScheduler::~JobScheduler()
+{
+    stop();
+
+    for (size_t i = 0; i < workers.size(); ++i)
+        delete workers[i];
+}
+
+void JobScheduler::submit(Job* job, int priority)
+{
+    if (stopped)
+    {
+        delete job;
+        return;
+    }
+
+    // 几个线程同时提交时各自取得不同的序号
+    long order = atomicAdd(&submitted, 1) - 1;
+
+    Entry entry;
+    entry.priority = priority;
+    entry.order = order;
+    entry.job = job;
+
+    Worker* worker = workers[order % workers.size()];
+
+    {
+        ScopedLock lock(worker->lock);
+        worker->heap.push_back(entry);
+        std::push_heap(worker->heap.begin(), worker->heap.end());
+    }
+
+    atomicAdd(&queuedJobs, 1);
+    wake.signal();
+}
+
+void JobScheduler::stop()
+{
+    if (stopped)
+        return;
+    stopped = true;
+
+    atomicStore(&stopping, 1);
+    wake.signal();
+
+    for (size_t i = 0; i < workers.size(); ++i)
+        workers[i]->thread.join();
+
+    for (size_t i = 0; i < workers.size(); ++i)
+    {
+        std::vector<Entry>& heap = workers[i]->heap;
+        for (size_t k = 0; k < heap.size(); ++k)
+            delete heap[k].job;
+        heap.clear();
+    }
+    atomicStore(&queuedJobs, 0);
+}
+
+bool JobScheduler::popBest(Worker* worker, Job*& job)
+{
+    ScopedLock lock(worker->lock);
+    if (worker->heap.empty())
+        return false;
+
+    std::pop_heap(worker->heap.begin(), worker->heap.end());
+    job = worker->heap.back().job;
+    worker->heap.pop_back();
+    return true;
+}
+
+Job* JobScheduler::take(int self)
+{
+    int count = static_cast<int>(workers.size());
+    for (int i = 0; i < count; ++i)
+    {
+        Job* job;
+        if (popBest(workers[(self + i) % count], job))
+        {
+            atomicAdd(&queuedJobs, -1);
+            return job;
+        }
+    }
+    return 0;
+}
+
+void JobScheduler::workerMain(void* arg)
+{
+    Worker* worker = static_cast<Worker*>(arg);
+    JobScheduler* scheduler = worker->scheduler;
+
+    char name[32];
+    sprintf(name, "%s %d", scheduler->threadName, worker->index);
+    TraceRecorder::setThreadName(name);
+
+    for (;;)
+    {
+        if (atomicLoad(&scheduler->stopping))
+        {
+            // 一次 signal 只唤醒一个线程，依次传下去
+            scheduler->wake.signal();
+            TraceRecorder::threadExit();
+            return;
+        }
+
+        Job* job = scheduler->take(worker->index);
+        if (!job)
+        {
+            scheduler->wake.wait();
+            continue;
+        }
+
+        // 还有任务时叫醒下一个线程来帮忙
+        if (atomicLoad(&scheduler->queuedJobs) > 0)
+            scheduler->wake.signal();
+
+        {
+            TRACE_SCOPE("job");
+            job->run();
+        }
+        delete job;
+    }
+}
+
+namespace
+{
+    // parallelFor() 的一段，最后一个执行完的通知调用线程
+    class RangeJob : public Job
+    {
+    public:
+        RangeJob(RangeFunc f, void* a, int b, int e, volatile long* p, Event* d)
+            : func(f), arg(a), begin(b), end(e), pending(p), done(d)
+        {
+        }
+
+        virtual void run()
+        {
+            func(begin, end, arg);
+            if (atomicAdd(pending, -1) == 0)
+                done->signal();
+        }
+
+    private:
+        RangeFunc func;
+        void* arg;
+        int begin, end;
+        volatile long* pending;
+        Event* done;
+    };
+}
+
+void parallelFor(JobScheduler* jobs, int count, RangeFunc func, void* arg, int priority)
+{
+    int segments = jobs ? jobs->workerCount() * 4 : 1;
+    if (segments > count)
+        segments = count;
+    if (segments <= 1)
+    {
+        if (count > 0)
+            func(0, count, arg);
+        return;
+    }
+
+    volatile long pending = segments;
+    Event done;
+    for (int i = 0; i < segments; ++i)
+        jobs->submit(new RangeJob(func, arg, count * i / segments, count * (i + 1) / segments, &pending, &done), priority);
+    done.wait();
+}
@@ -0,0 +1,103 @@
+/*
+** 带优先级的工作窃取任务调度
+** 每个工作线程有自己的任务堆，提交的任务轮流分给各个线程；
+** 线程先取自己堆里优先级最高（数值最小）的任务，自己没有任务时去别的线程那里偷。
+** 偷的也是对方优先级最高的任务，而不是最旧的，这样整体上仍然大致按优先级执行，
+** 例如地图块的重建可以让离视口近的块先完成。
+**
+** 任务在工作线程中执行，执行完由调度器释放；任务本身负责把结果交回主线程。
+**
+** author : gouki04 2011-12-30
+*/
+
+#ifndef JOBSCHEDULER_H
+#define JOBSCHEDULER_H
+
+#include <vector>
+
+#include "Platform.h"
+#include "TraceRecorder.h"
+
+class Job
+{
+public:
+    virtual ~Job() {}
+
+    // 工作线程中执行
+    virtual void run() = 0;
+};
+
+class JobScheduler
+{
+public:
+    // workerCount 小于 1 时按处理器个数决定
+    explicit JobScheduler(int workerCount = 0, const char* name = "job");
+
+    // 丢弃还没有开始的任务，等待正在执行的任务结束
+    ~JobScheduler();
+
+    // 提交任务，priority 越小越先执行，任务由调度器负责释放
+    // 可以同时在几个线程中提交（例如主线程提交地图块的重建，编辑线程用 parallelFor() 并行模拟）
+    void submit(Job* job, int priority);
+
+    // 丢弃还没有开始的任务，等待工作线程结束，之后不能再提交任务；调用时不能有其他线程正在提交
+    void stop();
+
+    int workerCount() const { return static_cast<int>(workers.size()); }
+
+    // 还没有开始执行的任务数（近似值）
+    int queued() { return static_cast<int>(atomicLoad(&queuedJobs)); }
+
+private:
+    JobScheduler(const JobScheduler&);
+    JobScheduler& operator=(const JobScheduler&);
+
+    struct Entry
+    {
+        int priority;
+        long order;     // 优先级相同时先提交的先执行
+        Job* job;
+
+        // 用于 std::push_heap，堆顶是优先级最高的任务
+        bool operator<(const Entry& other) const
+        {
+            if (priority != other.priority)
+                return priority > other.priority;
+            return order > other.order;
+        }
+    };
+
+    struct Worker
+    {
+        JobScheduler* scheduler;
+        int index;
+        Thread thread;
+        Mutex lock;
+        std::vector<Entry> heap;
+    };
+
+    static void workerMain(void* arg);
+
+    // 先取自己的任务，没有时从其他线程偷
+    Job* take(int self);
+    static bool popBest(Worker* worker, Job*& job);
+
+    std::vector<Worker*> workers;
+    const char* threadName;
+
+    Event wake;                 // 有新任务或要求结束
+    volatile long queuedJobs;
+    volatile long stopping;
+
+    volatile long submitted;    // 已经提交的任务数，提交的线程用原子操作取得序号
+    bool stopped;               // 只由 stop() 修改
+};
+
+/*
+** 把 [0, count) 分成若干段，每段调用一次 func(begin, end, arg)
+** jobs 不为0时每段是一个任务（每个工作线程4段），等所有段执行完才返回；不能在同一个调度器的工作线程中调用
+*/
+typedef void (*RangeFunc)(int begin, int end, void* arg);
+void parallelFor(JobScheduler* jobs, int count, RangeFunc func, void* arg, int priority = -1);
+
+#endif
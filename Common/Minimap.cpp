@@ -0,0 +1,138 @@
+/*
+** 小地图
+**
+** author : gouki04 2011-12-30
+*/
+
+#include "Minimap.h"
+
+HGE* Minimap::hge = 0;
+
+Minimap::Minimap() : tex(0), texWidth(0), texHeight(0), scaleShift(0)
+{
+    hge = hgeCreate(HGE_VERSION);
+}
+
+Minimap::~Minimap()
+{
+    release();
+    hge->Release();
+}
+
+bool Minimap::create(int rows, int cols, int maxSize)
+{
+    release();
+
+    if (rows <= 0 || cols <= 0 || maxSize <= 0)
+        return false;
+
+    scaleShift = 0;
+    while (((rows - 1) >> scaleShift) + 1 > maxSize || ((cols - 1) >> scaleShift) + 1 > maxSize)
+        ++scaleShift;
+
+    texWidth = ((cols - 1) >> scaleShift) + 1;
+    texHeight = ((rows - 1) >> scaleShift) + 1;
+
+    tex = hge->Texture_Create(texWidth, texHeight);
+    if (!tex)
+        return false;
+
+    invalidateAll();
+    return true;
+}
+
+void Minimap::release()
+{
+    if (tex)
+        hge->Texture_Free(tex);
+    tex = 0;
+    dirty.clear();
+}
+
+void Minimap::invalidate(int r1, int c1, int r2, int c2)
+{
+    if (!tex || r1 >= r2 || c1 >= c2)
+        return;
+
+    DirtyRect rect = { c1 >> scaleShift, r1 >> scaleShift, ((c2 - 1) >> scaleShift) + 1, ((r2 - 1) >> scaleShift) + 1 };
+    if (rect.x1 < 0) rect.x1 = 0;
+    if (rect.y1 < 0) rect.y1 = 0;
+    if (rect.x2 > texWidth) rect.x2 = texWidth;
+    if (rect.y2 > texHeight) rect.y2 = texHeight;
+    if (rect.x1 >= rect.x2 || rect.y1 >= rect.y2)
+        return;
+
+    // 按住鼠标不动时每帧都是同一个矩形
+    if (!dirty.empty())
+    {
+        const DirtyRect& last = dirty.back();
+        if (last.x1 <= rect.x1 && last.y1 <= rect.y1 && last.x2 >= rect.x2 && last.y2 >= rect.y2)
+            return;
+    }
+
+    dirty.push_back(rect);
+}
+
+void Minimap::invalidateAll()
+{
+    if (!tex)
+        return;
+
+    dirty.clear();
+    DirtyRect rect = { 0, 0, texWidth, texHeight };
+    dirty.push_back(rect);
+}
+
+int Minimap::update(FillFunc fill, void* context)
+{
+    if (!tex || dirty.empty())
+        return 0;
+
+    int pitch = hge->Texture_GetWidth(tex);
+    int texels = 0;
+
+    for (size_t i = 0; i < dirty.size(); ++i)
+    {
+        const DirtyRect& rect = dirty[i];
+        int w = rect.x2 - rect.x1, h = rect.y2 - rect.y1;
+
+        DWORD* pixels = hge->Texture_Lock(tex, false, rect.x1, rect.y1, w, h);
+        if (!pixels)
+            continue;
+
+        fill(context, rect, pixels, pitch);
+        hge->Texture_Unlock(tex);
+
+        texels += w * h;
+    }
+
+    dirty.clear();
+    return texels;
+}
+
+void Minimap::render(float x1, float y1, float x2, float y2)
+{
+    if (!tex)
+        return;
+
+    hgeQuad quad;
+    quad.tex = tex;
+    quad.blend = BLEND_DEFAULT;
+
+    // 纹理可能被放大到2的幂
+    float u = static_cast<float>(texWidth) / static_cast<float>(hge->Texture_GetWidth(tex));
+    float v = static_cast<float>(texHeight) / static_cast<float>(hge->Texture_GetHeight(tex));
+
+    quad.v[0].x = x1; quad.v[0].y = y1; quad.v[0].tx = 0; quad.v[0].ty = 0;
+    quad.v[1].x = x2; quad.v[1].y = y1; quad.v[1].tx = u; quad.v[1].ty = 0;
+    quad.v[2].x = x2; quad.v[2].y = y2; quad.v[2].tx = u; quad.v[2].ty = v;
+    quad.v[3].x = x1; quad.v[3].y = y2; quad.v[3].tx = 0; quad.v[3].ty = v;
+
+    for (int i = 0; i < 4; ++i)
+    {
+        quad.v[i].z = 0.5f;
+        quad.v[i].col = 0xFFFFFFFF;
+    }
+
+    hge->Gfx_RenderQuad(&quad);
+}
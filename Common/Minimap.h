@@ -0,0 +1,65 @@
+/*
+** 小地图
+** 纹理用 Texture_Create 创建，每个纹素对应一个格子；地图太大时每个纹素对应 (1 << shift) * (1 << shift) 个格子，取平均颜色。
+** 编辑时只记下改动的格子所在的矩形，update() 只锁定这些子矩形、写入新的颜色，
+** 所以每帧的开销只和改动的格子数有关，和地图大小无关。
+** 纹素的颜色由使用者填充（编辑器按元件的平均颜色，见 TileSet::color()）。
+**
+** author : gouki04 2011-12-30
+*/
+
+#ifndef MINIMAP_H
+#define MINIMAP_H
+
+#include "..\hge\hge.h"
+
+#include <vector>
+
+#include "RetainedFrame.h"
+
+#define MINIMAP_MAX_SIZE 256    // 纹理的最大边长
+
+class Minimap
+{
+public:
+    // 填充纹理上的一个矩形：rect 是纹素坐标，pixels 指向矩形左上角，pitch 是纹理一行的纹素数
+    typedef void (*FillFunc)(void* context, const DirtyRect& rect, DWORD* pixels, int pitch);
+
+    Minimap();
+    ~Minimap();
+
+    // rows*cols 格的地图，创建后整张纹理都需要填充
+    bool create(int rows, int cols, int maxSize = MINIMAP_MAX_SIZE);
+    void release();
+    bool created() const { return tex != 0; }
+
+    // 每个纹素对应 (1 << shift) * (1 << shift) 个格子
+    int shift() const { return scaleShift; }
+    int width() const { return texWidth; }
+    int height() const { return texHeight; }
+
+    // 格子矩形 [r1, r2) x [c1, c2) 的内容变了
+    void invalidate(int r1, int c1, int r2, int c2);
+    void invalidateAll();
+
+    // 逐个锁定变化的矩形并调用 fill，返回更新的纹素数
+    int update(FillFunc fill, void* context);
+
+    // 必须在 Gfx_BeginScene() 和 Gfx_EndScene() 之间调用
+    void render(float x1, float y1, float x2, float y2);
+
+private:
+    Minimap(const Minimap&);
+    Minimap& operator=(const Minimap&);
+
+    static HGE* hge;
+
+    HTEXTURE tex;
+    int texWidth, texHeight;
+    int scaleShift;
+
+    // 编辑产生的矩形通常很小，逐个锁定，不合并成外接矩形
+    std::vector<DirtyRect> dirty;
+};
+
+#endif
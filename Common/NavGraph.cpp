@@ -0,0 +1,970 @@
+/*
+** 导航网格和分层寻路（HPA*）
+**
+** author : gouki04 2011-12-30
+*/
+
+#include "NavGraph.h"
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+
+#define NAV_ENTRANCE_SPLIT 6    // 边界上连续可走的子格达到这个数时在两端各放一个入口，否则只在中间放一个
+
+namespace
+{
+    // 八个方向，前4个是直走
+    const int DY[8] = { -1, 1, 0, 0, -1, -1, 1, 1 };
+    const int DX[8] = { 0, 0, -1, 1, -1, 1, -1, 1 };
+
+    typedef std::pair<int, int> QueueItem;     // 距离（或估价）, 编号
+    typedef std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem> > Queue;
+
+    // 抽象图搜索的队列：估价相同时先取已走距离长的，开阔的地方不用把所有等长的路线都展开
+    struct SearchItem
+    {
+        int f, g, id;
+
+        SearchItem(int f_, int g_, int id_) : f(f_), g(g_), id(id_) {}
+
+        bool operator>(const SearchItem& other) const
+        {
+            return f > other.f || (f == other.f && g < other.g);
+        }
+    };
+    typedef std::priority_queue<SearchItem, std::vector<SearchItem>, std::greater<SearchItem> > SearchQueue;
+
+    int sign(int v) { return (v > 0) - (v < 0); }
+}
+
+NavGraph::NavGraph()
+    : cellRows(0), cellCols(0), wordsPerRow(0), clusterShift(0), clusterRowCount(0), clusterColCount(0),
+      regionShift(0), regionRowCount(0), regionColCount(0), terrainWalkable(false),
+      repairStamp(0), searchStamp(0), expanded(0)
+{
+}
+
+void NavGraph::create(int tileRows, int tileCols, int clusterBits, int regionBits, bool walkableTerrain)
+{
+    cellRows = tileRows * 2;
+    cellCols = tileCols * 2;
+    wordsPerRow = (cellCols + 31) >> 5;
+    clusterShift = clusterBits + 1;
+    clusterRowCount = (cellRows + (1 << clusterShift) - 1) >> clusterShift;
+    clusterColCount = (cellCols + (1 << clusterShift) - 1) >> clusterShift;
+    regionShift = clusterShift + regionBits;
+    regionRowCount = (cellRows + (1 << regionShift) - 1) >> regionShift;
+    regionColCount = (cellCols + (1 << regionShift) - 1) >> regionShift;
+    terrainWalkable = walkableTerrain;
+
+    // 掩码为 0 的子格：地形能走时不能走，否则能走
+    bits.assign(cellRows * wordsPerRow, terrainWalkable ? 0u : ~0u);
+
+    int clusters = clusterRowCount * clusterColCount;
+    nodes.clear();
+    freeNodes.clear();
+    clusterNodes.assign(clusters, std::vector<int>());
+    open.assign(clusters, 0);
+    regionNodes.assign(regionRowCount * regionColCount, std::vector<int>());
+
+    borderMark.assign(clusters * 2, 0);
+    clusterMark.assign(clusters, 0);
+    regionBorderMark.assign(regionRowCount * regionColCount * 2, 0);
+    regionMark.assign(regionRowCount * regionColCount, 0);
+    repairStamp = 0;
+
+    int size = 1 << clusterShift;
+    localDist.assign(size * size, -1);
+    localParent.assign(size * size, -1);
+
+    g.clear();
+    parent.clear();
+    searchMark.clear();
+    goalDist.clear();
+    searchStamp = 0;
+    expanded = 0;
+}
+
+void NavGraph::setWalkable(int y, int x, bool value)
+{
+    unsigned int& word = bits[y * wordsPerRow + (x >> 5)];
+    if (value) word |= 1u << (x & 31);
+    else word &= ~(1u << (x & 31));
+}
+
+void NavGraph::setTile(int r, int c, int mask)
+{
+    // 掩码的第 k 位是子格 (k >> 1, k & 1)
+    for (int k = 0; k < 4; ++k)
+        setWalkable(r * 2 + (k >> 1), c * 2 + (k & 1), (((mask >> k) & 1) != 0) == terrainWalkable);
+}
+
+void NavGraph::clusterRect(int cluster, int& y1, int& x1, int& y2, int& x2) const
+{
+    y1 = (cluster / clusterColCount) << clusterShift;
+    x1 = (cluster % clusterColCount) << clusterShift;
+    y2 = y1 + (1 << clusterShift) < cellRows ? y1 + (1 << clusterShift) : cellRows;
+    x2 = x1 + (1 << clusterShift) < cellCols ? x1 + (1 << clusterShift) : cellCols;
+}
+
+bool NavGraph::computeOpen(int cluster) const
+{
+    int y1, x1, y2, x2;
+    clusterRect(cluster, y1, x1, y2, x2);
+
+    for (int y = y1; y < y2; ++y)
+        for (int x = x1; x < x2; ++x)
+            if (!walkable(y, x)) return false;
+    return true;
+}
+
+int NavGraph::localIndex(int cluster, int y, int x) const
+{
+    int y1 = (cluster / clusterColCount) << clusterShift;
+    int x1 = (cluster % clusterColCount) << clusterShift;
+    return ((y - y1) << clusterShift) + (x - x1);
+}
+
+int NavGraph::octile(NavPoint a, NavPoint b)
+{
+    int dy = a.y > b.y ? a.y - b.y : b.y - a.y;
+    int dx = a.x > b.x ? a.x - b.x : b.x - a.x;
+    return dy < dx ? COST_DIAGONAL * dy + COST_STRAIGHT * (dx - dy) : COST_DIAGONAL * dx + COST_STRAIGHT * (dy - dx);
+}
+
+int NavGraph::findNode(int cluster, int y, int x) const
+{
+    const std::vector<int>& list = clusterNodes[cluster];
+    for (size_t i = 0; i < list.size(); ++i)
+    {
+        const Node& node = nodes[list[i]];
+        if (node.pos.y == y && node.pos.x == x)
+            return list[i];
+    }
+    return -1;
+}
+
+int NavGraph::addNode(int cluster, int y, int x, int side)
+{
+    int id = findNode(cluster, y, x);
+    if (id == -1)
+    {
+        if (freeNodes.empty())
+        {
+            id = static_cast<int>(nodes.size());
+            nodes.push_back(Node());
+        }
+        else
+        {
+            id = freeNodes.back();
+            freeNodes.pop_back();
+        }
+
+        Node& node = nodes[id];
+        node.pos.y = y;
+        node.pos.x = x;
+        node.cluster = cluster;
+        node.sides = 0;
+        node.regionSides = 0;
+        node.edges.clear();
+        node.regionEdges.clear();
+        clusterNodes[cluster].push_back(id);
+    }
+
+    nodes[id].sides |= side;
+    return id;
+}
+
+namespace
+{
+    template <typename Edges>
+    void eraseEdgesTo(Edges& edges, int to)
+    {
+        for (size_t i = 0; i < edges.size(); )
+        {
+            if (edges[i].to == to)
+            {
+                edges[i] = edges.back();
+                edges.pop_back();
+            }
+            else
+            {
+                ++i;
+            }
+        }
+    }
+}
+
+void NavGraph::freeNode(int id)
+{
+    Node& node = nodes[id];
+    if (node.regionSides)
+        removeRegionNode(id);
+
+    // 边都是双向的，对面的节点上也要去掉
+    for (size_t i = 0; i < node.edges.size(); ++i)
+        eraseEdgesTo(nodes[node.edges[i].to].edges, id);
+    std::vector<Edge>().swap(node.edges);
+
+    std::vector<int>& list = clusterNodes[node.cluster];
+    list.erase(std::find(list.begin(), list.end(), id));
+
+    node.cluster = -1;
+    freeNodes.push_back(id);
+}
+
+void NavGraph::addRegionNode(int id, int side)
+{
+    Node& node = nodes[id];
+    if (node.regionSides == 0)
+        regionNodes[regionOf(node.pos.y, node.pos.x)].push_back(id);
+    node.regionSides |= side;
+}
+
+void NavGraph::removeRegionNode(int id)
+{
+    Node& node = nodes[id];
+    for (size_t i = 0; i < node.regionEdges.size(); ++i)
+        eraseEdgesTo(nodes[node.regionEdges[i].to].regionEdges, id);
+    std::vector<Edge>().swap(node.regionEdges);
+
+    std::vector<int>& list = regionNodes[regionOf(node.pos.y, node.pos.x)];
+    list.erase(std::find(list.begin(), list.end(), id));
+    node.regionSides = 0;
+}
+
+int NavGraph::regionNodeCount() const
+{
+    int n = 0;
+    for (size_t i = 0; i < regionNodes.size(); ++i)
+        n += static_cast<int>(regionNodes[i].size());
+    return n;
+}
+
+int NavGraph::edgeCount() const
+{
+    int n = 0;
+    for (size_t i = 0; i < nodes.size(); ++i)
+        n += static_cast<int>(nodes[i].edges.size());
+    return n;
+}
+
+void NavGraph::rebuildBorder(int cr, int cc, int dir)
+{
+    int ncr = cr + dir, ncc = cc + 1 - dir;
+    if (ncr >= clusterRowCount || ncc >= clusterColCount)
+        return;
+
+    int a = cr * clusterColCount + cc, b = ncr * clusterColCount + ncc;
+    int sideA = dir == 0 ? SIDE_RIGHT : SIDE_BOTTOM;
+    int sideB = dir == 0 ? SIDE_LEFT : SIDE_TOP;
+
+    // 去掉这条边界上原来的入口：跨边界的边，以及不再是任何边界上的入口的节点
+    std::vector<int> old(clusterNodes[a]);
+    old.insert(old.end(), clusterNodes[b].begin(), clusterNodes[b].end());
+    for (size_t i = 0; i < old.size(); ++i)
+    {
+        Node& node = nodes[old[i]];
+        int side = node.cluster == a ? sideA : sideB;
+        if (!(node.sides & side))
+            continue;
+
+        int other = node.cluster == a ? b : a;
+        for (size_t k = 0; k < node.edges.size(); )
+        {
+            int to = node.edges[k].to;
+            if (nodes[to].cluster == other)
+            {
+                eraseEdgesTo(nodes[to].edges, old[i]);
+                node.edges[k] = node.edges.back();
+                node.edges.pop_back();
+            }
+            else
+            {
+                ++k;
+            }
+        }
+
+        node.sides &= ~side;
+        if (node.sides == 0)
+            freeNode(old[i]);
+    }
+
+    // 边界两侧的子格
+    int y1, x1, y2, x2;
+    clusterRect(a, y1, x1, y2, x2);
+    int length = dir == 0 ? y2 - y1 : x2 - x1;
+
+    int runStart = -1;
+    for (int i = 0; i <= length; ++i)
+    {
+        bool pass = false;
+        if (i < length)
+        {
+            pass = dir == 0
+                ? walkable(y1 + i, x2 - 1) && walkable(y1 + i, x2)
+                : walkable(y2 - 1, x1 + i) && walkable(y2, x1 + i);
+        }
+
+        if (pass)
+        {
+            if (runStart < 0)
+                runStart = i;
+            continue;
+        }
+        if (runStart < 0)
+            continue;
+
+        // 连续可走的一段 [runStart, i)，短的在中间放一个入口，长的在两端各放一个
+        int at[2] = { (runStart + i - 1) / 2, -1 };
+        if (i - runStart >= NAV_ENTRANCE_SPLIT)
+        {
+            at[0] = runStart;
+            at[1] = i - 1;
+        }
+
+        for (int k = 0; k < 2 && at[k] >= 0; ++k)
+        {
+            int na, nb;
+            if (dir == 0)
+            {
+                na = addNode(a, y1 + at[k], x2 - 1, sideA);
+                nb = addNode(b, y1 + at[k], x2, sideB);
+            }
+            else
+            {
+                na = addNode(a, y2 - 1, x1 + at[k], sideA);
+                nb = addNode(b, y2, x1 + at[k], sideB);
+            }
+
+            Edge e = { nb, COST_STRAIGHT };
+            nodes[na].edges.push_back(e);
+            e.to = na;
+            nodes[nb].edges.push_back(e);
+        }
+        runStart = -1;
+    }
+}
+
+void NavGraph::searchCluster(int cluster, NavPoint from)
+{
+    int y1, x1, y2, x2;
+    clusterRect(cluster, y1, x1, y2, x2);
+
+    std::fill(localDist.begin(), localDist.end(), -1);
+
+    Queue queue;
+    int start = localIndex(cluster, from.y, from.x);
+    localDist[start] = 0;
+    localParent[start] = -1;
+    queue.push(QueueItem(0, start));
+
+    while (!queue.empty())
+    {
+        QueueItem item = queue.top();
+        queue.pop();
+
+        int i = item.second;
+        if (item.first != localDist[i])
+            continue;
+
+        int y = y1 + (i >> clusterShift), x = x1 + (i & ((1 << clusterShift) - 1));
+        for (int k = 0; k < 8; ++k)
+        {
+            int ny = y + DY[k], nx = x + DX[k];
+            if (ny < y1 || ny >= y2 || nx < x1 || nx >= x2 || !walkable(ny, nx))
+                continue;
+
+            // 不能切角
+            if (k >= 4 && (!walkable(ny, x) || !walkable(y, nx)))
+                continue;
+
+            int j = localIndex(cluster, ny, nx);
+            int d = item.first + (k < 4 ? COST_STRAIGHT : COST_DIAGONAL);
+            if (localDist[j] < 0 || d < localDist[j])
+            {
+                localDist[j] = d;
+                localParent[j] = i;
+                queue.push(QueueItem(d, j));
+            }
+        }
+    }
+}
+
+void NavGraph::rebuildIntra(int cluster)
+{
+    const std::vector<int>& list = clusterNodes[cluster];
+
+    // 先去掉所有簇内边
+    for (size_t i = 0; i < list.size(); ++i)
+    {
+        std::vector<Edge>& edges = nodes[list[i]].edges;
+        for (size_t k = 0; k < edges.size(); )
+        {
+            if (nodes[edges[k].to].cluster == cluster)
+            {
+                edges[k] = edges.back();
+                edges.pop_back();
+            }
+            else
+            {
+                ++k;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < list.size(); ++i)
+    {
+        Node& from = nodes[list[i]];
+        if (!open[cluster])
+            searchCluster(cluster, from.pos);
+
+        for (size_t j = i + 1; j < list.size(); ++j)
+        {
+            Node& to = nodes[list[j]];
+            int cost = open[cluster] ? octile(from.pos, to.pos) : localDist[localIndex(cluster, to.pos.y, to.pos.x)];
+            if (cost < 0)
+                continue;
+
+            Edge e = { list[j], cost };
+            from.edges.push_back(e);
+            e.to = list[i];
+            to.edges.push_back(e);
+        }
+    }
+}
+
+void NavGraph::repair(const std::vector<int>& changed)
+{
+    ++repairStamp;
+
+    std::vector<int> borders, clusters;
+    for (size_t i = 0; i < changed.size(); ++i)
+    {
+        int k = changed[i];
+        int cr = k / clusterColCount, cc = k % clusterColCount;
+        open[k] = computeOpen(k) ? 1 : 0;
+
+        // 四条边界，用左上方的簇和方向表示
+        int border[4][3] = { { cr, cc, 0 }, { cr, cc, 1 }, { cr, cc - 1, 0 }, { cr - 1, cc, 1 } };
+        for (int b = 0; b < 4; ++b)
+        {
+            if (border[b][0] < 0 || border[b][1] < 0)
+                continue;
+
+            int key = (border[b][0] * clusterColCount + border[b][1]) * 2 + border[b][2];
+            if (borderMark[key] != repairStamp)
+            {
+                borderMark[key] = repairStamp;
+                borders.push_back(key);
+            }
+        }
+
+        // 自己和相邻的簇的入口都可能变了
+        int around[5][2] = { { cr, cc }, { cr, cc - 1 }, { cr, cc + 1 }, { cr - 1, cc }, { cr + 1, cc } };
+        for (int n = 0; n < 5; ++n)
+        {
+            int ar = around[n][0], ac = around[n][1];
+            if (ar < 0 || ac < 0 || ar >= clusterRowCount || ac >= clusterColCount)
+                continue;
+
+            int cluster = ar * clusterColCount + ac;
+            if (clusterMark[cluster] != repairStamp)
+            {
+                clusterMark[cluster] = repairStamp;
+                clusters.push_back(cluster);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < borders.size(); ++i)
+    {
+        int cluster = borders[i] / 2;
+        rebuildBorder(cluster / clusterColCount, cluster % clusterColCount, borders[i] % 2);
+    }
+
+    for (size_t i = 0; i < clusters.size(); ++i)
+        rebuildIntra(clusters[i]);
+
+    // 第二级：改过的簇落在区域边界上的边，以及簇内边变了或者区域入口变了的区域
+    int mask = (1 << (regionShift - clusterShift)) - 1, bits = regionShift - clusterShift;
+    std::vector<int> regionBorders, regions;
+    for (size_t i = 0; i < changed.size(); ++i)
+    {
+        int cr = changed[i] / clusterColCount, cc = changed[i] % clusterColCount;
+        int rr = cr >> bits, rc = cc >> bits;
+
+        int border[4][4] =
+        {
+            { rr, rc, 0, ((cc + 1) & mask) == 0 }, { rr, rc, 1, ((cr + 1) & mask) == 0 },
+            { rr, rc - 1, 0, (cc & mask) == 0 }, { rr - 1, rc, 1, (cr & mask) == 0 }
+        };
+        for (int b = 0; b < 4; ++b)
+        {
+            if (!border[b][3] || border[b][0] < 0 || border[b][1] < 0)
+                continue;
+
+            int key = (border[b][0] * regionColCount + border[b][1]) * 2 + border[b][2];
+            if (regionBorderMark[key] != repairStamp)
+            {
+                regionBorderMark[key] = repairStamp;
+                regionBorders.push_back(key);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < clusters.size(); ++i)
+    {
+        int region = ((clusters[i] / clusterColCount) >> bits) * regionColCount + ((clusters[i] % clusterColCount) >> bits);
+        if (regionMark[region] != repairStamp)
+        {
+            regionMark[region] = repairStamp;
+            regions.push_back(region);
+        }
+    }
+
+    for (size_t i = 0; i < regionBorders.size(); ++i)
+    {
+        int region = regionBorders[i] / 2, dir = regionBorders[i] % 2;
+        int rr = region / regionColCount, rc = region % regionColCount;
+        rebuildRegionBorder(rr, rc, dir);
+
+        // 边界另一侧的区域的入口也变了
+        int other = (rr + dir) * regionColCount + rc + 1 - dir;
+        if (rr + dir < regionRowCount && rc + 1 - dir < regionColCount && regionMark[other] != repairStamp)
+        {
+            regionMark[other] = repairStamp;
+            regions.push_back(other);
+        }
+    }
+
+    for (size_t i = 0; i < regions.size(); ++i)
+        rebuildRegionIntra(regions[i]);
+}
+
+void NavGraph::rebuildRegionBorder(int rr, int rc, int dir)
+{
+    int nrr = rr + dir, nrc = rc + 1 - dir;
+    if (nrr >= regionRowCount || nrc >= regionColCount)
+        return;
+
+    int a = rr * regionColCount + rc, b = nrr * regionColCount + nrc;
+    int sideA = dir == 0 ? SIDE_RIGHT : SIDE_BOTTOM;
+    int sideB = dir == 0 ? SIDE_LEFT : SIDE_TOP;
+
+    // 去掉这条边界上原来的区域入口
+    std::vector<int> old(regionNodes[a]);
+    old.insert(old.end(), regionNodes[b].begin(), regionNodes[b].end());
+    for (size_t i = 0; i < old.size(); ++i)
+    {
+        Node& node = nodes[old[i]];
+        bool inA = regionOf(node.pos.y, node.pos.x) == a;
+        int side = inA ? sideA : sideB;
+        if (!(node.regionSides & side))
+            continue;
+
+        for (size_t k = 0; k < node.regionEdges.size(); )
+        {
+            int to = node.regionEdges[k].to;
+            if (regionOf(nodes[to].pos.y, nodes[to].pos.x) == (inA ? b : a))
+            {
+                eraseEdgesTo(nodes[to].regionEdges, old[i]);
+                node.regionEdges[k] = node.regionEdges.back();
+                node.regionEdges.pop_back();
+            }
+            else
+            {
+                ++k;
+            }
+        }
+
+        node.regionSides &= ~side;
+        if (node.regionSides == 0)
+            removeRegionNode(old[i]);
+    }
+
+    // 边界上第一级的入口，按在边界上的位置排好
+    int y1 = rr << regionShift, x1 = rc << regionShift;
+    int y2 = y1 + (1 << regionShift) < cellRows ? y1 + (1 << regionShift) : cellRows;
+    int x2 = x1 + (1 << regionShift) < cellCols ? x1 + (1 << regionShift) : cellCols;
+
+    std::vector<std::pair<int, int> > entrances;
+    for (int y = y1 >> clusterShift; y <= (y2 - 1) >> clusterShift; ++y)
+    {
+        for (int x = x1 >> clusterShift; x <= (x2 - 1) >> clusterShift; ++x)
+        {
+            // 只看贴着这条边界的簇
+            if (dir == 0 ? x != (x2 - 1) >> clusterShift : y != (y2 - 1) >> clusterShift)
+                continue;
+
+            const std::vector<int>& list = clusterNodes[y * clusterColCount + x];
+            for (size_t i = 0; i < list.size(); ++i)
+            {
+                const Node& node = nodes[list[i]];
+                if (node.sides & sideA)
+                    entrances.push_back(std::make_pair(dir == 0 ? node.pos.y - y1 : node.pos.x - x1, list[i]));
+            }
+        }
+    }
+    std::sort(entrances.begin(), entrances.end());
+
+    // 同一段连续可走的边界上只保留第一对和最后一对入口
+    for (size_t first = 0; first < entrances.size(); )
+    {
+        size_t last = first;
+        while (last + 1 < entrances.size())
+        {
+            bool pass = true;
+            for (int i = entrances[last].first + 1; i < entrances[last + 1].first && pass; ++i)
+            {
+                pass = dir == 0
+                    ? walkable(y1 + i, x2 - 1) && walkable(y1 + i, x2)
+                    : walkable(y2 - 1, x1 + i) && walkable(y2, x1 + i);
+            }
+            if (!pass)
+                break;
+            ++last;
+        }
+
+        size_t pick[2] = { first, last };
+        for (int k = 0; k < (last != first ? 2 : 1); ++k)
+        {
+            int na = entrances[pick[k]].second;
+            const Node& node = nodes[na];
+            int by = dir == 0 ? node.pos.y : y2, bx = dir == 0 ? x2 : node.pos.x;
+
+            // 边界另一侧对应的入口
+            for (size_t e = 0; e < node.edges.size(); ++e)
+            {
+                int nb = node.edges[e].to;
+                if (nodes[nb].pos.y != by || nodes[nb].pos.x != bx)
+                    continue;
+
+                addRegionNode(na, sideA);
+                addRegionNode(nb, sideB);
+
+                Edge edge = { nb, COST_STRAIGHT };
+                nodes[na].regionEdges.push_back(edge);
+                edge.to = na;
+                nodes[nb].regionEdges.push_back(edge);
+                break;
+            }
+        }
+        first = last + 1;
+    }
+}
+
+void NavGraph::rebuildRegionIntra(int region)
+{
+    const std::vector<int>& list = regionNodes[region];
+
+    // 先去掉所有区域内的边
+    for (size_t i = 0; i < list.size(); ++i)
+    {
+        std::vector<Edge>& edges = nodes[list[i]].regionEdges;
+        for (size_t k = 0; k < edges.size(); )
+        {
+            if (regionOf(nodes[edges[k].to].pos.y, nodes[edges[k].to].pos.x) == region)
+            {
+                edges[k] = edges.back();
+                edges.pop_back();
+            }
+            else
+            {
+                ++k;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < list.size(); ++i)
+    {
+        Edge start = { list[i], 0 };
+        seeds.assign(1, start);
+        searchGraph(1, region, seeds, -1, nodes[list[i]].pos);
+
+        for (size_t j = i + 1; j < list.size(); ++j)
+        {
+            if (searchMark[list[j]] != searchStamp)
+                continue;
+
+            Edge e = { list[j], g[list[j]] };
+            nodes[list[i]].regionEdges.push_back(e);
+            e.to = list[i];
+            nodes[list[j]].regionEdges.push_back(e);
+        }
+    }
+}
+
+int NavGraph::cellDistance(int cluster, NavPoint from, NavPoint to) const
+{
+    return open[cluster] ? octile(from, to) : localDist[localIndex(cluster, to.y, to.x)];
+}
+
+void NavGraph::connectCell(NavPoint p, std::vector<Edge>& out)
+{
+    int cluster = clusterOf(p.y, p.x);
+    if (!open[cluster])
+        searchCluster(cluster, p);
+
+    out.clear();
+    const std::vector<int>& list = clusterNodes[cluster];
+    for (size_t i = 0; i < list.size(); ++i)
+    {
+        Edge e = { list[i], cellDistance(cluster, p, nodes[list[i]].pos) };
+        if (e.cost >= 0)
+            out.push_back(e);
+    }
+}
+
+void NavGraph::prepareSearch()
+{
+    if (g.size() < nodes.size() + 1)
+    {
+        g.resize(nodes.size() + 1);
+        parent.resize(nodes.size() + 1);
+        searchMark.resize(nodes.size() + 1, 0);
+        goalDist.resize(nodes.size() + 1);
+    }
+}
+
+int NavGraph::searchGraph(int level, int region, const std::vector<Edge>& starts, int goalArea, NavPoint goal)
+{
+    prepareSearch();
+    int goalId = static_cast<int>(nodes.size());
+    ++searchStamp;
+
+    SearchQueue queue;
+    for (size_t i = 0; i < starts.size(); ++i)
+    {
+        int to = starts[i].to, d = starts[i].cost;
+        if (searchMark[to] == searchStamp && d >= g[to])
+            continue;
+
+        searchMark[to] = searchStamp;
+        g[to] = d;
+        parent[to] = -1;
+        queue.push(SearchItem(d + (goalArea < 0 || to == goalId ? 0 : octile(nodes[to].pos, goal)), d, to));
+    }
+
+    while (!queue.empty())
+    {
+        SearchItem item = queue.top();
+        queue.pop();
+
+        int id = item.id;
+        if (item.g != g[id])
+            continue;
+        if (id == goalId)
+            return g[id];
+
+        ++expanded;
+
+        const Node& node = nodes[id];
+        const std::vector<Edge>& edges = level == 1 ? node.edges : node.regionEdges;
+        int area = level == 1 ? node.cluster : regionOf(node.pos.y, node.pos.x);
+        for (size_t k = 0; k <= edges.size(); ++k)
+        {
+            int to, cost;
+            if (k < edges.size())
+            {
+                to = edges[k].to;
+                cost = edges[k].cost;
+                if (region >= 0 && regionOf(nodes[to].pos.y, nodes[to].pos.x) != region)
+                    continue;
+            }
+            else
+            {
+                // 终点所在的簇（区域）的节点可以直接走到终点
+                if (goalArea < 0 || area != goalArea || goalDist[id] < 0)
+                    break;
+                to = goalId;
+                cost = goalDist[id];
+            }
+
+            int d = g[id] + cost;
+            if (searchMark[to] == searchStamp && d >= g[to])
+                continue;
+
+            searchMark[to] = searchStamp;
+            g[to] = d;
+            parent[to] = id;
+            queue.push(SearchItem(d + (goalArea < 0 || to == goalId ? 0 : octile(nodes[to].pos, goal)), d, to));
+        }
+    }
+    return -1;
+}
+
+bool NavGraph::findPath(NavPoint start, NavPoint goal, std::vector<NavPoint>& waypoints)
+{
+    waypoints.clear();
+    expanded = 0;
+
+    if (start.y < 0 || start.y >= cellRows || start.x < 0 || start.x >= cellCols
+        || goal.y < 0 || goal.y >= cellRows || goal.x < 0 || goal.x >= cellCols
+        || !walkable(start.y, start.x) || !walkable(goal.y, goal.x))
+        return false;
+
+    waypoints.push_back(start);
+    if (sameCell(start, goal))
+        return true;
+
+    int goalId = static_cast<int>(nodes.size());
+    int sc = clusterOf(start.y, start.x), gc = clusterOf(goal.y, goal.x);
+    int sr = regionOf(start.y, start.x), gr = regionOf(goal.y, goal.x);
+
+    // 终点所在区域的入口在区域内到终点的距离（边是双向的，从终点往外搜）
+    connectCell(goal, seeds);
+    searchGraph(1, gr, seeds, -1, goal);
+
+    const std::vector<int>& goalNodes = regionNodes[gr];
+    for (size_t i = 0; i < goalNodes.size(); ++i)
+        goalDist[goalNodes[i]] = searchMark[goalNodes[i]] == searchStamp ? g[goalNodes[i]] : -1;
+
+    // 起点不出区域直接走到终点：同一个簇时在簇内直接走，或者经过起点所在簇的入口
+    connectCell(start, seeds);
+    int direct = sc == gc ? cellDistance(sc, start, goal) : -1;
+    if (sr == gr)
+    {
+        for (size_t i = 0; i < seeds.size(); ++i)
+        {
+            int id = seeds[i].to;
+            if (searchMark[id] == searchStamp && (direct < 0 || seeds[i].cost + g[id] < direct))
+                direct = seeds[i].cost + g[id];
+        }
+    }
+
+    // 起点所在区域的入口在区域内的距离
+    searchGraph(1, sr, seeds, -1, start);
+
+    seeds.clear();
+    const std::vector<int>& startNodes = regionNodes[sr];
+    for (size_t i = 0; i < startNodes.size(); ++i)
+    {
+        if (searchMark[startNodes[i]] != searchStamp)
+            continue;
+
+        Edge e = { startNodes[i], g[startNodes[i]] };
+        seeds.push_back(e);
+    }
+    if (direct >= 0)
+    {
+        Edge e = { goalId, direct };
+        seeds.push_back(e);
+    }
+
+    if (searchGraph(2, -1, seeds, gr, goal) < 0)
+    {
+        waypoints.clear();
+        return false;
+    }
+
+    appendRoute(goal, waypoints);
+    return true;
+}
+
+void NavGraph::appendRoute(NavPoint goal, std::vector<NavPoint>& out) const
+{
+    // 倒着取出经过的节点，起点和终点本身是节点时不重复
+    std::vector<NavPoint> route(1, goal);
+    for (int n = parent[nodes.size()]; n != -1; n = parent[n])
+        route.push_back(nodes[n].pos);
+
+    for (size_t i = route.size(); i-- > 0; )
+    {
+        if (!sameCell(route[i], out.back()))
+            out.push_back(route[i]);
+    }
+}
+
+bool NavGraph::refineRegion(int region, NavPoint from, NavPoint to, std::vector<NavPoint>& out)
+{
+    prepareSearch();
+    int goalId = static_cast<int>(nodes.size());
+    int fc = clusterOf(from.y, from.x), tc = clusterOf(to.y, to.x);
+
+    // 终点所在簇的入口到终点的距离，要在起点的簇内搜索之前算
+    const std::vector<int>& goalNodes = clusterNodes[tc];
+    for (size_t i = 0; i < goalNodes.size(); ++i)
+        goalDist[goalNodes[i]] = -1;
+
+    connectCell(to, seeds);
+    for (size_t i = 0; i < seeds.size(); ++i)
+        goalDist[seeds[i].to] = seeds[i].cost;
+
+    connectCell(from, seeds);
+    if (fc == tc)
+    {
+        Edge e = { goalId, cellDistance(fc, from, to) };
+        if (e.cost >= 0)
+            seeds.push_back(e);
+    }
+
+    if (searchGraph(1, region, seeds, tc, to) < 0)
+        return false;
+
+    appendRoute(to, out);
+    return true;
+}
+
+bool NavGraph::refinePath(const std::vector<NavPoint>& waypoints, std::vector<NavPoint>& path)
+{
+    path.clear();
+    if (waypoints.empty())
+        return false;
+
+    // 先在每个区域内展开成第一级的入口，跨区域的一段是边界两侧相邻的两个入口
+    std::vector<NavPoint> entrances(1, waypoints[0]);
+    for (size_t i = 1; i < waypoints.size(); ++i)
+    {
+        int region = regionOf(waypoints[i - 1].y, waypoints[i - 1].x);
+        if (region != regionOf(waypoints[i].y, waypoints[i].x))
+            entrances.push_back(waypoints[i]);
+        else if (!refineRegion(region, waypoints[i - 1], waypoints[i], entrances))
+            return false;
+    }
+
+    path.push_back(entrances[0]);
+    for (size_t i = 1; i < entrances.size(); ++i)
+    {
+        NavPoint from = entrances[i - 1], to = entrances[i];
+        int cluster = clusterOf(from.y, from.x);
+
+        // 跨簇的一段是边界两侧相邻的两个入口
+        if (cluster != clusterOf(to.y, to.x))
+        {
+            path.push_back(to);
+            continue;
+        }
+
+        // 全部能走的簇里先斜走再直走
+        if (open[cluster])
+        {
+            NavPoint p = from;
+            while (!sameCell(p, to))
+            {
+                p.y += sign(to.y - p.y);
+                p.x += sign(to.x - p.x);
+                path.push_back(p);
+            }
+            continue;
+        }
+
+        searchCluster(cluster, from);
+        int i1 = localIndex(cluster, to.y, to.x);
+        if (localDist[i1] < 0)
+            return false;
+
+        size_t begin = path.size();
+        int y1 = (cluster / clusterColCount) << clusterShift;
+        int x1 = (cluster % clusterColCount) << clusterShift;
+        for (int n = i1; localParent[n] != -1; n = localParent[n])
+        {
+            NavPoint p = { y1 + (n >> clusterShift), x1 + (n & ((1 << clusterShift) - 1)) };
+            path.push_back(p);
+        }
+        std::reverse(path.begin() + begin, path.end());
+    }
+    return true;
+}
+
@@ -0,0 +1,181 @@
+/*
+** 导航网格和分层寻路（HPA*）
+**
+** 每个元件分成 2*2 个子格，每个子格对应元件的一个角：角的值决定子格能不能走，
+** 所以部分填充的元件（掩码 1 ~ 14）也有能走和不能走的部分，与画出来的地形一致。
+** 斜着走时两侧的子格都必须能走（不能切角），对角的两个角（掩码 6 和 9）因此不相连，与碰撞轮廓一致。
+**
+** 子格按簇（一个地图块）分组，相邻两簇之间每段连续可走的边界上放一到两个入口，
+** 入口是抽象图的节点：跨簇的边连接边界两侧的入口，簇内的边是同一簇中入口之间的最短距离。
+** 簇再按区域（(1 << regionBits)*(1 << regionBits) 个簇）分组，组成第二级：相邻两区域之间每段连续可走的边界上
+** 从第一级的入口中选出一到两对作为区域的入口，区域内的边是只在区域内走第一级图的最短距离。
+**
+** 寻路时先把起点和终点在所在区域内连到区域的入口，在第二级图上做 A*，得到经过的区域入口；
+** 需要逐格的路径时再把每一段在所在区域内展开成第一级的入口，再在每个簇内展开成子格（refinePath）。
+** 路径不保证最短，但能走到时一定能找到。
+**
+** 修改地图后只需要对改过的簇调用 repair()：重建它四条边界上的入口，重算它和相邻簇的簇内边，
+** 再重建落在这些簇上的区域边界，重算涉及的区域的区域内边。
+**
+** 距离：直走 10，斜走 14
+**
+** author : gouki04 2011-12-30
+*/
+
+#ifndef NAVGRAPH_H
+#define NAVGRAPH_H
+
+#include <vector>
+
+#define NAV_REGION_BITS 3   // 默认每个区域 8*8 个簇
+
+// 子格坐标
+struct NavPoint
+{
+    int y, x;
+};
+
+class NavGraph
+{
+public:
+    enum { COST_STRAIGHT = 10, COST_DIAGONAL = 14 };
+
+    NavGraph();
+
+    // tileRows*tileCols 个元件的地图，每簇 (1 << clusterBits)*(1 << clusterBits) 个元件，
+    // 每个区域 (1 << regionBits)*(1 << regionBits) 个簇
+    // terrainWalkable 为 true 时地形（角为1）能走，否则地形以外的部分能走
+    // 所有子格一开始都按掩码 0 设置，之后用 setTile() 填入地图，再对所有簇调用 repair()
+    void create(int tileRows, int tileCols, int clusterBits, int regionBits, bool terrainWalkable);
+
+    int rows() const { return cellRows; }
+    int cols() const { return cellCols; }
+    int clusterRows() const { return clusterRowCount; }
+    int clusterCols() const { return clusterColCount; }
+
+    bool walkable(int y, int x) const
+    {
+        return (bits[y * wordsPerRow + (x >> 5)] >> (x & 31)) & 1;
+    }
+
+    // 按元件 (r, c) 的掩码设置它的 2*2 个子格，之后要对所在的簇调用 repair()
+    void setTile(int r, int c, int mask);
+
+    // 子格改过的簇（cr * clusterCols() + cc），重建它们的入口和簇内边
+    void repair(const std::vector<int>& changed);
+
+    // 在第二级图上寻路，waypoints 依次是起点、经过的区域入口和终点，走不通时返回 false
+    bool findPath(NavPoint start, NavPoint goal, std::vector<NavPoint>& waypoints);
+
+    // 把 findPath() 的结果展开成逐格的路径（包含起点和终点）
+    bool refinePath(const std::vector<NavPoint>& waypoints, std::vector<NavPoint>& path);
+
+    int nodeCount() const { return static_cast<int>(nodes.size() - freeNodes.size()); }
+    int edgeCount() const;
+    int regionNodeCount() const;
+
+    // 最近一次 findPath() 展开的抽象节点数（包括在起点和终点的区域内连接区域入口的搜索）
+    int expandedCount() const { return expanded; }
+
+private:
+    NavGraph(const NavGraph&);
+    NavGraph& operator=(const NavGraph&);
+
+    enum
+    {
+        SIDE_LEFT = 0x1,
+        SIDE_RIGHT = 0x2,
+        SIDE_TOP = 0x4,
+        SIDE_BOTTOM = 0x8
+    };
+
+    struct Edge
+    {
+        int to;
+        int cost;
+    };
+
+    struct Node
+    {
+        NavPoint pos;
+        int cluster;    // 已释放的节点为 -1
+        int sides;      // 作为哪几条簇边界上的入口
+        int regionSides;            // 作为哪几条区域边界上的入口，为0时不是第二级的节点
+        std::vector<Edge> edges;
+        std::vector<Edge> regionEdges;  // 第二级的边
+    };
+
+    void setWalkable(int y, int x, bool value);
+
+    int clusterOf(int y, int x) const { return (y >> clusterShift) * clusterColCount + (x >> clusterShift); }
+    int regionOf(int y, int x) const { return (y >> regionShift) * regionColCount + (x >> regionShift); }
+    void clusterRect(int cluster, int& y1, int& x1, int& y2, int& x2) const;
+    bool computeOpen(int cluster) const;
+
+    int findNode(int cluster, int y, int x) const;
+    int addNode(int cluster, int y, int x, int side);
+    void freeNode(int id);
+    void addRegionNode(int id, int side);
+    void removeRegionNode(int id);
+
+    // dir 为 0 时是簇 (cr, cc) 和右边的簇之间的边界，为 1 时是和下边的簇之间的
+    void rebuildBorder(int cr, int cc, int dir);
+    void rebuildIntra(int cluster);
+    void rebuildRegionBorder(int rr, int rc, int dir);
+    void rebuildRegionIntra(int region);
+
+    // 簇内从 from 出发的 Dijkstra，dist 和 parent 按簇内的子格编号，走不到的为 -1
+    void searchCluster(int cluster, NavPoint from);
+    int localIndex(int cluster, int y, int x) const;
+
+    // searchCluster() 之后簇内从 from 到 to 的距离，走不到时为 -1
+    int cellDistance(int cluster, NavPoint from, NavPoint to) const;
+
+    // 把子格 p 连到所在簇的入口：out 里放入能走到的入口和距离
+    void connectCell(NavPoint p, std::vector<Edge>& out);
+
+    void prepareSearch();
+
+    // 从 seeds 出发在第 level 级的图上搜索，region 不为 -1 时只走这个区域内的节点
+    // goalArea 是终点所在的簇（第二级时是区域），其中的节点 n 到终点的距离是 goalDist[n]；
+    // goalArea 为 -1 时没有终点，搜完所有能走到的节点。结果留在 g、parent、searchMark 里，返回到终点的距离
+    int searchGraph(int level, int region, const std::vector<Edge>& seeds, int goalArea, NavPoint goal);
+
+    // searchGraph() 走到终点之后，把经过的节点和终点依次放到 out 后面（out 的最后一个是起点）
+    void appendRoute(NavPoint goal, std::vector<NavPoint>& out) const;
+
+    // 在区域 region 内把 from 到 to 展开成第一级的入口，依次放到 out 后面（out 的最后一个是 from）
+    bool refineRegion(int region, NavPoint from, NavPoint to, std::vector<NavPoint>& out);
+
+    static int octile(NavPoint a, NavPoint b);
+    static bool sameCell(NavPoint a, NavPoint b) { return a.y == b.y && a.x == b.x; }
+
+    int cellRows, cellCols, wordsPerRow;
+    int clusterShift;   // 簇的边长（子格）的位数
+    int clusterRowCount, clusterColCount;
+    int regionShift;    // 区域的边长（子格）的位数
+    int regionRowCount, regionColCount;
+    bool terrainWalkable;
+    std::vector<unsigned int> bits;
+
+    std::vector<Node> nodes;
+    std::vector<int> freeNodes;
+    std::vector<std::vector<int> > clusterNodes;
+    std::vector<unsigned char> open;    // 每个簇，所有子格都能走，簇内距离直接按八方向距离算
+    std::vector<std::vector<int> > regionNodes;
+
+    // repair() 用的标记
+    std::vector<int> borderMark, clusterMark, regionBorderMark, regionMark;
+    int repairStamp;
+
+    // 簇内搜索的临时空间
+    std::vector<int> localDist, localParent;
+
+    // 抽象图搜索的临时空间，终点用 nodes.size() 这个编号
+    std::vector<int> g, parent, searchMark, goalDist;
+    std::vector<Edge> seeds;
+    int searchStamp;
+    int expanded;
+};
+
+#endif
@@ -0,0 +1,207 @@
+/*
+** 叠加层
+**
+** author : gouki04 2011-12-30
+*/
+
+#include "Overlay.h"
+
+#include <string.h>
+
+HGE* Overlay::hge = 0;
+
+namespace
+{
+    void setVertex(hgeVertex& v, float x, float y, DWORD color, float tx = 0, float ty = 0)
+    {
+        v.x = x;
+        v.y = y;
+        v.z = 0.5f;
+        v.col = color;
+        v.tx = tx;
+        v.ty = ty;
+    }
+
+    // [first, last) 与 [lo, hi) 的交集，按 cellSize 等分的行列号
+    void visibleRange(int origin, int count, int cellSize, int lo, int hi, int& first, int& last)
+    {
+        first = lo <= origin ? 0 : (lo - origin) / cellSize;
+        last = hi <= origin ? 0 : (hi - origin + cellSize - 1) / cellSize + 1;
+        if (first > count) first = count;
+        if (last > count) last = count;
+    }
+
+    // 往批次里追加图元，缓冲满了提交再继续，所有追加的内容在同一个批次里
+    class BatchWriter
+    {
+    public:
+        BatchWriter(HGE* engine, int type, HTEXTURE texture, int blendMode)
+            : hge(engine), primType(type), tex(texture), blend(blendMode), buffer(0), count(0), maxPrim(0)
+        {
+        }
+
+        ~BatchWriter() { flush(); }
+
+        void append(const hgeVertex* v, int primCount)
+        {
+            while (primCount > 0)
+            {
+                if (count == maxPrim)
+                {
+                    flush();
+                    buffer = hge->Gfx_StartBatch(primType, tex, blend, &maxPrim);
+                    if (!buffer || maxPrim <= 0)
+                    {
+                        buffer = 0;
+                        maxPrim = 0;
+                        return;
+                    }
+                }
+
+                int n = maxPrim - count < primCount ? maxPrim - count : primCount;
+                memcpy(buffer + count * primType, v, n * primType * sizeof(hgeVertex));
+
+                count += n;
+                v += n * primType;
+                primCount -= n;
+            }
+        }
+
+        void flush()
+        {
+            if (buffer)
+                hge->Gfx_FinishBatch(count);
+            buffer = 0;
+            count = maxPrim = 0;
+        }
+
+    private:
+        HGE* hge;
+        int primType;
+        HTEXTURE tex;
+        int blend;
+
+        hgeVertex* buffer;
+        int count, maxPrim;
+    };
+}
+
+Overlay::Overlay()
+    : gridX(0), gridY(0), gridRows(0), gridCols(0), gridCell(0), gridColor(0), builds(0),
+      spriteTex(0), spriteBlend(BLEND_DEFAULT)
+{
+    hge = hgeCreate(HGE_VERSION);
+}
+
+Overlay::~Overlay()
+{
+    hge->Release();
+}
+
+void Overlay::setGrid(int x, int y, int rows, int cols, int cellSize, DWORD color)
+{
+    if (x == gridX && y == gridY && rows == gridRows && cols == gridCols && cellSize == gridCell
+        && color == gridColor && builds > 0)
+        return;
+
+    gridX = x;
+    gridY = y;
+    gridRows = rows;
+    gridCols = cols;
+    gridCell = cellSize;
+    gridColor = color;
+    ++builds;
+
+    float left = static_cast<float>(x);
+    float top = static_cast<float>(y);
+    float right = static_cast<float>(x + cols * cellSize);
+    float bottom = static_cast<float>(y + rows * cellSize);
+
+    gridLines.resize((rows + cols) * 2);
+    hgeVertex* v = gridLines.empty() ? 0 : &gridLines[0];
+
+    for (int i = 0; i < rows; ++i, v += 2)
+    {
+        float ly = static_cast<float>(y + i * cellSize);
+        setVertex(v[0], left, ly, color);
+        setVertex(v[1], right, ly, color);
+    }
+
+    for (int i = 0; i < cols; ++i, v += 2)
+    {
+        float lx = static_cast<float>(x + i * cellSize);
+        setVertex(v[0], lx, top, color);
+        setVertex(v[1], lx, bottom, color);
+    }
+}
+
+void Overlay::clearShapes()
+{
+    shapeLines.clear();
+    spriteQuads.clear();
+    spriteTex = 0;
+}
+
+void Overlay::addLine(float x1, float y1, float x2, float y2, DWORD color)
+{
+    hgeVertex v[2];
+    setVertex(v[0], x1, y1, color);
+    setVertex(v[1], x2, y2, color);
+    shapeLines.insert(shapeLines.end(), v, v + 2);
+}
+
+void Overlay::addOutline(float x1, float y1, float x2, float y2, DWORD color)
+{
+    addLine(x1, y1, x2, y1, color);
+    addLine(x2, y1, x2, y2, color);
+    addLine(x2, y2, x1, y2, color);
+    addLine(x1, y2, x1, y1, color);
+}
+
+void Overlay::addSprite(const hgeSprite* sprite, float x1, float y1, float x2, float y2)
+{
+    spriteTex = sprite->GetTexture();
+    spriteBlend = sprite->GetBlendMode();
+
+    float tx, ty, tw, th;
+    sprite->GetTextureRect(&tx, &ty, &tw, &th);
+
+    float texW = spriteTex ? static_cast<float>(hge->Texture_GetWidth(spriteTex)) : 1.0f;
+    float texH = spriteTex ? static_cast<float>(hge->Texture_GetHeight(spriteTex)) : 1.0f;
+    float u0 = tx / texW, v0 = ty / texH, u1 = (tx + tw) / texW, v1 = (ty + th) / texH;
+
+    hgeVertex v[4];
+    setVertex(v[0], x1, y1, sprite->GetColor(0), u0, v0);
+    setVertex(v[1], x2, y1, sprite->GetColor(1), u1, v0);
+    setVertex(v[2], x2, y2, sprite->GetColor(2), u1, v1);
+    setVertex(v[3], x1, y2, sprite->GetColor(3), u0, v1);
+    spriteQuads.insert(spriteQuads.end(), v, v + 4);
+}
+
+void Overlay::render(int left, int top, int right, int bottom)
+{
+    {
+        BatchWriter lines(hge, HGEPRIM_LINES, 0, BLEND_DEFAULT);
+
+        if (gridCell > 0)
+        {
+            int first, last;
+            visibleRange(gridY, gridRows, gridCell, top, bottom, first, last);
+            if (first < last)
+                lines.append(&gridLines[first * 2], last - first);
+
+            visibleRange(gridX, gridCols, gridCell, left, right, first, last);
+            if (first < last)
+                lines.append(&gridLines[(gridRows + first) * 2], last - first);
+        }
+
+        if (!shapeLines.empty())
+            lines.append(&shapeLines[0], static_cast<int>(shapeLines.size()) / 2);
+    }
+
+    if (!spriteQuads.empty())
+    {
+        BatchWriter quads(hge, HGEPRIM_QUADS, spriteTex, spriteBlend);
+        quads.append(&spriteQuads[0], static_cast<int>(spriteQuads.size()) / 4);
+    }
+}
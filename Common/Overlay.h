@@ -0,0 +1,63 @@
+/*
+** 叠加层：网格、高亮框、笔刷范围、选区等画在地图上面的东西
+** 网格的顶点只在参数（位置、行列数、格子大小）变化时重建，之后每帧直接拷贝进批次，
+** 并且只拷贝和可见区域相交的那些线，所以开销只和屏幕大小有关，和地图大小无关。
+** 每帧变化的图形（框线、精灵）每帧重新添加：框线和网格线写进同一个 HGEPRIM_LINES 批次，
+** 精灵（同一张纹理）写进另一个 HGEPRIM_QUADS 批次，画多少东西都只有这两个批次（超出顶点缓冲时才会分段）。
+**
+** author : gouki04 2011-12-30
+*/
+
+#ifndef OVERLAY_H
+#define OVERLAY_H
+
+#include "..\hge\hge.h"
+#include "..\hge\hgesprite.h"
+
+#include <vector>
+
+class Overlay
+{
+public:
+    Overlay();
+    ~Overlay();
+
+    // 左上角 (x, y)、rows*cols 格、每格 cellSize 像素的网格，只画每一行和每一列的起始线
+    void setGrid(int x, int y, int rows, int cols, int cellSize, DWORD color);
+
+    // 网格重建的次数
+    int gridBuilds() const { return builds; }
+
+    // 每帧开始时清空，再添加这一帧的图形
+    void clearShapes();
+
+    // 矩形框，右下角的线画在 x2, y2 上
+    void addOutline(float x1, float y1, float x2, float y2, DWORD color);
+
+    // 把精灵拉伸到矩形内，所有精灵必须使用同一张纹理
+    void addSprite(const hgeSprite* sprite, float x1, float y1, float x2, float y2);
+
+    // 只画和 left, top, right, bottom 相交的网格线，必须在 Gfx_BeginScene() 和 Gfx_EndScene() 之间调用
+    void render(int left, int top, int right, int bottom);
+
+private:
+    Overlay(const Overlay&);
+    Overlay& operator=(const Overlay&);
+
+    static HGE* hge;
+
+    void addLine(float x1, float y1, float x2, float y2, DWORD color);
+
+    // 网格参数
+    int gridX, gridY, gridRows, gridCols, gridCell;
+    DWORD gridColor;
+    int builds;
+
+    std::vector<hgeVertex> gridLines;   // 先是 gridRows 条横线，再是 gridCols 条竖线，每条2个顶点
+    std::vector<hgeVertex> shapeLines;
+    std::vector<hgeVertex> spriteQuads;
+    HTEXTURE spriteTex;
+    int spriteBlend;
+};
+
+#endif
@@ -0,0 +1,381 @@
+/*
+** 平台相关的小工具
+** 编辑器只在Windows下运行，命令行工具（TileBench）也可以在其他平台编译
+**
+** author : gouki04 2011-12-30
+*/
+
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <stdio.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#endif
+
+// 高精度计时，单位为秒
+inline double getTicks()
+{
+#ifdef _WIN32
+    static LARGE_INTEGER freq = { 0 };
+    if (freq.QuadPart == 0)
+        QueryPerformanceFrequency(&freq);
+
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return static_cast<double>(now.QuadPart) / static_cast<double>(freq.QuadPart);
+#else
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+// 只读的内存映射文件
+class MappedFile
+{
+public:
+    MappedFile() : ptr(0), length(0)
+    {
+#ifdef _WIN32
+        file = INVALID_HANDLE_VALUE;
+        mapping = 0;
+#else
+        fd = -1;
+#endif
+    }
+
+    ~MappedFile() { close(); }
+
+    bool open(const char* path)
+    {
+        close();
+
+#ifdef _WIN32
+        file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+
+        length = GetFileSize(file, 0);
+        mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+        if (mapping)
+            ptr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+        fd = ::open(path, O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0)
+        {
+            length = static_cast<size_t>(st.st_size);
+            ptr = mmap(0, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (ptr == MAP_FAILED)
+                ptr = 0;
+        }
+#endif
+
+        if (!ptr)
+        {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close()
+    {
+#ifdef _WIN32
+        if (ptr) UnmapViewOfFile(ptr);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        file = INVALID_HANDLE_VALUE;
+        mapping = 0;
+#else
+        if (ptr) munmap(ptr, length);
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+#endif
+        ptr = 0;
+        length = 0;
+    }
+
+    const void* data() const { return ptr; }
+    size_t size() const { return length; }
+
+private:
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+
+    void* ptr;
+    size_t length;
+
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#else
+    int fd;
+#endif
+};
+
+// 用 from 替换 to（to 已存在时覆盖），失败时 to 保持原样
+inline bool replaceFile(const char* from, const char* to)
+{
+#ifdef _WIN32
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return rename(from, to) == 0;
+#endif
+}
+
+// 逻辑处理器个数
+inline int hardwareThreads()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return static_cast<int>(info.dwNumberOfProcessors);
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? static_cast<int>(n) : 1;
+#endif
+}
+
+// 线程局部变量
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+// 原子操作，都带有完整的内存屏障
+inline long atomicLoad(volatile long* p)
+{
+#ifdef _WIN32
+    return InterlockedCompareExchange(p, 0, 0);
+#else
+    return __atomic_load_n(p, __ATOMIC_SEQ_CST);
+#endif
+}
+
+inline void atomicStore(volatile long* p, long value)
+{
+#ifdef _WIN32
+    InterlockedExchange(p, value);
+#else
+    __atomic_store_n(p, value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+// 返回相加之后的值
+inline long atomicAdd(volatile long* p, long value)
+{
+#ifdef _WIN32
+    return InterlockedExchangeAdd(p, value) + value;
+#else
+    return __sync_add_and_fetch(p, value);
+#endif
+}
+
+// *p 等于 comparand 时换成 exchange，返回原来的值
+inline long atomicCompareExchange(volatile long* p, long exchange, long comparand)
+{
+#ifdef _WIN32
+    return InterlockedCompareExchange(p, exchange, comparand);
+#else
+    return __sync_val_compare_and_swap(p, comparand, exchange);
+#endif
+}
+
+// 把 *p 换成 value，返回原来的指针
+inline void* atomicExchangePointer(void* volatile* p, void* value)
+{
+#ifdef _WIN32
+    return InterlockedExchangePointer(p, value);
+#else
+    return __atomic_exchange_n(p, value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+// *p 等于 comparand 时换成 exchange，返回原来的指针
+inline void* atomicCompareExchangePointer(void* volatile* p, void* exchange, void* comparand)
+{
+#ifdef _WIN32
+    return InterlockedCompareExchangePointer(p, exchange, comparand);
+#else
+    return __sync_val_compare_and_swap(p, comparand, exchange);
+#endif
+}
+
+// 互斥锁
+class Mutex
+{
+public:
+#ifdef _WIN32
+    Mutex() { InitializeCriticalSection(&cs); }
+    ~Mutex() { DeleteCriticalSection(&cs); }
+
+    void lock() { EnterCriticalSection(&cs); }
+    void unlock() { LeaveCriticalSection(&cs); }
+#else
+    Mutex() { pthread_mutex_init(&mutex, 0); }
+    ~Mutex() { pthread_mutex_destroy(&mutex); }
+
+    void lock() { pthread_mutex_lock(&mutex); }
+    void unlock() { pthread_mutex_unlock(&mutex); }
+#endif
+
+private:
+    Mutex(const Mutex&);
+    Mutex& operator=(const Mutex&);
+
+#ifdef _WIN32
+    CRITICAL_SECTION cs;
+#else
+    pthread_mutex_t mutex;
+#endif
+};
+
+// 在作用域内持有锁
+class ScopedLock
+{
+public:
+    explicit ScopedLock(Mutex& m) : mutex(m) { mutex.lock(); }
+    ~ScopedLock() { mutex.unlock(); }
+
+private:
+    ScopedLock(const ScopedLock&);
+    ScopedLock& operator=(const ScopedLock&);
+
+    Mutex& mutex;
+};
+
+// 自动复位的事件：signal() 之后唤醒一个等待的线程，没有线程在等时下一次 wait() 直接返回
+class Event
+{
+public:
+#ifdef _WIN32
+    Event() { handle = CreateEvent(0, FALSE, FALSE, 0); }
+    ~Event() { CloseHandle(handle); }
+
+    void signal() { SetEvent(handle); }
+    void wait() { WaitForSingleObject(handle, INFINITE); }
+#else
+    Event() : set(false)
+    {
+        pthread_mutex_init(&mutex, 0);
+        pthread_cond_init(&cond, 0);
+    }
+
+    ~Event()
+    {
+        pthread_cond_destroy(&cond);
+        pthread_mutex_destroy(&mutex);
+    }
+
+    void signal()
+    {
+        pthread_mutex_lock(&mutex);
+        set = true;
+        pthread_cond_signal(&cond);
+        pthread_mutex_unlock(&mutex);
+    }
+
+    void wait()
+    {
+        pthread_mutex_lock(&mutex);
+        while (!set)
+            pthread_cond_wait(&cond, &mutex);
+        set = false;
+        pthread_mutex_unlock(&mutex);
+    }
+#endif
+
+private:
+    Event(const Event&);
+    Event& operator=(const Event&);
+
+#ifdef _WIN32
+    HANDLE handle;
+#else
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    bool set;
+#endif
+};
+
+// 工作线程，析构时等待线程结束
+class Thread
+{
+public:
+    typedef void (*Func)(void* arg);
+
+    Thread() : func(0), arg(0), started(false) {}
+    ~Thread() { join(); }
+
+    bool start(Func f, void* a)
+    {
+        join();
+
+        func = f;
+        arg = a;
+#ifdef _WIN32
+        handle = CreateThread(0, 0, entry, this, 0, 0);
+        started = handle != 0;
+#else
+        started = pthread_create(&handle, 0, entry, this) == 0;
+#endif
+        return started;
+    }
+
+    void join()
+    {
+        if (!started)
+            return;
+
+#ifdef _WIN32
+        WaitForSingleObject(handle, INFINITE);
+        CloseHandle(handle);
+#else
+        pthread_join(handle, 0);
+#endif
+        started = false;
+    }
+
+private:
+    Thread(const Thread&);
+    Thread& operator=(const Thread&);
+
+#ifdef _WIN32
+    static DWORD WINAPI entry(LPVOID p)
+    {
+        Thread* self = static_cast<Thread*>(p);
+        self->func(self->arg);
+        return 0;
+    }
+
+    HANDLE handle;
+#else
+    static void* entry(void* p)
+    {
+        Thread* self = static_cast<Thread*>(p);
+        self->func(self->arg);
+        return 0;
+    }
+
+    pthread_t handle;
+#endif
+
+    Func func;
+    void* arg;
+    bool started;
+};
+
+#endif
@@ -0,0 +1,74 @@
+/*
+** 性能面板
+**
+** author : gouki04 2011-12-30
+*/
+
+#include "ProfilerHud.h"
+
+HGE* ProfilerHud::hge = 0;
+
+ProfilerHud::ProfilerHud(FrameProfiler& p, const char* file) : profiler(p), fontFile(file), font(0)
+{
+    hge = hgeCreate(HGE_VERSION);
+}
+
+ProfilerHud::~ProfilerHud()
+{
+    hge->Release();
+}
+
+void ProfilerHud::release()
+{
+    delete font;
+    font = 0;
+}
+
+void ProfilerHud::toggle()
+{
+    if (!font)
+    {
+        font = new hgeFont(fontFile.c_str());
+        font->SetColor(0xFF000000);
+    }
+
+    profiler.setEnabled(!profiler.enabled());
+}
+
+void ProfilerHud::render(float x, float y)
+{
+    if (!visible() || !font)
+        return;
+
+    float lineHeight = font->GetHeight();
+    float width = 360.f;
+    float height = lineHeight * (profiler.phaseCount() + 1);
+
+    // 半透明底色，保证文字在地图上能看清
+    hgeQuad quad;
+    quad.tex = 0;
+    quad.blend = BLEND_DEFAULT;
+    quad.v[0].x = x;         quad.v[0].y = y;
+    quad.v[1].x = x + width; quad.v[1].y = y;
+    quad.v[2].x = x + width; quad.v[2].y = y + height;
+    quad.v[3].x = x;         quad.v[3].y = y + height;
+    for (int i = 0; i < 4; ++i)
+    {
+        quad.v[i].z = 0.5f;
+        quad.v[i].col = 0xC0FFFFFF;
+        quad.v[i].tx = quad.v[i].ty = 0;
+    }
+    hge->Gfx_RenderQuad(&quad);
+
+    font->printf(x + 4, y, HGETEXT_LEFT, "FPS %d   frames %d   (ms: min / avg / p99)",
+        hge->Timer_GetFPS(), profiler.frameCount());
+    y += lineHeight;
+
+    for (int i = 0; i < profiler.phaseCount(); ++i)
+    {
+        PhaseStats stats = profiler.stats(i);
+        font->printf(x + 4, y, HGETEXT_LEFT, "%-10s %6.3f %6.3f %6.3f",
+            profiler.phaseName(i), stats.min, stats.avg, stats.p99);
+        y += lineHeight;
+    }
+}
@@ -0,0 +1,45 @@
+/*
+** 性能面板
+** 用 hgeFont 在屏幕上显示 FrameProfiler 各阶段的最小、平均、99分位耗时和帧率。
+** 面板隐藏时同时关闭计时，字体在第一次显示时才读入。
+**
+** author : gouki04 2011-12-30
+*/
+
+#ifndef PROFILERHUD_H
+#define PROFILERHUD_H
+
+#include "..\hge\hge.h"
+#include "..\hge\hgefont.h"
+
+#include <string>
+
+#include "FrameProfiler.h"
+
+class ProfilerHud
+{
+public:
+    ProfilerHud(FrameProfiler& profiler, const char* fontFile);
+    ~ProfilerHud();
+
+    // 释放字体，必须在 System_Shutdown() 之前调用（全局对象析构时 HGE 的纹理已经释放了）
+    void release();
+
+    void toggle();
+    bool visible() const { return profiler.enabled(); }
+
+    // 在(x, y)处绘制面板，必须在 Gfx_BeginScene() 和 Gfx_EndScene() 之间调用
+    void render(float x, float y);
+
+private:
+    ProfilerHud(const ProfilerHud&);
+    ProfilerHud& operator=(const ProfilerHud&);
+
+    static HGE* hge;
+
+    FrameProfiler& profiler;
+    std::string fontFile;
+    hgeFont* font;
+};
+
+#endif
@@ -0,0 +1,78 @@
+/*
+** 批量提交四边形
+** 对 Gfx_StartBatch / Gfx_FinishBatch 的简单封装，顶点缓冲满了自动提交再继续
+**
+** author : gouki04 2011-12-30
+*/
+
+#ifndef QUADBATCH_H
+#define QUADBATCH_H
+
+#include "..\hge\hge.h"
+
+class QuadBatch
+{
+public:
+    QuadBatch(HGE* engine, HTEXTURE texture, int blendMode = BLEND_DEFAULT, DWORD color = 0xFFFFFFFF)
+        : hge(engine), tex(texture), blend(blendMode), col(color), vertices(0), prim(0), maxPrim(0), total(0)
+    {
+    }
+
+    ~QuadBatch() { finish(); }
+
+    // 添加一个轴对齐的四边形
+    void add(float x1, float y1, float x2, float y2, float u0, float v0, float u1, float v1)
+    {
+        if (prim == maxPrim && !begin())
+            return;
+
+        hgeVertex* q = vertices + prim * 4;
+        q[0].x = x1; q[0].y = y1; q[0].tx = u0; q[0].ty = v0;
+        q[1].x = x2; q[1].y = y1; q[1].tx = u1; q[1].ty = v0;
+        q[2].x = x2; q[2].y = y2; q[2].tx = u1; q[2].ty = v1;
+        q[3].x = x1; q[3].y = y2; q[3].tx = u0; q[3].ty = v1;
+        for (int k = 0; k < 4; ++k)
+        {
+            q[k].z = 0.5f;
+            q[k].col = col;
+        }
+
+        ++prim;
+        ++total;
+    }
+
+    void finish()
+    {
+        if (vertices)
+        {
+            hge->Gfx_FinishBatch(prim);
+            vertices = 0;
+        }
+        prim = maxPrim = 0;
+    }
+
+    // 已提交的四边形个数
+    int count() const { return total; }
+
+private:
+    QuadBatch(const QuadBatch&);
+    QuadBatch& operator=(const QuadBatch&);
+
+    bool begin()
+    {
+        finish();
+        vertices = hge->Gfx_StartBatch(HGEPRIM_QUADS, tex, blend, &maxPrim);
+        return vertices != 0 && maxPrim > 0;
+    }
+
+    HGE* hge;
+    HTEXTURE tex;
+    int blend;
+    DWORD col;
+
+    hgeVertex* vertices;
+    int prim, maxPrim;
+    int total;
+};
+
+#endif
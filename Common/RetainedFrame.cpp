@@ -0,0 +1,163 @@
+/*
+** 保留模式的画面
+**
+** author : gouki04 2011-12-30
+*/
+
+#include "RetainedFrame.h"
+
+HGE* RetainedFrame::hge = 0;
+
+namespace
+{
+    // 重叠或相邻
+    bool touches(const DirtyRect& a, const DirtyRect& b)
+    {
+        return a.x1 <= b.x2 && b.x1 <= a.x2 && a.y1 <= b.y2 && b.y1 <= a.y2;
+    }
+
+    void unite(DirtyRect& a, const DirtyRect& b)
+    {
+        if (b.x1 < a.x1) a.x1 = b.x1;
+        if (b.y1 < a.y1) a.y1 = b.y1;
+        if (b.x2 > a.x2) a.x2 = b.x2;
+        if (b.y2 > a.y2) a.y2 = b.y2;
+    }
+}
+
+void DirtyRegion::add(int x1, int y1, int x2, int y2)
+{
+    if (x1 >= x2 || y1 >= y2)
+        return;
+
+    DirtyRect rect = { x1, y1, x2, y2 };
+
+    // 合并之后可能又和别的矩形相交，一直合并到没有为止
+    for (size_t i = 0; i < list.size();)
+    {
+        if (touches(list[i], rect))
+        {
+            unite(rect, list[i]);
+            list[i] = list.back();
+            list.pop_back();
+            i = 0;
+        }
+        else
+        {
+            ++i;
+        }
+    }
+
+    list.push_back(rect);
+
+    if (list.size() > DIRTY_MAX_RECTS)
+    {
+        for (size_t i = 1; i < list.size(); ++i)
+            unite(list[0], list[i]);
+        list.resize(1);
+    }
+}
+
+void DirtyRegion::add(const DirtyRegion& other)
+{
+    for (size_t i = 0; i < other.list.size(); ++i)
+    {
+        const DirtyRect& r = other.list[i];
+        add(r.x1, r.y1, r.x2, r.y2);
+    }
+}
+
+RetainedFrame::RetainedFrame(int w, int h) : width(w), height(h), target(0), full(true)
+{
+    hge = hgeCreate(HGE_VERSION);
+}
+
+RetainedFrame::~RetainedFrame()
+{
+    hge->Release();
+}
+
+void RetainedFrame::release()
+{
+    if (target)
+    {
+        hge->Target_Free(target);
+        target = 0;
+    }
+    full = true;
+}
+
+int RetainedFrame::update(PaintFunc paint)
+{
+    if (!target)
+    {
+        target = hge->Target_Create(width, height, false);
+        if (!target)
+            return 0;
+        full = true;
+    }
+
+    if (full)
+    {
+        dirty.clear();
+        dirty.add(0, 0, width, height);
+        full = false;
+    }
+
+    if (dirty.empty())
+        return 0;
+
+    int pixels = 0;
+
+    hge->Gfx_BeginScene(target);
+    for (int i = 0; i < dirty.count(); ++i)
+    {
+        DirtyRect rect = dirty.rect(i);
+        if (rect.x1 < 0) rect.x1 = 0;
+        if (rect.y1 < 0) rect.y1 = 0;
+        if (rect.x2 > width) rect.x2 = width;
+        if (rect.y2 > height) rect.y2 = height;
+        if (rect.x1 >= rect.x2 || rect.y1 >= rect.y2)
+            continue;
+
+        // 裁剪区域同时限制 Gfx_Clear 的范围
+        hge->Gfx_SetClipping(rect.x1, rect.y1, rect.x2 - rect.x1, rect.y2 - rect.y1);
+        hge->Gfx_Clear(0xFFFFFFFF);
+        paint(rect);
+
+        pixels += (rect.x2 - rect.x1) * (rect.y2 - rect.y1);
+    }
+    hge->Gfx_SetClipping();
+    hge->Gfx_EndScene();
+
+    dirty.clear();
+    return pixels;
+}
+
+void RetainedFrame::render()
+{
+    if (!target)
+        return;
+
+    hgeQuad quad;
+    quad.tex = hge->Target_GetTexture(target);
+    quad.blend = BLEND_DEFAULT;
+
+    // 渲染目标的纹理可能被放大到2的幂
+    float u = static_cast<float>(width) / static_cast<float>(hge->Texture_GetWidth(quad.tex));
+    float v = static_cast<float>(height) / static_cast<float>(hge->Texture_GetHeight(quad.tex));
+    float w = static_cast<float>(width), h = static_cast<float>(height);
+
+    quad.v[0].x = 0; quad.v[0].y = 0; quad.v[0].tx = 0; quad.v[0].ty = 0;
+    quad.v[1].x = w; quad.v[1].y = 0; quad.v[1].tx = u; quad.v[1].ty = 0;
+    quad.v[2].x = w; quad.v[2].y = h; quad.v[2].tx = u; quad.v[2].ty = v;
+    quad.v[3].x = 0; quad.v[3].y = h; quad.v[3].tx = 0; quad.v[3].ty = v;
+
+    for (int i = 0; i < 4; ++i)
+    {
+        quad.v[i].z = 0.5f;
+        quad.v[i].col = 0xFFFFFFFF;
+    }
+
+    hge->Gfx_RenderQuad(&quad);
+}
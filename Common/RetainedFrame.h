@@ -0,0 +1,82 @@
+/*
+** 保留模式的画面
+** 上一帧的画面保存在一个渲染目标里，每帧只重画变化了的矩形区域（脏矩形），
+** 重画时用 Gfx_SetClipping 把绘制和 Gfx_Clear 限制在区域内，再把整个渲染目标作为一个四边形画到屏幕上。
+** 什么都没变的帧只画这一个四边形。
+**
+** 脏矩形由使用者报告：地图内容变化的块、高亮框移动前后的位置等；
+** 设备丢失或整个画面都变了（例如换了地图）时调用 invalidate()。
+** 性能面板、加载进度等每帧都变的东西不要画进来，直接画在屏幕上。
+**
+** author : gouki04 2011-12-30
+*/
+
+#ifndef RETAINEDFRAME_H
+#define RETAINEDFRAME_H
+
+#include "..\hge\hge.h"
+
+#include <vector>
+
+#define DIRTY_MAX_RECTS 8   // 脏矩形超过这个数时合并成一个外接矩形
+
+struct DirtyRect
+{
+    int x1, y1, x2, y2;     // 左上角包含，右下角不包含
+};
+
+// 一帧内的脏矩形，重叠或相邻的矩形会被合并
+class DirtyRegion
+{
+public:
+    DirtyRegion() {}
+
+    void add(int x1, int y1, int x2, int y2);
+    void add(const DirtyRegion& other);
+    void clear() { list.clear(); }
+
+    bool empty() const { return list.empty(); }
+    int count() const { return static_cast<int>(list.size()); }
+    const DirtyRect& rect(int i) const { return list[i]; }
+
+private:
+    std::vector<DirtyRect> list;
+};
+
+class RetainedFrame
+{
+public:
+    typedef void (*PaintFunc)(const DirtyRect& rect);
+
+    RetainedFrame(int width, int height);
+    ~RetainedFrame();
+
+    // 下一帧整个重画
+    void invalidate() { full = true; }
+
+    void addDirty(int x1, int y1, int x2, int y2) { dirty.add(x1, y1, x2, y2); }
+    void addDirty(const DirtyRegion& region) { dirty.add(region); }
+
+    // 对每个脏矩形设置裁剪、清屏后调用 paint，必须在 Gfx_BeginScene() 之外调用
+    // 返回重画的像素数，没有脏矩形时返回 0
+    int update(PaintFunc paint);
+
+    // 把保存的画面画到当前场景里，必须在 Gfx_BeginScene() 和 Gfx_EndScene() 之间调用
+    void render();
+
+    // 渲染目标要在 System_Shutdown() 之前释放
+    void release();
+
+private:
+    RetainedFrame(const RetainedFrame&);
+    RetainedFrame& operator=(const RetainedFrame&);
+
+    static HGE* hge;
+
+    int width, height;
+    HTARGET target;
+    bool full;
+    DirtyRegion dirty;
+};
+
+#endif
@@ -0,0 +1,60 @@
+/*
+** 单生产者单消费者的无锁队列
+** 固定容量的环形缓冲，只允许一个线程 push()、另一个线程 pop()。
+** 读写位置只增不减，各自只由一方写入：生产者写完元素再公开 tail，消费者读完元素再公开 head，
+** 所以不需要锁，也不需要比较交换。
+**
+** author : gouki04 2011-12-30
+*/
+
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include "Platform.h"
+
+// CAPACITY 必须是 2 的幂
+template <typename T, int CAPACITY>
+class SpscQueue
+{
+public:
+    enum { MASK = CAPACITY - 1 };
+
+    SpscQueue() : head(0), tail(0) {}
+
+    // 生产者调用，队列满时返回 false
+    bool push(const T& value)
+    {
+        long t = tail;
+        if (t - atomicLoad(&head) >= CAPACITY)
+            return false;
+
+        items[t & MASK] = value;
+        atomicStore(&tail, t + 1);
+        return true;
+    }
+
+    // 消费者调用，队列空时返回 false
+    bool pop(T& value)
+    {
+        long h = head;
+        if (h == atomicLoad(&tail))
+            return false;
+
+        value = items[h & MASK];
+        atomicStore(&head, h + 1);
+        return true;
+    }
+
+private:
+    SpscQueue(const SpscQueue&);
+    SpscQueue& operator=(const SpscQueue&);
+
+    T items[CAPACITY];
+
+    // 分开放在不同的缓存行，避免两个线程互相使对方的缓存失效
+    volatile long head;
+    char padding[64 - sizeof(long)];
+    volatile long tail;
+};
+
+#endif
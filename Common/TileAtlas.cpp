@@ -0,0 +1,465 @@
+/*
+** 地图元件图集
+**
+** author : gouki04 2011-12-30
+*/
+
+#include "TileAtlas.h"
+#include "TileSet.h"
+#include "Platform.h"
+#include "TraceRecorder.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define ATLAS_CACHE_VERSION 1
+
+// 缓存文件格式：
+// 文件头，pageCount 个页面大小(宽,高)，tileCount 个 AtlasRect，然后依次是每页的像素
+struct AtlasCacheHeader
+{
+    char magic[4];
+    int version;
+    ContentHash sourceHash;
+    int pageCount;
+    int tileCount;
+};
+
+HGE* TileAtlas::hge = 0;
+
+TileAtlas::TileAtlas(int maxPageSize, int padding) : packer(maxPageSize, padding), cachePixels(0)
+{
+    hge = hgeCreate(HGE_VERSION);
+}
+
+TileAtlas::~TileAtlas()
+{
+    release();
+    hge->Release();
+}
+
+int TileAtlas::addSheet(const char* file, int tileW, int tileH, int n, int columns)
+{
+    Source source;
+    source.file = file;
+    source.tileW = tileW;
+    source.tileH = tileH;
+    source.count = n;
+    source.columns = columns;
+    source.first = count();
+    sources.push_back(source);
+
+    // 元件的位置要等读入图片后才知道，先占住编号
+    Tile tile = { static_cast<int>(sources.size()) - 1, 0, 0, tileW, tileH };
+    tiles.insert(tiles.end(), n, tile);
+
+    return source.first;
+}
+
+int TileAtlas::addImage(const char* file)
+{
+    return addSheet(file, 0, 0, 1);
+}
+
+void TileAtlas::release()
+{
+    for (size_t i = 0; i < pageTextures.size(); ++i)
+        hge->Texture_Free(pageTextures[i]);
+    pageTextures.clear();
+
+    cache.close();
+    cachePixels = 0;
+
+    freeSources();
+}
+
+void TileAtlas::freeSources()
+{
+    for (size_t s = 0; s < sourceData.size(); ++s)
+    {
+        if (sourceData[s])
+            hge->Resource_Free(sourceData[s]);
+    }
+    sourceData.clear();
+    sourceSizes.clear();
+}
+
+bool TileAtlas::prepare(const char* cachePath)
+{
+    TRACE_SCOPE("atlas prepare");
+
+    freeSources();
+    cache.close();
+    cachePixels = 0;
+
+    sourceData.resize(sources.size(), 0);
+    sourceSizes.resize(sources.size(), 0);
+
+    for (size_t s = 0; s < sources.size(); ++s)
+    {
+        sourceData[s] = hge->Resource_Load(sources[s].file.c_str(), &sourceSizes[s]);
+        if (!sourceData[s])
+        {
+            freeSources();
+            return false;
+        }
+    }
+
+    if (cachePath && openCache(cachePath))
+    {
+        // 命中缓存就不再需要源图片了
+        freeSources();
+        return true;
+    }
+
+    return false;
+}
+
+bool TileAtlas::build()
+{
+    TRACE_SCOPE("atlas build");
+
+    for (size_t i = 0; i < pageTextures.size(); ++i)
+        hge->Texture_Free(pageTextures[i]);
+    pageTextures.clear();
+
+    cache.close();
+    cachePixels = 0;
+    packer.clear();
+
+    bool preloaded = sourceData.size() == sources.size();
+
+    std::vector<HTEXTURE> textures(sources.size(), 0);
+    bool ok = true;
+
+    // 读入源图片，计算每个元件在源图片中的位置
+    for (size_t s = 0; s < sources.size() && ok; ++s)
+    {
+        Source& source = sources[s];
+
+        if (preloaded)
+            textures[s] = hge->Texture_Load(static_cast<const char*>(sourceData[s]), sourceSizes[s]);
+        else
+            textures[s] = hge->Texture_Load(source.file.c_str());
+        if (!textures[s])
+        {
+            ok = false;
+            break;
+        }
+
+        int width = hge->Texture_GetWidth(textures[s], true);
+        int height = hge->Texture_GetHeight(textures[s], true);
+
+        int tileW = source.tileW > 0 ? source.tileW : width;
+        int tileH = source.tileH > 0 ? source.tileH : height;
+        int columns = source.columns > 0 ? source.columns : width / tileW;
+        if (columns <= 0)
+            columns = 1;
+
+        for (int i = 0; i < source.count; ++i)
+        {
+            Tile& tile = tiles[source.first + i];
+            tile.x = (i % columns) * tileW;
+            tile.y = (i / columns) * tileH;
+            tile.w = tileW;
+            tile.h = tileH;
+
+            if (tile.x + tileW > width || tile.y + tileH > height)
+                ok = false;
+        }
+    }
+
+    if (ok)
+    {
+        for (size_t i = 0; i < tiles.size(); ++i)
+            packer.add(tiles[i].w, tiles[i].h);
+
+        ok = packer.pack();
+    }
+
+    // 创建纹理页并拷贝像素
+    for (int p = 0; ok && p < packer.pageCount(); ++p)
+    {
+        HTEXTURE page = hge->Texture_Create(packer.pageWidth(p), packer.pageHeight(p));
+        if (!page)
+        {
+            ok = false;
+            break;
+        }
+        pageTextures.push_back(page);
+
+        DWORD* dst = hge->Texture_Lock(page, false);
+        if (!dst)
+        {
+            ok = false;
+            break;
+        }
+
+        int dstPitch = hge->Texture_GetWidth(page);
+        memset(dst, 0, dstPitch * hge->Texture_GetHeight(page) * sizeof(DWORD));
+
+        for (size_t s = 0; s < sources.size(); ++s)
+        {
+            const DWORD* src = hge->Texture_Lock(textures[s], true);
+            if (!src)
+            {
+                ok = false;
+                break;
+            }
+
+            int srcPitch = hge->Texture_GetWidth(textures[s]);
+
+            for (int i = 0; i < sources[s].count; ++i)
+            {
+                int id = sources[s].first + i;
+                if (packer.rect(id).page != p)
+                    continue;
+
+                const Tile& tile = tiles[id];
+                packer.blit(id, reinterpret_cast<const AtlasPixel*>(src + tile.y * srcPitch + tile.x), srcPitch,
+                    reinterpret_cast<AtlasPixel*>(dst), dstPitch);
+            }
+
+            hge->Texture_Unlock(textures[s]);
+        }
+
+        hge->Texture_Unlock(page);
+    }
+
+    for (size_t s = 0; s < textures.size(); ++s)
+    {
+        if (textures[s])
+            hge->Texture_Free(textures[s]);
+    }
+
+    freeSources();
+
+    if (!ok)
+        release();
+
+    return ok;
+}
+
+bool TileAtlas::fillTileSet(TileSet& set, int first, int n) const
+{
+    if (first < 0 || first + n > count() || pageTextures.empty())
+        return false;
+
+    int page = packer.rect(first).page;
+    HTEXTURE tex = pageTextures[page];
+    set.setTexture(tex, hge->Texture_GetWidth(tex), hge->Texture_GetHeight(tex));
+
+    for (int i = first; i < first + n; ++i)
+    {
+        const AtlasRect& rect = packer.rect(i);
+        if (rect.page != page)
+            return false;
+
+        set.addTile(static_cast<float>(rect.x), static_cast<float>(rect.y),
+            static_cast<float>(rect.w), static_cast<float>(rect.h));
+    }
+
+    set.classifyTiles();
+    return true;
+}
+
+hgeSprite* TileAtlas::createSprite(int id) const
+{
+    const AtlasRect& rect = packer.rect(id);
+    return new hgeSprite(pageTextures[rect.page], static_cast<float>(rect.x), static_cast<float>(rect.y),
+        static_cast<float>(rect.w), static_cast<float>(rect.h));
+}
+
+ContentHash TileAtlas::sourceHash() const
+{
+    ContentHash h = CONTENT_HASH_SEED;
+
+    int pad = packer.padding();
+    h = hashBytes(&pad, sizeof(pad), h);
+
+    for (size_t s = 0; s < sources.size(); ++s)
+    {
+        const Source& source = sources[s];
+
+        int params[4] = { source.tileW, source.tileH, source.count, source.columns };
+        h = hashBytes(params, sizeof(params), h);
+
+        // prepare() 读入过的文件不用再读一次
+        if (s < sourceData.size())
+        {
+            h = hashBytes(sourceData[s], sourceSizes[s], h);
+            continue;
+        }
+
+        DWORD size = 0;
+        void* data = hge->Resource_Load(source.file.c_str(), &size);
+        if (data)
+        {
+            h = hashBytes(data, size, h);
+            hge->Resource_Free(data);
+        }
+    }
+
+    return h;
+}
+
+bool TileAtlas::saveCache(const char* path) const
+{
+    if (pageTextures.empty())
+        return false;
+
+    FILE* file = fopen(path, "wb");
+    if (!file)
+        return false;
+
+    AtlasCacheHeader header;
+    memcpy(header.magic, "TATL", 4);
+    header.version = ATLAS_CACHE_VERSION;
+    header.sourceHash = sourceHash();
+    header.pageCount = packer.pageCount();
+    header.tileCount = packer.count();
+    fwrite(&header, sizeof(header), 1, file);
+
+    for (int p = 0; p < packer.pageCount(); ++p)
+    {
+        int size[2] = { packer.pageWidth(p), packer.pageHeight(p) };
+        fwrite(size, sizeof(size), 1, file);
+    }
+
+    for (int i = 0; i < packer.count(); ++i)
+        fwrite(&packer.rect(i), sizeof(AtlasRect), 1, file);
+
+    bool ok = true;
+    for (int p = 0; p < packer.pageCount() && ok; ++p)
+    {
+        HTEXTURE tex = pageTextures[p];
+        const DWORD* pixels = hge->Texture_Lock(tex, true);
+        if (!pixels)
+        {
+            ok = false;
+            break;
+        }
+
+        int pitch = hge->Texture_GetWidth(tex);
+        for (int y = 0; y < packer.pageHeight(p); ++y)
+            fwrite(pixels + y * pitch, sizeof(DWORD), packer.pageWidth(p), file);
+
+        hge->Texture_Unlock(tex);
+    }
+
+    fclose(file);
+
+    if (!ok)
+        remove(path);
+
+    return ok;
+}
+
+bool TileAtlas::loadCache(const char* path)
+{
+    release();
+
+    if (!openCache(path))
+        return false;
+
+    while (pagesPending())
+    {
+        if (!uploadPage())
+            return false;
+    }
+
+    return true;
+}
+
+bool TileAtlas::openCache(const char* path)
+{
+    if (!cache.open(path) || cache.size() < sizeof(AtlasCacheHeader))
+    {
+        cache.close();
+        return false;
+    }
+
+    const char* data = static_cast<const char*>(cache.data());
+    const char* end = data + cache.size();
+
+    const AtlasCacheHeader* header = reinterpret_cast<const AtlasCacheHeader*>(data);
+    bool ok = memcmp(header->magic, "TATL", 4) == 0 && header->version == ATLAS_CACHE_VERSION
+        && header->tileCount == count() && header->pageCount > 0
+        && static_cast<size_t>(end - data) >= sizeof(AtlasCacheHeader)
+            + header->pageCount * 2 * sizeof(int) + header->tileCount * sizeof(AtlasRect);
+
+    const int* pageSizes = reinterpret_cast<const int*>(header + 1);
+    const AtlasRect* rects = reinterpret_cast<const AtlasRect*>(pageSizes + header->pageCount * 2);
+    const char* pixels = reinterpret_cast<const char*>(rects + header->tileCount);
+
+    if (ok)
+    {
+        size_t pixelBytes = 0;
+        for (int p = 0; p < header->pageCount; ++p)
+            pixelBytes += static_cast<size_t>(pageSizes[p * 2]) * pageSizes[p * 2 + 1] * sizeof(AtlasPixel);
+
+        ok = pixelBytes == static_cast<size_t>(end - pixels) && header->sourceHash == sourceHash();
+    }
+
+    if (!ok)
+    {
+        cache.close();
+        return false;
+    }
+
+    packer.restore(rects, header->tileCount, pageSizes, header->pageCount);
+    cachePixels = pixels;
+
+    return true;
+}
+
+bool TileAtlas::uploadPage()
+{
+    if (!cachePixels)
+        return false;
+
+    int p = pageCount();
+    int width = packer.pageWidth(p), height = packer.pageHeight(p);
+
+    TRACE_SCOPE_AT("atlas upload page", p, 0);
+
+    HTEXTURE tex = createPage(width, height, reinterpret_cast<const AtlasPixel*>(cachePixels));
+    if (!tex)
+    {
+        release();
+        return false;
+    }
+    pageTextures.push_back(tex);
+
+    cachePixels += static_cast<size_t>(width) * height * sizeof(AtlasPixel);
+
+    // 全部上传后就可以解除映射了
+    if (pageCount() == packer.pageCount())
+    {
+        cache.close();
+        cachePixels = 0;
+    }
+
+    return true;
+}
+
+HTEXTURE TileAtlas::createPage(int width, int height, const AtlasPixel* pixels)
+{
+    HTEXTURE tex = hge->Texture_Create(width, height);
+    if (!tex)
+        return 0;
+
+    DWORD* dst = hge->Texture_Lock(tex, false);
+    if (!dst)
+    {
+        hge->Texture_Free(tex);
+        return 0;
+    }
+
+    int pitch = hge->Texture_GetWidth(tex);
+    for (int y = 0; y < height; ++y)
+        memcpy(dst + y * pitch, pixels + y * width, width * sizeof(DWORD));
+
+    hge->Texture_Unlock(tex);
+    return tex;
+}
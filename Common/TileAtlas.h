@@ -0,0 +1,130 @@
+/*
+** 地图元件图集
+** 把多张元件集图片（以及高亮框等小图）在加载时合并成尽量少的纹理页，
+** 并给每个元件一个全局编号和它在图集中的UV，
+** 这样整张地图和高亮框都来自同一张纹理，可以在一个批次里画完。
+**
+** 打包结果（解码后的像素和UV表）可以存成缓存文件，下次启动时直接映射到内存上传，
+** 不必再解码PNG；缓存里记录了源图片内容的哈希，源图片改变后缓存自动失效。
+**
+** 异步加载时先在工作线程中调用 prepare()，读入源图片和缓存文件，
+** 再回到主线程调用 uploadPage() 逐页上传（命中缓存时）或 build()。
+**
+** author : gouki04 2011-12-30
+*/
+
+#ifndef TILEATLAS_H
+#define TILEATLAS_H
+
+#include "..\hge\hge.h"
+#include "..\hge\hgesprite.h"
+
+#include <string>
+#include <vector>
+
+#include "AtlasPacker.h"
+#include "ContentHash.h"
+#include "Platform.h"
+
+class TileSet;
+
+class TileAtlas
+{
+public:
+    TileAtlas(int maxPageSize = 2048, int padding = 2);
+    ~TileAtlas();
+
+    // 添加一张按网格排列的元件集图片，返回其中第一个元件的编号
+    // columns 为0时按图片宽度计算
+    int addSheet(const char* file, int tileW, int tileH, int count, int columns = 0);
+
+    // 把整张图片作为一个元件加入，返回元件编号
+    int addImage(const char* file);
+
+    // 读入所有图片并打包，创建纹理页
+    // 已经 prepare() 过时直接从内存中的文件数据解码
+    bool build();
+
+    // 读入所有源图片文件，cachePath 不为空时再检查缓存文件，
+    // 缓存有效时返回 true，之后用 uploadPage() 上传；否则之后调用 build()
+    // 不调用图形接口，可以在工作线程中执行
+    bool prepare(const char* cachePath = 0);
+
+    // 上传缓存中的下一页，还有剩余页面时 pagesPending() 为 true
+    bool uploadPage();
+    bool pagesPending() const { return cachePixels != 0; }
+
+    // 从缓存文件读入，源图片与缓存不符时返回 false
+    bool loadCache(const char* path);
+
+    // 把 build() 的结果写入缓存文件
+    bool saveCache(const char* path) const;
+
+    // 所有源图片内容和切分方式的哈希
+    ContentHash sourceHash() const;
+
+    // 释放纹理页
+    void release();
+
+    int count() const { return static_cast<int>(tiles.size()); }
+    int pageCount() const { return static_cast<int>(pageTextures.size()); }
+
+    HTEXTURE pageTexture(int page) const { return pageTextures[page]; }
+    HTEXTURE texture(int id) const { return pageTextures[packer.rect(id).page]; }
+
+    // 元件在纹理页上的像素矩形
+    const AtlasRect& rect(int id) const { return packer.rect(id); }
+
+    // 用 [first, first + n) 范围内的元件填充元件集，这些元件必须在同一页上
+    bool fillTileSet(TileSet& set, int first, int n) const;
+
+    // 用图集中的一个元件创建精灵，由调用者释放
+    hgeSprite* createSprite(int id) const;
+
+private:
+    TileAtlas(const TileAtlas&);
+    TileAtlas& operator=(const TileAtlas&);
+
+    // 一张源图片
+    struct Source
+    {
+        std::string file;
+        int tileW, tileH;   // 为0时表示整张图片
+        int count;
+        int columns;
+        int first;          // 第一个元件的编号
+    };
+
+    // 一个元件在源图片中的位置
+    struct Tile
+    {
+        int source;
+        int x, y, w, h;
+    };
+
+    // 检查映射好的缓存文件，有效时恢复打包结果
+    bool openCache(const char* path);
+
+    // 释放 prepare() 读入的文件数据
+    void freeSources();
+
+    // 创建纹理页并上传像素，pixels 按 width 紧密排列
+    HTEXTURE createPage(int width, int height, const AtlasPixel* pixels);
+
+    static HGE* hge;
+
+    AtlasPacker packer;
+    std::vector<Source> sources;
+    std::vector<Tile> tiles;
+    std::vector<HTEXTURE> pageTextures;
+
+    // prepare() 读入的源图片文件
+    std::vector<void*> sourceData;
+    std::vector<DWORD> sourceSizes;
+
+    // 映射中的缓存文件和下一页像素的位置
+    MappedFile cache;
+    const char* cachePixels;
+};
+
+#endif
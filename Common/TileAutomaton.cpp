@@ -0,0 +1,251 @@
+/*
+** 地形元胞自动机
+**
+** author : gouki04 2011-12-30
+*/
+
+#include "TileAutomaton.h"
+
+#include <string.h>
+#include <algorithm>
+
+namespace
+{
+    // 一个字里为1的位数
+    inline int bitCount(unsigned int x)
+    {
+        x = x - ((x >> 1) & 0x55555555u);
+        x = (x & 0x33333333u) + ((x >> 2) & 0x33333333u);
+        x = (x + (x >> 4)) & 0x0F0F0F0Fu;
+        return static_cast<int>((x * 0x01010101u) >> 24);
+    }
+
+    // 每一位独立的全加器
+    inline void fullAdd(unsigned int a, unsigned int b, unsigned int c, unsigned int& sum, unsigned int& carry)
+    {
+        unsigned int t = a ^ b;
+        sum = t ^ c;
+        carry = (a & b) | (t & c);
+    }
+
+    // 第 w 个字的每个顶点左边（西）和右边（东）的邻居，网格外是0
+    inline unsigned int westOf(const unsigned int* row, int w)
+    {
+        return (row[w] << 1) | (w > 0 ? row[w - 1] >> 31 : 0);
+    }
+
+    inline unsigned int eastOf(const unsigned int* row, int w, int words)
+    {
+        return (row[w] >> 1) | (w + 1 < words ? row[w + 1] << 31 : 0);
+    }
+}
+
+AutomatonRule automatonRule(int index)
+{
+    switch (index)
+    {
+    case AUTOMATON_ERODE: return AutomatonRule::erode();
+    case AUTOMATON_GROW: return AutomatonRule::grow();
+    default: return AutomatonRule::smooth();
+    }
+}
+
+TerrainAutomaton::TerrainAutomaton(JobScheduler* j)
+    : jobs(j), current(0), chunkBits(0), chunkRows(0), chunkCols(0),
+      dirtyRow1(0), dirtyCol1(0), dirtyRow2(-1), dirtyCol2(-1)
+{
+    memset(&stat, 0, sizeof(stat));
+}
+
+void TerrainAutomaton::reset(int rows, int cols, int bits)
+{
+    current = 0;
+    grids[0].resize(rows, cols);
+    grids[1].resize(rows, cols);
+
+    chunkBits = bits;
+    chunkRows = (rows - 1 + (1 << bits) - 1) >> bits;
+    chunkCols = (cols - 1 + (1 << bits) - 1) >> bits;
+
+    stripFlags.assign(chunkRows * chunkCols, 0);
+    stripChanged.assign(chunkRows, 0);
+    chunkMark.assign(chunkRows * chunkCols, 0);
+    dirty.clear();
+    dirtyRow1 = chunkRows;
+    dirtyCol1 = chunkCols;
+    dirtyRow2 = dirtyCol2 = -1;
+
+    memset(&stat, 0, sizeof(stat));
+}
+
+void TerrainAutomaton::load(const CornerGrid& grid, int bits)
+{
+    reset(grid.rows(), grid.cols(), bits);
+    for (int r = 0; r < grid.rows(); ++r)
+        memcpy(grids[current].row(r), grid.row(r), grid.wordsPerRow() * sizeof(unsigned int));
+}
+
+int TerrainAutomaton::step(const AutomatonRule& r)
+{
+    if (!loaded())
+        return 0;
+
+    TRACE_SCOPE("automaton step");
+
+    double start = getTicks();
+    rule = r;
+    parallelFor(jobs, chunkRows, stepStrips, this);
+    current ^= 1;
+
+    // 在调用线程中合并各条带变了的块
+    int changed = 0;
+    for (int s = 0; s < chunkRows; ++s)
+    {
+        changed += stripChanged[s];
+        for (int cc = 0; cc < chunkCols; ++cc)
+        {
+            unsigned char& flags = stripFlags[s * chunkCols + cc];
+            for (int k = 0; k < 2; ++k)
+            {
+                int cr = s - k;
+                if (!(flags & (1 << k)) || chunkMark[cr * chunkCols + cc])
+                    continue;
+
+                chunkMark[cr * chunkCols + cc] = 1;
+                dirty.push_back(cr * chunkCols + cc);
+                dirtyRow1 = std::min(dirtyRow1, cr);
+                dirtyCol1 = std::min(dirtyCol1, cc);
+                dirtyRow2 = std::max(dirtyRow2, cr);
+                dirtyCol2 = std::max(dirtyCol2, cc);
+            }
+            flags = 0;
+        }
+    }
+
+    ++stat.steps;
+    stat.changedCorners = changed;
+    stat.stepTime = getTicks() - start;
+    stat.totalStepTime += stat.stepTime;
+    stat.pendingChunks = static_cast<int>(dirty.size());
+    return changed;
+}
+
+void TerrainAutomaton::stepStrips(int begin, int end, void* p)
+{
+    TerrainAutomaton& self = *static_cast<TerrainAutomaton*>(p);
+    const CornerGrid& from = self.grids[self.current];
+    CornerGrid& to = self.grids[self.current ^ 1];
+
+    int rows = from.rows(), words = from.wordsPerRow();
+    int tileRows = rows - 1;
+    int bits = self.chunkBits, size = 1 << bits;
+    unsigned int segment = size >= 32 ? ~0u : (1u << size) - 1;
+    unsigned int tail = (from.cols() & 31) ? (1u << (from.cols() & 31)) - 1 : ~0u;
+
+    // 规则中出现的邻居数
+    int birth[9], survive[9], births = 0, survives = 0;
+    for (int n = 0; n <= 8; ++n)
+    {
+        if (self.rule.birth & (1u << n)) birth[births++] = n;
+        if (self.rule.survive & (1u << n)) survive[survives++] = n;
+    }
+
+    std::vector<unsigned int> zero(words, 0), diff(words + 1, 0);
+
+    for (int s = begin; s < end; ++s)
+    {
+        int r1 = s << bits;
+        int r2 = s + 1 == self.chunkRows ? rows : r1 + size;
+        unsigned char* flags = &self.stripFlags[s * self.chunkCols];
+        int changed = 0;
+
+        for (int r = r1; r < r2; ++r)
+        {
+            const unsigned int* up = r > 0 ? from.row(r - 1) : &zero[0];
+            const unsigned int* mid = from.row(r);
+            const unsigned int* down = r + 1 < rows ? from.row(r + 1) : &zero[0];
+            unsigned int* out = to.row(r);
+
+            for (int w = 0; w < words; ++w)
+            {
+                // 8个邻居的位平面相加，得到每个顶点的邻居数 n3 n2 n1 n0（0 ~ 8）
+                unsigned int sa, ca, sb, cb, t, e, f;
+                fullAdd(westOf(up, w), up[w], eastOf(up, w, words), sa, ca);
+                fullAdd(westOf(mid, w), eastOf(mid, w, words), westOf(down, w), sb, cb);
+                unsigned int x = down[w], y = eastOf(down, w, words);
+                unsigned int sc = x ^ y, cc = x & y;
+
+                unsigned int n0, d1, twos, n1;
+                fullAdd(sa, sb, sc, n0, d1);
+                fullAdd(ca, cb, cc, twos, e);
+                n1 = twos ^ d1;
+                f = twos & d1;
+                unsigned int n2 = e ^ f, n3 = e & f;
+
+                unsigned int born = 0, kept = 0;
+                for (int i = 0; i < births; ++i)
+                {
+                    int n = birth[i];
+                    born |= (n & 1 ? n0 : ~n0) & (n & 2 ? n1 : ~n1) & (n & 4 ? n2 : ~n2) & (n & 8 ? n3 : ~n3);
+                }
+                for (int i = 0; i < survives; ++i)
+                {
+                    int n = survive[i];
+                    kept |= (n & 1 ? n0 : ~n0) & (n & 2 ? n1 : ~n1) & (n & 4 ? n2 : ~n2) & (n & 8 ? n3 : ~n3);
+                }
+
+                t = (mid[w] & kept) | (~mid[w] & born);
+                if (w + 1 == words)
+                    t &= tail;
+                out[w] = t;
+                diff[w] = t ^ mid[w];
+            }
+
+            // 顶点 (r, c) 是元件 (r-1, c-1) (r-1, c) (r, c-1) (r, c) 的角
+            for (int w = 0; w < words; ++w)
+            {
+                // 下一个字的第0个顶点是这个字最后一个元件的右边
+                unsigned int tiles = diff[w] | (diff[w] >> 1) | (diff[w + 1] << 31);
+                if (!tiles)
+                    continue;
+
+                changed += bitCount(diff[w]);
+                for (int b = 0; b < 32; b += size)
+                {
+                    int cc = ((w << 5) + b) >> bits;
+                    if (!((tiles >> b) & segment) || cc >= self.chunkCols)
+                        continue;
+
+                    if (r < tileRows)
+                        flags[cc] |= 1;
+                    if (r > 0)
+                        flags[cc] |= (r - 1) >> bits == s ? 1 : 2;
+                }
+            }
+        }
+
+        self.stripChanged[s] = changed;
+    }
+}
+
+void TerrainAutomaton::clearDirty()
+{
+    for (size_t i = 0; i < dirty.size(); ++i)
+        chunkMark[dirty[i]] = 0;
+    dirty.clear();
+    dirtyRow1 = chunkRows;
+    dirtyCol1 = chunkCols;
+    dirtyRow2 = dirtyCol2 = -1;
+    stat.pendingChunks = 0;
+}
+
+void TerrainAutomaton::pendingBounds(int& r1, int& c1, int& r2, int& c2) const
+{
+    int tileRows = grids[current].rows() - 1, tileCols = grids[current].cols() - 1;
+    r1 = dirtyRow1 << chunkBits;
+    c1 = dirtyCol1 << chunkBits;
+    r2 = std::min((dirtyRow2 + 1) << chunkBits, tileRows);
+    c2 = std::min((dirtyCol2 + 1) << chunkBits, tileCols);
+    if (dirty.empty())
+        r1 = r2 = c1 = c2 = 0;
+}
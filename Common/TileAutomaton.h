@@ -0,0 +1,177 @@
+/*
+** 地形元胞自动机
+** 在顶点网格上按规则一步一步地侵蚀、生长或平滑地形：每个顶点数一下周围8个顶点中有几个是地形，
+** 空白顶点在数目属于 birth 时变成地形，地形顶点在数目属于 survive 时保持，否则变成空白。
+** 地图外的顶点当作空白，所以侵蚀会从地图边缘开始。
+**
+** 两份顶点网格交替读写（双缓冲），一步之内所有顶点同时更新，结果与计算顺序和线程数无关。
+** 网格按块大小的顶点行分成条带，每条交给一个工作线程；一行按32位的字计算，
+** 8个邻居的计数用位切片的加法器一次算出一个字里32个顶点的结果，不逐个顶点判断。
+** 每个条带记下自己的哪些块有顶点变了，在调用线程中合并，store() 时只重算这些块的掩码。
+**
+** 只适用于4位掩码的地图（简单模式和魔兽模式）
+**
+** author : gouki04 2011-12-30
+*/
+
+#ifndef TILEAUTOMATON_H
+#define TILEAUTOMATON_H
+
+#include <vector>
+
+#include "JobScheduler.h"
+#include "Platform.h"
+#include "TileGen.h"
+#include "TileOps.h"
+#include "TraceRecorder.h"
+
+// 第 n 位表示周围8个顶点中有 n 个是地形
+struct AutomatonRule
+{
+    unsigned int birth;     // 空白顶点变成地形
+    unsigned int survive;   // 地形顶点保持
+
+    AutomatonRule(unsigned int b = 0, unsigned int s = 0) : birth(b), survive(s) {}
+
+    // 平滑：B5678/S45678，多数决，去掉零散的点和细小的缺口
+    static AutomatonRule smooth() { return AutomatonRule(0x1E0, 0x1F0); }
+    // 侵蚀：不长新的地形，邻居少于4个的地形顶点消失
+    static AutomatonRule erode() { return AutomatonRule(0, 0x1F0); }
+    // 生长：邻居有3个以上的空白顶点变成地形，地形不会消失
+    static AutomatonRule grow() { return AutomatonRule(0x1F8, 0x1FF); }
+};
+
+// 编辑器中按编号选择的规则
+enum
+{
+    AUTOMATON_SMOOTH,
+    AUTOMATON_ERODE,
+    AUTOMATON_GROW,
+    AUTOMATON_RULES
+};
+
+AutomatonRule automatonRule(int index);
+
+struct AutomatonStats
+{
+    int steps;              // load() 之后执行的步数
+    int changedCorners;     // 最近一步变化的顶点数
+    double stepTime;        // 最近一步的耗时（秒）
+    double totalStepTime;   // load() 之后所有步的耗时（秒）
+    int pendingChunks;      // 顶点变了、还没有 store() 的块数
+    int storedChunks;       // 最近一次 store() 重算的块数
+    double storeTime;       // 最近一次 store() 的耗时（秒）
+};
+
+class TerrainAutomaton
+{
+public:
+    // jobs 不为0时每一步的条带和读入、写回地图都在工作线程中并行执行
+    explicit TerrainAutomaton(JobScheduler* jobs = 0);
+
+    // 从顶点网格开始模拟，chunkBits 是 store() 时地图的块大小
+    void load(const CornerGrid& grid, int chunkBits);
+
+    // 从地图读出顶点网格开始模拟
+    template <typename Map>
+    void load(const Map& map)
+    {
+        TRACE_SCOPE("automaton load");
+
+        reset(map.rows() + 1, map.cols() + 1, Map::CHUNK_BITS);
+        LoadArg<Map> arg = { &map, &grids[current] };
+        parallelFor(jobs, grids[current].rows(), loadRows<Map>, &arg);
+    }
+
+    bool loaded() const { return grids[current].rows() > 0; }
+
+    // 执行一步，返回变化的顶点数
+    int step(const AutomatonRule& rule);
+
+    // 把变化了的块的掩码写进地图（和编辑一样写进私有块，之后要 commit()），返回重算的块数
+    // 地图必须是 load() 时的大小和块大小
+    template <typename Map>
+    int store(Map& map)
+    {
+        TRACE_SCOPE("automaton store");
+
+        double start = getTicks();
+        int count = static_cast<int>(dirty.size());
+        retileChunks(map, grids[current], dirty, jobs);
+        clearDirty();
+
+        stat.storedChunks = count;
+        stat.storeTime = getTicks() - start;
+        return count;
+    }
+
+    // 还没有 store() 的块所在的元件范围（不包含 r2, c2），没有时 r1 >= r2
+    void pendingBounds(int& r1, int& c1, int& r2, int& c2) const;
+
+    const CornerGrid& corners() const { return grids[current]; }
+    const AutomatonStats& stats() const { return stat; }
+
+private:
+    TerrainAutomaton(const TerrainAutomaton&);
+    TerrainAutomaton& operator=(const TerrainAutomaton&);
+
+    template <typename Map>
+    struct LoadArg
+    {
+        const Map* map;
+        CornerGrid* grid;
+    };
+
+    // 读出第 begin ~ end 行顶点，每个字在本地拼好再写入
+    template <typename Map>
+    static void loadRows(int begin, int end, void* p)
+    {
+        LoadArg<Map>& arg = *static_cast<LoadArg<Map>*>(p);
+        const Map& map = *arg.map;
+        CornerGrid& grid = *arg.grid;
+
+        for (int r = begin; r < end; ++r)
+        {
+            unsigned int* row = grid.row(r);
+            for (int w = 0; w < grid.wordsPerRow(); ++w)
+            {
+                int c0 = w << 5;
+                int n = grid.cols() - c0 < 32 ? grid.cols() - c0 : 32;
+                unsigned int bits = 0;
+                for (int i = 0; i < n; ++i)
+                {
+                    if (cornerAt(map, r, c0 + i))
+                        bits |= 1u << i;
+                }
+                row[w] = bits;
+            }
+        }
+    }
+
+    static void stepStrips(int begin, int end, void* p);
+
+    void reset(int rows, int cols, int chunkBits);
+    void clearDirty();
+
+    JobScheduler* jobs;
+    CornerGrid grids[2];
+    int current;                // 当前状态在 grids 中的下标
+
+    int chunkBits;
+    int chunkRows, chunkCols;   // 地图的块数，也是条带数（最后一行顶点算在最后一个条带里）
+    AutomatonRule rule;         // 正在执行的这一步
+
+    // 每个条带的结果，只由执行这个条带的线程写入
+    // stripFlags 的每个块：1 表示这个块行的块变了，2 表示上一个块行的块变了（条带第一行顶点是上一块行元件的下边）
+    std::vector<unsigned char> stripFlags;
+    std::vector<int> stripChanged;
+
+    // 合并之后的结果
+    std::vector<unsigned char> chunkMark;
+    std::vector<int> dirty;     // cr * chunkCols + cc
+    int dirtyRow1, dirtyCol1, dirtyRow2, dirtyCol2;     // 块坐标，包含
+
+    AutomatonStats stat;
+};
+
+#endif
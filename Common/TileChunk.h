@@ -0,0 +1,692 @@
+/*
+** 分块存储的地图数据
+** 地图被切成 CHUNK_SIZE*CHUNK_SIZE 的小块，内容相同的块只在内存中保存一份（按内容哈希去重），
+** 写入时复制（copy-on-write）：修改一个被共享的块会先复制出私有副本，
+** 每帧编辑结束后调用 commit() 再把私有块按内容重新合并回池中。
+**
+** 块一旦入池就是只读的，所以可以把顶点缓存或渲染目标挂在块上，
+** 所有内容相同的块共享同一份缓存。
+**
+** author : gouki04 2011-12-30
+*/
+
+#ifndef TILECHUNK_H
+#define TILECHUNK_H
+
+#include <stdio.h>
+#include <string.h>
+#include <map>
+#include <set>
+#include <vector>
+
+#include "ContentHash.h"
+#include "Platform.h"
+#include "TileLayout.h"
+#include "TileSummary.h"
+
+// 块按内容哈希寻址
+typedef ContentHash ChunkHash;
+
+// 默认的块内排列方式
+#ifndef TILE_DEFAULT_LAYOUT
+#define TILE_DEFAULT_LAYOUT RowMajorLayout
+#endif
+
+// 地图块
+template <typename T, int BITS, template <int> class Layout = TILE_DEFAULT_LAYOUT>
+struct TileChunk
+{
+    typedef T ValueType;
+
+    enum { SHIFT = BITS, SIZE = 1 << BITS, MASK = SIZE - 1, CELLS = SIZE * SIZE };
+
+    T cells[CELLS];     // 按 Layout 排列
+
+    // 块内坐标访问
+    T get(int r, int c) const { return cells[Layout<BITS>::index(r, c)]; }
+    T& ref(int r, int c) { return cells[Layout<BITS>::index(r, c)]; }
+
+    ChunkHash hash;     // 内容哈希，只有入池后才有效
+    int refCount;       // 引用计数
+    bool shared;        // 是否已入池（只读）
+    TileSummary<T> summary;     // 块内格子的统计，只有入池后才有效
+
+    unsigned long renderCache;  // 挂在块上的渲染缓存（例如渲染目标），由使用者解释
+    int cacheGeneration;        // 渲染缓存对应的代数，与池中代数不同时说明缓存失效
+
+    bool isUniform(T value) const
+    {
+        for (int i = 0; i < CELLS; ++i)
+            if (cells[i] != value) return false;
+        return true;
+    }
+};
+
+// 块池：保存所有不同内容的块
+template <typename T, int BITS, template <int> class Layout = TILE_DEFAULT_LAYOUT>
+class ChunkPool
+{
+public:
+    typedef TileChunk<T, BITS, Layout> Chunk;
+    typedef void (*ReleaseFunc)(Chunk* chunk);
+
+    ChunkPool() : onRelease(0), generation(1), privateCount(0) {}
+
+    ~ChunkPool()
+    {
+        typename HashTable::iterator it = table.begin();
+        for (; it != table.end(); ++it)
+            destroy(it->second);
+        table.clear();
+    }
+
+    // 块被释放时的回调，用于释放挂在块上的渲染缓存
+    void setReleaseFunc(ReleaseFunc func) { onRelease = func; }
+
+    // 使所有块的渲染缓存失效（例如设备丢失后）
+    void invalidateCaches() { ++generation; }
+    int cacheGeneration() const { return generation; }
+
+    bool isCacheValid(const Chunk* chunk) const
+    {
+        return chunk->renderCache != 0 && chunk->cacheGeneration == generation;
+    }
+
+    // 新建一个私有块，内容为 src 的拷贝（src 为 0 时内容为 fill）
+    Chunk* create(const Chunk* src, T fill = T())
+    {
+        Chunk* chunk = new Chunk;
+        if (src)
+        {
+            memcpy(chunk->cells, src->cells, sizeof(chunk->cells));
+        }
+        else
+        {
+            for (int i = 0; i < Chunk::CELLS; ++i)
+                chunk->cells[i] = fill;
+        }
+
+        chunk->hash = 0;
+        chunk->refCount = 1;
+        chunk->shared = false;
+        chunk->summary = TileSummary<T>::none();
+        chunk->renderCache = 0;
+        chunk->cacheGeneration = 0;
+
+        ++privateCount;
+        return chunk;
+    }
+
+    // 把私有块并入池中，若池中已有相同内容的块则返回已有的块并释放传入的块
+    Chunk* intern(Chunk* chunk)
+    {
+        if (chunk->shared)
+            return chunk;
+
+        ChunkHash h = hashBytes(chunk->cells, sizeof(chunk->cells));
+
+        std::pair<typename HashTable::iterator, typename HashTable::iterator> range = table.equal_range(h);
+        for (typename HashTable::iterator it = range.first; it != range.second; ++it)
+        {
+            Chunk* existing = it->second;
+            if (memcmp(existing->cells, chunk->cells, sizeof(chunk->cells)) == 0)
+            {
+                ++existing->refCount;
+                release(chunk);
+                return existing;
+            }
+        }
+
+        chunk->hash = h;
+        chunk->shared = true;
+        chunk->summary = TileSummary<T>::of(chunk->cells, Chunk::CELLS);
+        --privateCount;
+        table.insert(std::make_pair(h, chunk));
+        return chunk;
+    }
+
+    void addRef(Chunk* chunk) { ++chunk->refCount; }
+
+    void release(Chunk* chunk)
+    {
+        if (--chunk->refCount > 0)
+            return;
+
+        if (chunk->shared)
+        {
+            std::pair<typename HashTable::iterator, typename HashTable::iterator> range = table.equal_range(chunk->hash);
+            for (typename HashTable::iterator it = range.first; it != range.second; ++it)
+            {
+                if (it->second == chunk)
+                {
+                    table.erase(it);
+                    break;
+                }
+            }
+        }
+        else
+        {
+            --privateCount;
+        }
+
+        destroy(chunk);
+    }
+
+    int uniqueCount() const { return static_cast<int>(table.size()) + privateCount; }
+    size_t residentBytes() const { return uniqueCount() * sizeof(Chunk); }
+
+private:
+    ChunkPool(const ChunkPool&);
+    ChunkPool& operator=(const ChunkPool&);
+
+    void destroy(Chunk* chunk)
+    {
+        if (chunk->renderCache && onRelease)
+            onRelease(chunk);
+        delete chunk;
+    }
+
+    typedef std::multimap<ChunkHash, Chunk*> HashTable;
+    HashTable table;
+
+    ReleaseFunc onRelease;
+    int generation;
+    int privateCount;
+};
+
+// 存档索引文件的文件头
+struct ChunkMapHeader
+{
+    int rows, cols;
+    int layout;     // 块大小的位数 | 块内排列方式 << 8
+    int cellSize;   // 每个格子的字节数
+    int tag;        // 由使用者解释，例如地图模式
+};
+
+inline bool readChunkMapHeader(const char* path, ChunkMapHeader& header)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file) return false;
+
+    bool ok = fread(&header, sizeof(header), 1, file) == 1;
+    fclose(file);
+    return ok;
+}
+
+// 读出块文件中每条记录（哈希 + cellBytes 字节的格子）的哈希，records 是记录条数（可能有重复的哈希）
+// 块文件不存在时为空；末尾有不完整的记录（例如写到一半失败）时返回 false，不能再往后追加
+inline bool scanChunkBlob(const char* path, size_t cellBytes, std::set<ChunkHash>& hashes, long& records)
+{
+    hashes.clear();
+    records = 0;
+
+    FILE* file = fopen(path, "rb");
+    if (!file) return true;
+
+    std::vector<unsigned char> cells(cellBytes);
+    ChunkHash h;
+    size_t n;
+    while ((n = fread(&h, 1, sizeof(h), file)) == sizeof(h)
+        && fread(&cells[0], 1, cellBytes, file) == cellBytes)
+    {
+        hashes.insert(h);
+        ++records;
+    }
+
+    bool intact = n == 0 && !ferror(file);
+    fclose(file);
+    return intact;
+}
+
+// 读出索引文件引用的所有哈希，不检查文件头
+inline void readChunkMapIndex(const char* path, std::set<ChunkHash>& hashes)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file) return;
+
+    ChunkMapHeader header;
+    ChunkHash h;
+    if (fread(&header, sizeof(header), 1, file) == 1)
+    {
+        while (fread(&h, sizeof(h), 1, file) == 1)
+            hashes.insert(h);
+    }
+    fclose(file);
+}
+
+// 分块地图
+template <typename T, int BITS = 3, template <int> class Layout = TILE_DEFAULT_LAYOUT>
+class ChunkMap
+{
+public:
+    typedef TileChunk<T, BITS, Layout> Chunk;
+    typedef ChunkPool<T, BITS, Layout> Pool;
+    typedef Layout<BITS> CellLayout;
+    typedef T ValueType;
+    typedef SummaryTree<Chunk> Summaries;
+
+    enum { CHUNK_BITS = BITS, CHUNK_SIZE = Chunk::SIZE, CHUNK_MASK = Chunk::MASK };
+
+    ChunkMap(int row, int col) : rowCount(row), colCount(col)
+    {
+        chunkRowCount = (row + CHUNK_MASK) >> BITS;
+        chunkColCount = (col + CHUNK_MASK) >> BITS;
+
+        // 所有块一开始都指向同一个空白块
+        Chunk* empty = pool.intern(pool.create(0));
+        chunks.assign(chunkRowCount * chunkColCount, empty);
+        for (size_t i = 1; i < chunks.size(); ++i)
+            pool.addRef(empty);
+
+        summaries.reset(row, col);
+        rebuildSummaries();
+    }
+
+    ~ChunkMap()
+    {
+        for (size_t i = 0; i < chunks.size(); ++i)
+            pool.release(chunks[i]);
+    }
+
+    int rows() const { return rowCount; }
+    int cols() const { return colCount; }
+    int chunkRows() const { return chunkRowCount; }
+    int chunkCols() const { return chunkColCount; }
+
+    Pool& chunkPool() { return pool; }
+
+    // 区域统计反映的是上次 commit() 时的内容，还没有提交的修改不算
+    const Summaries& summary() const { return summaries; }
+
+    // 第 r1 ~ r2 行、第 c1 ~ c2 列（不包含 r2, c2）内有没有地形
+    bool regionEmpty(int r1, int c1, int r2, int c2) const { return summaries.empty(r1, c1, r2, c2); }
+
+    T get(int r, int c) const
+    {
+        const Chunk* chunk = chunks[(r >> BITS) * chunkColCount + (c >> BITS)];
+        return chunk->get(r & CHUNK_MASK, c & CHUNK_MASK);
+    }
+
+    // 取得可写的格子，共享块会先被复制
+    T& at(int r, int c)
+    {
+        Chunk* chunk = writableChunk(r >> BITS, c >> BITS);
+        return chunk->ref(r & CHUNK_MASK, c & CHUNK_MASK);
+    }
+
+    void set(int r, int c, T value)
+    {
+        if (get(r, c) != value)
+            at(r, c) = value;
+    }
+
+    void orBits(int r, int c, T bits)
+    {
+        if ((get(r, c) & bits) != bits)
+            at(r, c) |= bits;
+    }
+
+    void clearBits(int r, int c, T bits)
+    {
+        if (get(r, c) & bits)
+            at(r, c) &= ~bits;
+    }
+
+    const Chunk* chunkAt(int cr, int cc) const { return chunks[cr * chunkColCount + cc]; }
+    Chunk* chunkAt(int cr, int cc) { return chunks[cr * chunkColCount + cc]; }
+
+    Chunk* writableChunk(int cr, int cc)
+    {
+        Chunk*& chunk = chunks[cr * chunkColCount + cc];
+        if (chunk->shared || chunk->refCount > 1)
+        {
+            Chunk* copy = pool.create(chunk);
+            pool.release(chunk);
+            chunk = copy;
+            dirty.push_back(cr * chunkColCount + cc);
+        }
+        return chunk;
+    }
+
+    // 把第 cr 行、第 cc 列换成已入池的块 chunk（增加一个引用），不经过 commit()
+    // 用于整块生成地图（见 TileGen.h），全部换完之后调用 rebuildSummaries()
+    void replaceChunk(int cr, int cc, Chunk* chunk)
+    {
+        pool.addRef(chunk);
+        Chunk*& slot = chunks[cr * chunkColCount + cc];
+        pool.release(slot);
+        slot = chunk;
+    }
+
+    void rebuildSummaries()
+    {
+        for (int cr = 0; cr < chunkRowCount; ++cr)
+            for (int cc = 0; cc < chunkColCount; ++cc)
+                summaries.setLeaf(cr, cc, chunks[cr * chunkColCount + cc]);
+        summaries.rebuild();
+    }
+
+    // 把本帧修改过的块按内容合并回池中，没有修改过任何块时返回 false
+    bool commit()
+    {
+        if (dirty.empty())
+            return false;
+
+        for (size_t i = 0; i < dirty.size(); ++i)
+        {
+            Chunk*& chunk = chunks[dirty[i]];
+            chunk = pool.intern(chunk);
+            summaries.set(dirty[i] / chunkColCount, dirty[i] % chunkColCount, chunk);
+        }
+        dirty.clear();
+        return true;
+    }
+
+    void clear()
+    {
+        Chunk* empty = pool.intern(pool.create(0));
+        for (size_t i = 0; i < chunks.size(); ++i)
+        {
+            pool.release(chunks[i]);
+            pool.addRef(empty);
+            chunks[i] = empty;
+        }
+        pool.release(empty);
+        dirty.clear();
+        rebuildSummaries();
+    }
+
+    // 整张地图逐行计算的内容哈希，与块大小和块内排列无关，用来比较两张地图是否相同
+    ContentHash contentHash() const
+    {
+        ContentHash h = CONTENT_HASH_SEED;
+        if (colCount <= 0)
+            return h;
+
+        std::vector<T> row(colCount);
+        for (int r = 0; r < rowCount; ++r)
+        {
+            for (int c = 0; c < colCount; ++c)
+                row[c] = get(r, c);
+            h = hashBytes(&row[0], row.size() * sizeof(T), h);
+        }
+        return h;
+    }
+
+    /*
+    ** 存档分为两个文件：
+    ** 索引文件 path 记录每个块位置对应的内容哈希，
+    ** 块文件 path.chunks 保存块内容，每次保存只追加其中还没有的块，未修改的块只需要比对哈希。
+    ** 块文件中的记录超过地图引用的块的两倍时整个重写，去掉不再引用的块。
+    ** 索引文件和重写的块文件都先写到临时文件再替换，中途失败时原来的存档仍然可以读入
+    */
+    ChunkMapHeader header(int tag) const
+    {
+        ChunkMapHeader h;
+        h.rows = rowCount;
+        h.cols = colCount;
+        h.layout = BITS | (CellLayout::ID << 8);
+        h.cellSize = static_cast<int>(sizeof(T));
+        h.tag = tag;
+        return h;
+    }
+
+    bool save(const char* path, int tag = 0)
+    {
+        commit();
+
+        char blobPath[260];
+        sprintf(blobPath, "%s.chunks", path);
+
+        // 按块文件现在的内容决定要写哪些块，换了路径或块文件被删除、替换过都不会漏写
+        std::set<ChunkHash> stored;
+        long records = 0;
+        bool intact = scanChunkBlob(blobPath, sizeof(T) * Chunk::CELLS, stored, records);
+
+        ChunkSet live;
+        for (size_t i = 0; i < chunks.size(); ++i)
+            live.insert(std::make_pair(chunks[i]->hash, chunks[i]));
+
+        long missing = 0;
+        typename ChunkSet::const_iterator it = live.begin();
+        for (; it != live.end(); ++it)
+        {
+            if (stored.find(it->first) == stored.end())
+                ++missing;
+        }
+
+        bool ok;
+        if (intact && records + missing <= 2 * static_cast<long>(live.size()))
+            ok = appendChunks(blobPath, live, stored);
+        else
+            ok = compactChunks(path, blobPath, live);
+        if (!ok) return false;
+
+        char tempPath[270];
+        sprintf(tempPath, "%s.tmp", path);
+
+        FILE* index = fopen(tempPath, "wb");
+        if (!index) return false;
+
+        ChunkMapHeader h = header(tag);
+        ok = fwrite(&h, sizeof(h), 1, index) == 1;
+        for (size_t i = 0; i < chunks.size() && ok; ++i)
+            ok = fwrite(&chunks[i]->hash, sizeof(ChunkHash), 1, index) == 1;
+        ok = fclose(index) == 0 && ok;
+
+        if (ok)
+            ok = replaceFile(tempPath, path);
+        if (!ok)
+            remove(tempPath);
+        return ok;
+    }
+
+    // 只能读入与本地图大小、格式和 tag 都一致的存档
+    bool load(const char* path, int tag = 0)
+    {
+        FILE* index = fopen(path, "rb");
+        if (!index) return false;
+
+        ChunkMapHeader h, expected = header(tag);
+        if (fread(&h, sizeof(h), 1, index) != 1 || memcmp(&h, &expected, sizeof(h)) != 0)
+        {
+            fclose(index);
+            return false;
+        }
+
+        std::vector<ChunkHash> hashes(chunks.size());
+        bool ok = fread(&hashes[0], sizeof(ChunkHash), hashes.size(), index) == hashes.size();
+        fclose(index);
+        if (!ok) return false;
+
+        char blobPath[260];
+        sprintf(blobPath, "%s.chunks", path);
+
+        FILE* blob = fopen(blobPath, "rb");
+        if (!blob) return false;
+
+        // 读入块文件中的所有块，入池去重
+        std::map<ChunkHash, Chunk*> loaded;
+        Chunk* chunk = pool.create(0);
+        while (fread(&chunk->hash, sizeof(chunk->hash), 1, blob) == 1
+            && fread(chunk->cells, sizeof(chunk->cells), 1, blob) == 1)
+        {
+            ChunkHash h = chunk->hash;
+            Chunk* interned = pool.intern(chunk);
+
+            // 块文件中出现重复内容时，多出的引用直接释放
+            if (!loaded.insert(std::make_pair(h, interned)).second)
+                pool.release(interned);
+
+            chunk = pool.create(0);
+        }
+        pool.release(chunk);
+        fclose(blob);
+
+        for (size_t i = 0; i < hashes.size(); ++i)
+        {
+            if (loaded.find(hashes[i]) == loaded.end())
+                ok = false;
+        }
+
+        if (ok)
+        {
+            for (size_t i = 0; i < chunks.size(); ++i)
+            {
+                Chunk* found = loaded[hashes[i]];
+                pool.addRef(found);
+                pool.release(chunks[i]);
+                chunks[i] = found;
+            }
+            dirty.clear();
+            rebuildSummaries();
+        }
+
+        typename std::map<ChunkHash, Chunk*>::iterator it = loaded.begin();
+        for (; it != loaded.end(); ++it)
+            pool.release(it->second);
+
+        return ok;
+    }
+
+private:
+    ChunkMap(const ChunkMap&);
+    ChunkMap& operator=(const ChunkMap&);
+
+    // 地图引用的块，按哈希去重
+    typedef std::map<ChunkHash, const Chunk*> ChunkSet;
+
+    static bool writeChunk(FILE* file, ChunkHash hash, const T* cells)
+    {
+        return fwrite(&hash, sizeof(hash), 1, file) == 1
+            && fwrite(cells, sizeof(T) * Chunk::CELLS, 1, file) == 1;
+    }
+
+    // 把块文件中还没有的块追加到末尾
+    static bool appendChunks(const char* blobPath, const ChunkSet& live, const std::set<ChunkHash>& stored)
+    {
+        FILE* blob = fopen(blobPath, "ab");
+        if (!blob) return false;
+
+        bool ok = true;
+        typename ChunkSet::const_iterator it = live.begin();
+        for (; it != live.end() && ok; ++it)
+        {
+            if (stored.find(it->first) == stored.end())
+                ok = writeChunk(blob, it->first, it->second->cells);
+        }
+        return fclose(blob) == 0 && ok;
+    }
+
+    // 重写块文件，只留下地图引用的块和旧索引文件引用的块，
+    // 这样在新的索引文件替换旧的之前，旧的存档仍然完整
+    static bool compactChunks(const char* path, const char* blobPath, const ChunkSet& live)
+    {
+        std::set<ChunkHash> keep, written;
+        readChunkMapIndex(path, keep);
+
+        char tempPath[270];
+        sprintf(tempPath, "%s.tmp", blobPath);
+
+        FILE* temp = fopen(tempPath, "wb");
+        if (!temp) return false;
+
+        bool ok = true;
+        FILE* blob = fopen(blobPath, "rb");
+        if (blob)
+        {
+            std::vector<T> cells(Chunk::CELLS);
+            ChunkHash h;
+            while (ok && fread(&h, sizeof(h), 1, blob) == 1
+                && fread(&cells[0], sizeof(T) * Chunk::CELLS, 1, blob) == 1)
+            {
+                if (keep.find(h) != keep.end() && live.find(h) == live.end() && written.insert(h).second)
+                    ok = writeChunk(temp, h, &cells[0]);
+            }
+            fclose(blob);
+        }
+
+        typename ChunkSet::const_iterator it = live.begin();
+        for (; it != live.end() && ok; ++it)
+            ok = writeChunk(temp, it->first, it->second->cells);
+        ok = fclose(temp) == 0 && ok;
+
+        if (ok)
+            ok = replaceFile(tempPath, blobPath);
+        if (!ok)
+            remove(tempPath);
+        return ok;
+    }
+
+    int rowCount, colCount;
+    int chunkRowCount, chunkColCount;
+
+    Pool pool;
+    std::vector<Chunk*> chunks;
+    std::vector<int> dirty;
+    Summaries summaries;    // 只包含已经入池的块
+};
+
+/*
+** 记住每个位置上次看到的块（持有它的引用），找出之后换了块的位置，
+** 用来只更新从地图内容派生出来的数据中改过的块（例如碰撞轮廓、导航图）。
+** 地图必须比它活得久，并且只在 commit() 之后调用 collect()
+*/
+template <typename Map>
+class ChunkWatcher
+{
+public:
+    explicit ChunkWatcher(Map& m)
+        : map(m), seen(m.chunkRows() * m.chunkCols(), static_cast<typename Map::Chunk*>(0))
+    {
+    }
+
+    ~ChunkWatcher()
+    {
+        for (size_t i = 0; i < seen.size(); ++i)
+        {
+            if (seen[i])
+                map.chunkPool().release(seen[i]);
+        }
+    }
+
+    // 第 r1 ~ r2 行、第 c1 ~ c2 列（不包含 r2, c2）的元件所在的块中，换了块的位置（cr * chunkCols() + cc）
+    // 追加到 changed，并记住现在的块
+    void collect(int r1, int c1, int r2, int c2, std::vector<int>& changed)
+    {
+        if (r1 < 0) r1 = 0;
+        if (c1 < 0) c1 = 0;
+        if (r2 > map.rows()) r2 = map.rows();
+        if (c2 > map.cols()) c2 = map.cols();
+        if (r1 >= r2 || c1 >= c2)
+            return;
+
+        for (int cr = r1 >> Map::CHUNK_BITS; cr <= (r2 - 1) >> Map::CHUNK_BITS; ++cr)
+        {
+            for (int cc = c1 >> Map::CHUNK_BITS; cc <= (c2 - 1) >> Map::CHUNK_BITS; ++cc)
+            {
+                int i = cr * map.chunkCols() + cc;
+                typename Map::Chunk* chunk = map.chunkAt(cr, cc);
+                if (chunk == seen[i])
+                    continue;
+
+                map.chunkPool().addRef(chunk);
+                if (seen[i])
+                    map.chunkPool().release(seen[i]);
+                seen[i] = chunk;
+                changed.push_back(i);
+            }
+        }
+    }
+
+    void collect(std::vector<int>& changed) { collect(0, 0, map.rows(), map.cols(), changed); }
+
+private:
+    ChunkWatcher(const ChunkWatcher&);
+    ChunkWatcher& operator=(const ChunkWatcher&);
+
+    Map& map;
+    std::vector<typename Map::Chunk*> seen;
+};
+
+#endif
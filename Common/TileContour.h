@@ -0,0 +1,267 @@
+/*
+** 碰撞轮廓
+** 魔兽模式（和简单模式）的顶点网格就是一个 marching squares 的场，元件掩码 0 ~ 15 正好是它的16种情况：
+** 每个元件里的地形部分是由角和边中点围成的凸多边形。
+** 块内相邻两个元件在共用边上的部分总是互相抵消，所以提取一个块时只收集元件内部的斜边和中线，
+** 加上落在块边界上的元件边，再首尾相连成闭合多边形，并合并共线的边。
+**
+** 坐标以半个元件为单位（边中点也落在整数上），原点是地图左上角。
+** 按屏幕坐标（y向下）顺时针排列的多边形是地形的外边界，逆时针的是地形围出来的洞。
+** 对角的两个角（掩码 6 和 9）按不相连处理。
+** 每个块的多边形只覆盖块内的部分，相邻块的多边形在块边界上拼接，修改一个块只需要重新提取这个块。
+**
+** 只适用于4位掩码的地图（简单模式和魔兽模式）
+**
+** author : gouki04 2011-12-30
+*/
+
+#ifndef TILECONTOUR_H
+#define TILECONTOUR_H
+
+#include <vector>
+
+struct ContourPoint
+{
+    int x, y;
+};
+
+// 一个块的所有多边形，顶点依次存放
+struct ChunkContours
+{
+    std::vector<ContourPoint> points;
+    std::vector<int> ends;      // 第 i 个多边形的顶点是 points[ends[i - 1]] ~ points[ends[i] - 1]
+
+    int polygonCount() const { return static_cast<int>(ends.size()); }
+    int polygonBegin(int i) const { return i > 0 ? ends[i - 1] : 0; }
+    int polygonEnd(int i) const { return ends[i]; }
+
+    void clear()
+    {
+        points.clear();
+        ends.clear();
+    }
+
+    // 所有多边形有向面积之和的两倍（单位是半个元件的平方，一个元件是8），洞的面积为负
+    long doubleArea() const
+    {
+        long sum = 0;
+        for (int i = 0; i < polygonCount(); ++i)
+        {
+            int begin = polygonBegin(i), end = polygonEnd(i);
+            for (int k = begin; k < end; ++k)
+            {
+                const ContourPoint& a = points[k];
+                const ContourPoint& b = points[k + 1 < end ? k + 1 : begin];
+                sum += static_cast<long>(a.x) * b.y - static_cast<long>(b.x) * a.y;
+            }
+        }
+        return sum;
+    }
+};
+
+namespace contour_detail
+{
+    // 元件内的8个点，顺时针：左上 上 右上 右 右下 下 左下 左
+    const int POINT_X[8] = { 0, 1, 2, 2, 2, 1, 0, 0 };
+    const int POINT_Y[8] = { 0, 0, 0, 1, 2, 2, 2, 1 };
+
+    // 每种掩码下元件内的地形多边形，顺时针，-1 分隔多个多边形，-2 结束
+    const signed char PIECES[16][10] =
+    {
+        { -2 },
+        { 0, 1, 7, -2 },
+        { 1, 2, 3, -2 },
+        { 0, 2, 3, 7, -2 },
+        { 7, 5, 6, -2 },
+        { 0, 1, 5, 6, -2 },
+        { 1, 2, 3, -1, 7, 5, 6, -2 },
+        { 0, 2, 3, 5, 6, -2 },
+        { 3, 4, 5, -2 },
+        { 0, 1, 7, -1, 3, 4, 5, -2 },
+        { 1, 2, 4, 5, -2 },
+        { 0, 2, 4, 5, 7, -2 },
+        { 7, 3, 4, 6, -2 },
+        { 0, 1, 3, 4, 6, -2 },
+        { 1, 2, 4, 6, 7, -2 },
+        { 0, 2, 4, 6, -2 }
+    };
+
+    inline int sign(int v) { return (v > 0) - (v < 0); }
+}
+
+/*
+** 提取第 cr 行、第 cc 列的块的多边形
+** next 是临时空间，反复调用时传同一个可以避免重新分配
+*/
+template <typename Map>
+void extractContours(const Map& map, int cr, int cc, ChunkContours& out, std::vector<int>& next)
+{
+    using namespace contour_detail;
+
+    out.clear();
+
+    const typename Map::Chunk* chunk = map.chunkAt(cr, cc);
+    int r0 = cr << Map::CHUNK_BITS, c0 = cc << Map::CHUNK_BITS;
+    int rows = map.rows() - r0 < Map::CHUNK_SIZE ? map.rows() - r0 : Map::CHUNK_SIZE;
+    int cols = map.cols() - c0 < Map::CHUNK_SIZE ? map.cols() - c0 : Map::CHUNK_SIZE;
+
+    // 入池的块有统计：没有地形的块没有多边形，全是地形的块就是整个块
+    if (chunk->shared && chunk->summary.empty())
+        return;
+
+    if (chunk->shared && chunk->summary.isUniform() && chunk->summary.minValue == 0xF
+        && rows == Map::CHUNK_SIZE && cols == Map::CHUNK_SIZE)
+    {
+        ContourPoint corners[4] =
+        {
+            { c0 * 2, r0 * 2 }, { (c0 + cols) * 2, r0 * 2 },
+            { (c0 + cols) * 2, (r0 + rows) * 2 }, { c0 * 2, (r0 + rows) * 2 }
+        };
+        out.points.assign(corners, corners + 4);
+        out.ends.push_back(4);
+        return;
+    }
+
+    // 块内的点按 y * w + x 编号，每个点最多只有一条出边
+    int w = cols * 2 + 1;
+    next.assign(w * (rows * 2 + 1), -1);
+
+    int edges = 0;
+    for (int r = 0; r < rows; ++r)
+    {
+        for (int c = 0; c < cols; ++c)
+        {
+            const signed char* piece = PIECES[chunk->get(r, c) & 0xF];
+            for (int first = 0; piece[first] != -2; )
+            {
+                int last = first;
+                while (piece[last + 1] >= 0)
+                    ++last;
+
+                for (int k = first; k <= last; ++k)
+                {
+                    int a = piece[k], b = piece[k < last ? k + 1 : first];
+                    int ax = POINT_X[a], ay = POINT_Y[a], bx = POINT_X[b], by = POINT_Y[b];
+
+                    // 落在元件边上的边只有在块的边界上才保留
+                    if (ay == 0 && by == 0 && r > 0) continue;
+                    if (ay == 2 && by == 2 && r < rows - 1) continue;
+                    if (ax == 0 && bx == 0 && c > 0) continue;
+                    if (ax == 2 && bx == 2 && c < cols - 1) continue;
+
+                    next[(r * 2 + ay) * w + c * 2 + ax] = (r * 2 + by) * w + c * 2 + bx;
+                    ++edges;
+                }
+
+                first = piece[last + 1] == -1 ? last + 2 : last + 1;
+            }
+        }
+    }
+
+    // 沿出边走回起点就是一个多边形，走过的边清掉
+    std::vector<int> loop;
+    for (int start = 0; start < static_cast<int>(next.size()) && edges > 0; ++start)
+    {
+        if (next[start] < 0)
+            continue;
+
+        loop.clear();
+        int v = start;
+        while (v >= 0 && next[v] >= 0)
+        {
+            loop.push_back(v);
+            int n = next[v];
+            next[v] = -1;
+            --edges;
+            v = n;
+        }
+
+        // 掩码互相矛盾的地图可能走不回起点，丢掉这一段
+        if (v != start || loop.size() < 3)
+            continue;
+
+        // 前后两条边方向相同的点是多余的
+        size_t n = loop.size();
+        for (size_t k = 0; k < n; ++k)
+        {
+            int p = loop[(k + n - 1) % n], q = loop[k], s = loop[(k + 1) % n];
+            int dx1 = sign(q % w - p % w), dy1 = sign(q / w - p / w);
+            int dx2 = sign(s % w - q % w), dy2 = sign(s / w - q / w);
+            if (dx1 == dx2 && dy1 == dy2)
+                continue;
+
+            ContourPoint point = { c0 * 2 + q % w, r0 * 2 + q / w };
+            out.points.push_back(point);
+        }
+        out.ends.push_back(static_cast<int>(out.points.size()));
+    }
+}
+
+/*
+** 整张地图按块保存的多边形
+** update() 时只重新提取换了块的位置（见 ChunkWatcher），地图必须比 ContourSet 活得久，
+** 并且只在地图 commit() 之后调用 update()
+*/
+template <typename Map>
+class ContourSet
+{
+public:
+    explicit ContourSet(Map& m) : map(m), watcher(m), contours(m.chunkRows() * m.chunkCols()) {}
+
+    // 重新提取换了块的位置，返回提取的块数
+    int update()
+    {
+        return update(0, 0, map.rows(), map.cols());
+    }
+
+    // 只检查第 r1 ~ r2 行、第 c1 ~ c2 列（不包含 r2, c2）的元件所在的块，编辑的范围已知时用这个
+    int update(int r1, int c1, int r2, int c2)
+    {
+        changed.clear();
+        watcher.collect(r1, c1, r2, c2, changed);
+
+        for (size_t i = 0; i < changed.size(); ++i)
+        {
+            int cr = changed[i] / map.chunkCols(), cc = changed[i] % map.chunkCols();
+            extractContours(map, cr, cc, contours[changed[i]], scratch);
+        }
+        return static_cast<int>(changed.size());
+    }
+
+    const ChunkContours& chunk(int cr, int cc) const { return contours[cr * map.chunkCols() + cc]; }
+
+    int polygonCount() const
+    {
+        int n = 0;
+        for (size_t i = 0; i < contours.size(); ++i)
+            n += contours[i].polygonCount();
+        return n;
+    }
+
+    int pointCount() const
+    {
+        int n = 0;
+        for (size_t i = 0; i < contours.size(); ++i)
+            n += static_cast<int>(contours[i].points.size());
+        return n;
+    }
+
+    long doubleArea() const
+    {
+        long sum = 0;
+        for (size_t i = 0; i < contours.size(); ++i)
+            sum += contours[i].doubleArea();
+        return sum;
+    }
+
+private:
+    ContourSet(const ContourSet&);
+    ContourSet& operator=(const ContourSet&);
+
+    Map& map;
+    ChunkWatcher<Map> watcher;
+    std::vector<ChunkContours> contours;
+    std::vector<int> changed, scratch;
+};
+
+#endif
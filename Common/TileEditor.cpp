@@ -0,0 +1,212 @@
+/*
+** 地图编辑器的运行期分派
+**
+** author : gouki04 2011-12-30
+*/
+
+#include "TileEditor.h"
+
+HGE* TileEditor::hge = 0;
+Mutex TileEditor::targetLock;
+std::vector<HTARGET> TileEditor::freedTargets;
+volatile long TileEditor::freedCount = 0;
+
+TileEditor::TileEditor(int x, int y)
+    : originX(x), originY(y), useChunkCache(true), zoomLevel(0), uploadBudget(CHUNK_UPLOAD_BUDGET),
+      submitted(0), executed(0), stopping(0), threaded(false)
+{
+    hge = hgeCreate(HGE_VERSION);
+
+    setViewport(0, 0, hge->System_GetState(HGE_SCREENWIDTH), hge->System_GetState(HGE_SCREENHEIGHT));
+}
+
+TileEditor::~TileEditor()
+{
+    // 派生类析构时释放的地图块都在这里，已经在主线程中了
+    freeDeferredTargets();
+    hge->Release();
+}
+
+void TileEditor::setViewport(int left, int top, int right, int bottom)
+{
+    viewportLeft = left;
+    viewportTop = top;
+    viewportRight = right;
+    viewportBottom = bottom;
+}
+
+int TileEditor::viewportDistance(int x1, int y1, int x2, int y2) const
+{
+    if (viewportRight <= viewportLeft || viewportBottom <= viewportTop)
+        return -1;
+
+    int dx = 0, dy = 0;
+    if (x2 <= viewportLeft) dx = viewportLeft - x2 + 1;
+    else if (x1 >= viewportRight) dx = x1 - viewportRight + 1;
+    if (y2 <= viewportTop) dy = viewportTop - y2 + 1;
+    else if (y1 >= viewportBottom) dy = y1 - viewportBottom + 1;
+
+    return dx + dy;
+}
+
+bool TileEditor::startEditThread()
+{
+    if (threaded)
+        return true;
+
+    atomicStore(&stopping, 0);
+    threaded = editThread.start(editThreadMain, this);
+    return threaded;
+}
+
+void TileEditor::stopEditThread()
+{
+    if (!threaded)
+        return;
+
+    // 编辑线程会先执行完队列里剩下的命令
+    atomicStore(&stopping, 1);
+    wake.signal();
+    editThread.join();
+    threaded = false;
+}
+
+void TileEditor::submit(const EditCommand& command)
+{
+    if (!threaded)
+    {
+        execute(command);
+        return;
+    }
+
+    // 队列满了说明编辑线程跟不上，等它清空队列
+    while (!commands.push(command))
+    {
+        wake.signal();
+        drained.wait();
+    }
+    ++submitted;
+
+    // 一帧的命令攒到 commit 时一起交给编辑线程
+    if (command.type == EDIT_COMMIT)
+        wake.signal();
+}
+
+void TileEditor::flush()
+{
+    if (!threaded)
+        return;
+
+    wake.signal();
+    while (atomicLoad(&executed) != submitted)
+        drained.wait();
+}
+
+void TileEditor::drain()
+{
+    EditCommand command;
+    while (commands.pop(command))
+    {
+        execute(command);
+        atomicAdd(&executed, 1);
+    }
+    drained.signal();
+}
+
+void TileEditor::editThreadMain(void* arg)
+{
+    TileEditor* editor = static_cast<TileEditor*>(arg);
+    TraceRecorder::setThreadName("edit");
+
+    for (;;)
+    {
+        // 先读结束标志再清空队列，要求结束之前提交的命令都会被执行
+        bool stop = atomicLoad(&editor->stopping) != 0;
+        editor->drain();
+        if (stop)
+        {
+            TraceRecorder::threadExit();
+            return;
+        }
+
+        editor->wake.wait();
+    }
+}
+
+void TileEditor::deferTargetFree(HTARGET target)
+{
+    ScopedLock lock(targetLock);
+    freedTargets.push_back(target);
+    atomicAdd(&freedCount, 1);
+}
+
+void TileEditor::freeDeferredTargets()
+{
+    // 绝大多数帧没有要释放的渲染目标，不用去抢锁
+    if (atomicLoad(&freedCount) == 0)
+        return;
+
+    std::vector<HTARGET> list;
+    {
+        ScopedLock lock(targetLock);
+        list.swap(freedTargets);
+        atomicStore(&freedCount, 0);
+    }
+
+    for (size_t i = 0; i < list.size(); ++i)
+        hge->Target_Free(list[i]);
+}
+
+// 支持的组合：元件大小 16 / 32 / 64，简单和魔兽模式支持8位和16位格子，8邻接模式需要16位格子
+#define TILE_EDITOR_CASE(MODE, BITS, SHIFT) \
+    case TILE_EDITOR_TAG(MODE::ID, BITS, SHIFT): \
+        return new TileEditorT<MODE, BITS, SHIFT>(rows, cols, graphics, originX, originY);
+
+#define TILE_EDITOR_CASES(MODE, BITS) \
+    TILE_EDITOR_CASE(MODE, BITS, 4) \
+    TILE_EDITOR_CASE(MODE, BITS, 5) \
+    TILE_EDITOR_CASE(MODE, BITS, 6)
+
+TileEditor* createTileEditor(int mode, int cellBits, int tileShift, int rows, int cols,
+                             const TileGraphics& graphics, int originX, int originY)
+{
+    if (rows <= 0 || cols <= 0)
+        return 0;
+
+    switch (TILE_EDITOR_TAG(mode, cellBits, tileShift))
+    {
+        TILE_EDITOR_CASES(EasyMode, 8)
+        TILE_EDITOR_CASES(EasyMode, 16)
+        TILE_EDITOR_CASES(WarcraftMode, 8)
+        TILE_EDITOR_CASES(WarcraftMode, 16)
+        TILE_EDITOR_CASES(BlobMode, 16)
+    }
+
+    return 0;
+}
+
+TileEditor* createTileEditorFor(const char* path, const TileGraphics& graphics, int originX, int originY)
+{
+    ChunkMapHeader header;
+    if (!readChunkMapHeader(path, header))
+        return 0;
+
+    int mode = header.tag & 0xFF;
+    int cellBits = (header.tag >> 8) & 0xFF;
+    int tileShift = (header.tag >> 16) & 0xFF;
+
+    return createTileEditor(mode, cellBits, tileShift, header.rows, header.cols, graphics, originX, originY);
+}
+
+TileEditor* loadTileEditor(const char* path, const TileGraphics& graphics, int originX, int originY)
+{
+    TileEditor* editor = createTileEditorFor(path, graphics, originX, originY);
+
+    if (editor && !editor->load(path))
+    {
+        delete editor;
+        editor = 0;
+    }
+
+    return editor;
+}
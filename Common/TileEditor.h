@@ -0,0 +1,1297 @@
+/*
+** 地图编辑器的公共部分
+** TileEditorT 按 地图模式 / 格子位宽 / 元件大小 在编译期特化，
+** 元件大小固定为 2 的幂，坐标换算全部用移位完成；
+** 读入存档时由 loadTileEditor() 根据文件头在运行期选择对应的特化版本。
+**
+** 调用 startEditThread() 之后地图数据归编辑线程所有：主线程的 stamp() / commit() 只是把命令放进无锁队列，
+** 编辑线程每次 commit 之后发布一份块指针的快照（块入池后只读，快照只需要持有引用），
+** 主线程绘制时只读最新的快照，耗时的编辑不会让画面停顿。
+** 快照的交接不加锁：发布和取走都是一次指针交换，主线程换下的旧快照放进无锁栈，
+** 由编辑线程在下一次 commit 时释放，所以块的引用计数始终只在一个线程中修改。
+**
+** 渲染缓存失效的块交给任务调度器在工作线程中转换成四边形，离视口近的先转换；
+** 主线程每帧只花 uploadBudget 秒把转换好的块画到渲染目标上，还没有缓存的块直接从图集画。
+** save() / load() / generate() / contentHash() 会先等编辑线程执行完已经提交的命令。
+**
+** 缩小显示时不再画每个块的缓存，而是画按位置划分的 LOD 图像：每张图像覆盖若干个块，缩小后正好是一个块的像素大小，
+** 整个屏幕只需要十几个四边形。LOD 图像直接用带 mipmap 的元件纹理缩小绘制，
+** 地图改动后只重画图像上变化了的那几个块的区域，同样受 uploadBudget 限制。
+**
+** 元胞自动机（TileAutomaton.h）的顶点网格在编辑线程中一直保留，stamp、读入或生成之后才重新从地图读出；
+** 每次模拟后只重算顶点变了的块，和 stamp 一样在下一个 commit 中合并和发布。
+**
+** 地形区域（TileRegions.h）在创建和读入时并行标记，之后由拥有地图的线程在每次 commit 时只更新这一帧 stamp 过的范围。
+**
+** 小地图按 stamp() 改动的格子范围增量更新：每次 stamp 记下范围和它所属的 commit 的序号，
+** 编辑线程执行完这个 commit 之后取得的快照里一定已经包含了这次改动，这时才按快照的内容更新这些纹素。
+** 元胞自动机改动的范围只有编辑线程知道，由编辑线程记下来交给主线程，同样等所属的 commit 执行完才更新。
+**
+** author : gouki04 2011-12-30
+*/
+
+#ifndef TILEEDITOR_H
+#define TILEEDITOR_H
+
+#include "..\hge\hge.h"
+#include "..\hge\hgesprite.h"
+
+#include "TileAutomaton.h"
+#include "TileChunk.h"
+#include "TileGen.h"
+#include "TileMode.h"
+#include "TileRegions.h"
+#include "TileMesh.h"
+#include "TileSet.h"
+#include "QuadBatch.h"
+#include "RetainedFrame.h"
+#include "JobScheduler.h"
+#include "Overlay.h"
+#include "Minimap.h"
+#include "SpscQueue.h"
+#include "TraceRecorder.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <vector>
+
+#define EDIT_QUEUE_SIZE 1024        // 编辑命令队列的容量，满了主线程会等编辑线程
+#define CHUNK_UPLOAD_BUDGET 0.002   // 每帧用于把转换好的地图块画到渲染目标上的时间（秒）
+#define GRID_COLOR 0xFF808080       // 网格线
+#define GRID_MIN_CELL 4             // 缩小后格子小于这个像素数时不画网格
+#define FOOTPRINT_COLOR 0xFF3070D0  // 笔刷范围的框线
+
+// 编辑命令
+enum
+{
+    EDIT_STAMP,     // 在 row, col 绘制（value 为 true）或清除
+    EDIT_SIMULATE,  // 按第 row 种规则（AUTOMATON_SMOOTH 等）执行 col 步元胞自动机
+    EDIT_COMMIT     // 一帧的编辑结束，合并修改过的块并发布快照
+};
+
+struct EditCommand
+{
+    int type;
+    int row, col;
+    bool value;
+};
+
+// 绘制地图用的图片资源，由编辑器在 loadContent() 中创建，所有编辑器共用
+struct TileGraphics
+{
+    TileSet* tiles;         // 地图元件
+    hgeSprite* highlight;   // 高亮框
+};
+
+class TileEditor
+{
+public:
+    TileEditor(int originX, int originY);
+    virtual ~TileEditor();
+
+    virtual int mode() const = 0;
+    virtual int cellBits() const = 0;
+    virtual int tileShift() const = 0;
+    virtual int rows() const = 0;
+    virtual int cols() const = 0;
+
+    // 根据鼠标位置更新高亮位置
+    virtual void updateHighlight(float mx, float my) = 0;
+
+    // 在高亮位置绘制（value 为 true）或清除
+    virtual void stamp(bool value) = 0;
+
+    // 每帧编辑结束后调用
+    virtual void commit() = 0;
+
+    virtual bool save(const char* path) = 0;
+    virtual bool load(const char* path) = 0;
+
+    // 地图内容的哈希，与存储方式无关
+    virtual ContentHash contentHash() = 0;
+
+    // 用程序生成的地形替换整张地图（见 TileGen.h），8邻接模式不支持，返回 false
+    virtual bool generate(const TerrainNoise& noise) = 0;
+
+    // 按规则（AUTOMATON_SMOOTH 等）对地形执行 steps 步元胞自动机并提交，8邻接模式不支持，返回 false
+    virtual bool simulate(int rule, int steps) = 0;
+
+    // 最近一次模拟每一步的耗时等，会先等编辑线程执行完已经提交的命令
+    virtual AutomatonStats automatonStats() = 0;
+
+    // 之后的编辑都交给编辑线程执行，析构时自动结束
+    bool startEditThread();
+    void stopEditThread();
+    bool editThreadRunning() const { return threaded; }
+
+    // 取得最新的地图快照并重绘缓存失效的地图块，每帧绘制前调用，必须在 Gfx_BeginScene() 之外调用
+    virtual void updateCache() = 0;
+    virtual void invalidateCache() = 0;
+
+    // 可见区域（屏幕坐标），默认是整个窗口，决定地图块重建的先后和绘制时的裁剪
+    void setViewport(int left, int top, int right, int bottom);
+
+    // 每帧上传重建好的地图块的时间（秒），至少上传一块
+    void setUploadBudget(double seconds) { uploadBudget = seconds; }
+
+    // 取出上次调用之后画面上变化了的区域（地图内容和高亮框），用于保留模式的绘制
+    void takeDamage(DirtyRegion& region)
+    {
+        region.add(damage);
+        damage.clear();
+    }
+
+    // 缩小显示，第 level 级缩小到 1/(1 << level)，地图左上角不动
+    // 缩小时每 (1 << level) * (1 << level) 个块预先缩小画到一张 LOD 图像上，每张图像画一个四边形
+    virtual void setZoom(int level) = 0;
+    int zoom() const { return zoomLevel; }
+
+    // 关闭块缓存时，整张地图直接从图集在一个批次里画出
+    void setChunkCache(bool enable) { useChunkCache = enable; }
+    bool chunkCache() const { return useChunkCache; }
+
+    virtual void drawMap() = 0;
+    // 网格、笔刷范围和高亮框，见 Overlay.h
+    virtual void drawOverlay() = 0;
+
+    // 把改动过的格子写进小地图，在 updateCache() 之后调用，返回更新的纹素数
+    virtual int updateMinimap() = 0;
+    void drawMinimap(float x1, float y1, float x2, float y2) { minimap.render(x1, y1, x2, y2); }
+
+    // 岛和湖的个数和大小，会先等编辑线程执行完已经提交的命令
+    virtual RegionStats regionStats() = 0;
+
+protected:
+    static HGE* hge;
+
+    // 有编辑线程时放进队列，否则直接执行
+    void submit(const EditCommand& command);
+
+    // 等待编辑线程执行完已经提交的命令，之后在调用线程中访问地图是安全的
+    void flush();
+
+    // 在拥有地图的线程中执行命令
+    virtual void execute(const EditCommand& command) = 0;
+
+    // 渲染目标只能在主线程中释放，其他线程释放地图块时先记下来
+    static void deferTargetFree(HTARGET target);
+    static void freeDeferredTargets();
+
+    // 像素矩形到可见区域的距离（像素），在可见区域内为 0；没有可见区域时返回 -1
+    int viewportDistance(int x1, int y1, int x2, int y2) const;
+
+    int originX, originY;   // 地图左上角坐标
+    bool useChunkCache;
+    int zoomLevel;
+
+    int viewportLeft, viewportTop, viewportRight, viewportBottom;
+    double uploadBudget;
+
+    DirtyRegion damage;     // 只在主线程中访问
+    Overlay overlay;
+    Minimap minimap;
+
+private:
+    TileEditor(const TileEditor&);
+    TileEditor& operator=(const TileEditor&);
+
+    static void editThreadMain(void* arg);
+
+    // 执行队列中的所有命令
+    void drain();
+
+    SpscQueue<EditCommand, EDIT_QUEUE_SIZE> commands;
+    Thread editThread;
+    Event wake;             // 有新命令或要求结束
+    Event drained;          // 队列已经清空
+    long submitted;         // 只由主线程修改
+    volatile long executed; // 只由编辑线程修改
+    volatile long stopping;
+    bool threaded;
+
+    static Mutex targetLock;
+    static std::vector<HTARGET> freedTargets;
+    static volatile long freedCount;
+};
+
+// 创建指定格式的编辑器，不支持的组合返回 0
+TileEditor* createTileEditor(int mode, int cellBits, int tileShift, int rows, int cols,
+                             const TileGraphics& graphics, int originX = 0, int originY = 0);
+
+// 按存档文件头中记录的格式创建空的编辑器，之后再调用 load()
+TileEditor* createTileEditorFor(const char* path, const TileGraphics& graphics, int originX = 0, int originY = 0);
+
+// 读入存档，按文件头中记录的格式创建编辑器，失败返回 0
+TileEditor* loadTileEditor(const char* path, const TileGraphics& graphics, int originX = 0, int originY = 0);
+
+template <typename Mode, int CELL_BITS, int TILE_SHIFT>
+class TileEditorT : public TileEditor
+{
+public:
+    typedef typename TileCell<CELL_BITS>::Type Cell;
+    typedef ChunkMap<Cell> Map;
+
+    // 某一时刻所有块的指针，持有每个块的一个引用
+    struct Snapshot
+    {
+        std::vector<typename Map::Chunk*> chunks;
+        long version;       // 发布的序号，内容没变时不会发布新的快照
+        Snapshot* next;     // 等待释放时串成链表
+    };
+
+    enum
+    {
+        TILE_SIZE = 1 << TILE_SHIFT,
+        CHUNK_PIXELS = TILE_SIZE << Map::CHUNK_BITS,
+        TAG = TILE_EDITOR_TAG(Mode::ID, CELL_BITS, TILE_SHIFT)
+    };
+
+    TileEditorT(int row, int col, const TileGraphics& gfx, int x, int y)
+        : TileEditor(x, y), map(row, col), regions(map), regionRow1(row), regionCol1(col), regionRow2(0), regionCol2(0),
+          automaton(&builders), cornersStale(true),
+          graphics(gfx), highlightRow(-1), highlightCol(-1),
+          view(0), published(0), retired(0), versions(0), commitsSubmitted(0), commitsExecuted(0), commitsAcquired(0),
+          lodRows(0), lodCols(0), builders(0, "chunk build")
+    {
+        map.chunkPool().setReleaseFunc(releaseChunk);
+        view = createSnapshot();
+
+        viewSummary.reset(row, col);
+        for (int cr = 0; cr < map.chunkRows(); ++cr)
+            for (int cc = 0; cc < map.chunkCols(); ++cc)
+                viewSummary.setLeaf(cr, cc, viewChunk(cr, cc));
+        viewSummary.rebuild();
+
+        regions.build(&builders);
+    }
+
+    virtual ~TileEditorT()
+    {
+        stopEditThread();
+
+        // 工作线程可能还在往 built 里放结果，先停下来
+        builders.stop();
+        for (size_t i = 0; i < built.size(); ++i)
+            delete built[i];
+        for (size_t i = 0; i < ready.size(); ++i)
+            delete ready[i];
+
+        freeLod();
+
+        // 编辑线程已经结束，所有快照都可以在这里释放
+        releaseSnapshot(view);
+        releaseSnapshot(static_cast<Snapshot*>(published));
+        releaseRetired();
+    }
+
+    virtual int mode() const { return Mode::ID; }
+    virtual int cellBits() const { return CELL_BITS; }
+    virtual int tileShift() const { return TILE_SHIFT; }
+    virtual int rows() const { return map.rows(); }
+    virtual int cols() const { return map.cols(); }
+
+    Map& tileMap() { return map; }
+
+    virtual void updateHighlight(float mx, float my)
+    {
+        // 屏幕上的一个像素对应地图上的 1 << zoomLevel 个像素
+        int row, col;
+        pickTile<Mode, TILE_SHIFT>((static_cast<int>(mx) - originX) * (1 << zoomLevel),
+            (static_cast<int>(my) - originY) * (1 << zoomLevel), map.rows(), map.cols(), row, col);
+
+        if (row != highlightRow || col != highlightCol)
+        {
+            addHighlightDamage();
+            highlightRow = row;
+            highlightCol = col;
+            addHighlightDamage();
+        }
+    }
+
+    virtual void stamp(bool value)
+    {
+        if (highlightRow != -1 && highlightCol != -1)
+        {
+            EditCommand command = { EDIT_STAMP, highlightRow, highlightCol, value };
+            submit(command);
+
+            // 等这次 stamp 所属的 commit 执行完再更新小地图
+            MinimapEdit edit;
+            edit.commit = commitsSubmitted + 1;
+            footprintTiles(edit.r1, edit.c1, edit.r2, edit.c2);
+            minimapEdits.push_back(edit);
+        }
+    }
+
+    virtual void commit()
+    {
+        EditCommand command = { EDIT_COMMIT, 0, 0, false };
+        submit(command);
+        ++commitsSubmitted;
+    }
+
+    virtual bool save(const char* path)
+    {
+        flush();
+        return map.save(path, TAG);
+    }
+
+    virtual bool load(const char* path)
+    {
+        TRACE_SCOPE("load map");
+
+        flush();
+        bool ok = map.load(path, TAG);
+        cornersStale = true;
+        publish();
+        regions.build(&builders);
+        minimap.invalidateAll();
+        return ok;
+    }
+
+    virtual ContentHash contentHash()
+    {
+        flush();
+        return map.contentHash();
+    }
+
+    virtual bool generate(const TerrainNoise& noise)
+    {
+        if (static_cast<int>(Mode::ID) == TILEMODE_BLOB)
+            return false;
+
+        TRACE_SCOPE("generate map");
+
+        flush();
+        generateTerrain(map, noise, &builders);
+        cornersStale = true;
+        publish();
+        regions.build(&builders);
+        minimap.invalidateAll();
+        return true;
+    }
+
+    virtual bool simulate(int rule, int steps)
+    {
+        if (static_cast<int>(Mode::ID) == TILEMODE_BLOB)
+            return false;
+
+        // 小地图要更新的范围由编辑线程在模拟之后记下
+        EditCommand command = { EDIT_SIMULATE, rule, steps, false };
+        submit(command);
+        commit();
+        return true;
+    }
+
+    virtual AutomatonStats automatonStats()
+    {
+        flush();
+        return automaton.stats();
+    }
+
+    virtual RegionStats regionStats()
+    {
+        flush();
+        return regions.stats();
+    }
+
+    virtual void invalidateCache()
+    {
+        map.chunkPool().invalidateCaches();
+
+        // LOD 图像的内容也丢失了
+        lodDirty.assign(lodDirty.size(), 1);
+        lodFilled.assign(lodFilled.size(), 0);
+    }
+
+    virtual void setZoom(int level)
+    {
+        // 元件至少要有一个像素
+        if (level < 0) level = 0;
+        if (level > LOD_LEVELS) level = LOD_LEVELS;
+        if (level > TILE_SHIFT) level = TILE_SHIFT;
+        if (level == zoomLevel)
+            return;
+
+        // 只保留当前级别的 LOD 图像
+        freeLod();
+        zoomLevel = level;
+        if (level == 0)
+            return;
+
+        lodRows = (map.chunkRows() + (1 << level) - 1) >> level;
+        lodCols = (map.chunkCols() + (1 << level) - 1) >> level;
+        lodTargets.assign(lodRows * lodCols, static_cast<HTARGET>(0));
+        lodFilled.assign(lodRows * lodCols, 0);
+        lodDirty.assign(map.chunkRows() * map.chunkCols(), 1);
+
+        graphics.tiles->createMipmaps();
+    }
+
+    // 内容相同的块共享同一个渲染目标，所以只需要绘制一次
+    virtual void updateCache()
+    {
+        acquireSnapshot();
+        freeDeferredTargets();
+
+        if (!useChunkCache)
+            return;
+
+        // 缩小时不需要原大小的缓存，回到原大小时再重建
+        if (zoomLevel > 0)
+        {
+            updateLod();
+            return;
+        }
+
+        typename Map::Pool& pool = map.chunkPool();
+        bool skipEmpty = blankIsEmpty();
+
+        // 找出缓存失效的块，还没有在转换的交给工作线程
+        stale.clear();
+        for (int cr = 0; cr < map.chunkRows(); ++cr)
+        {
+            for (int cc = 0; cc < map.chunkCols(); ++cc)
+            {
+                typename Map::Chunk* chunk = viewChunk(cr, cc);
+                if (pool.isCacheValid(chunk) || (skipEmpty && chunkEmpty(chunk)))
+                    continue;
+
+                stale[chunk->hash] = chunk;
+                if (building.insert(chunk->hash).second)
+                    submitBuild(chunk, cr, cc);
+            }
+        }
+
+        uploadBuilt();
+    }
+
+    virtual void drawMap()
+    {
+        // 整张地图都没有地形时什么都不用画
+        bool skipEmpty = blankIsEmpty();
+        if (skipEmpty && viewSummary.total().empty())
+            return;
+
+        if (zoomLevel > 0)
+        {
+            drawLod();
+            return;
+        }
+
+        // 先画有缓存的块，每块一个四边形
+        bool missing = false;
+        for (int cr = 0; cr < map.chunkRows(); ++cr)
+        {
+            for (int cc = 0; cc < map.chunkCols(); ++cc)
+            {
+                if (!chunkVisible(cr, cc))
+                    continue;
+
+                typename Map::Chunk* chunk = viewChunk(cr, cc);
+                if (skipEmpty && chunkEmpty(chunk))
+                    continue;
+
+                if (!useChunkCache || !map.chunkPool().isCacheValid(chunk))
+                {
+                    missing = true;
+                    continue;
+                }
+
+                int r0 = cr << Map::CHUNK_BITS;
+                int c0 = cc << Map::CHUNK_BITS;
+                drawTarget(static_cast<HTARGET>(chunk->renderCache), screenX(c0), screenY(r0),
+                    screenX(c0 + chunkColsAt(c0)), screenY(r0 + chunkRowsAt(r0)));
+            }
+        }
+
+        if (!missing)
+            return;
+
+        // 没有有效缓存的块（关闭了块缓存、还在重建或渲染目标创建失败）直接从图集画，所有块共用一个批次
+        QuadBatch batch(hge, graphics.tiles->texture());
+        for (int cr = 0; cr < map.chunkRows(); ++cr)
+        {
+            for (int cc = 0; cc < map.chunkCols(); ++cc)
+            {
+                if (!chunkVisible(cr, cc))
+                    continue;
+
+                typename Map::Chunk* chunk = viewChunk(cr, cc);
+                if ((useChunkCache && map.chunkPool().isCacheValid(chunk)) || (skipEmpty && chunkEmpty(chunk)))
+                    continue;
+
+                int r0 = cr << Map::CHUNK_BITS;
+                int c0 = cc << Map::CHUNK_BITS;
+                emitChunk(batch, chunk, chunkRowsAt(r0), chunkColsAt(c0),
+                    originX + (c0 << TILE_SHIFT), originY + (r0 << TILE_SHIFT));
+            }
+        }
+    }
+
+    virtual int updateMinimap()
+    {
+        if (!minimap.created() && !minimap.create(map.rows(), map.cols()))
+            return 0;
+
+        // 编辑线程模拟后记下的范围，和 stamp 的范围按所属的 commit 排在一起
+        {
+            ScopedLock lock(simulatedLock);
+            if (!simulatedEdits.empty())
+            {
+                minimapEdits.insert(minimapEdits.end(), simulatedEdits.begin(), simulatedEdits.end());
+                simulatedEdits.clear();
+                std::stable_sort(minimapEdits.begin(), minimapEdits.end(), MinimapEdit::before);
+            }
+        }
+
+        // commitsAcquired 之前的 commit 都已经反映在当前的快照里了
+        size_t n = 0;
+        for (; n < minimapEdits.size() && minimapEdits[n].commit <= commitsAcquired; ++n)
+        {
+            const MinimapEdit& edit = minimapEdits[n];
+            minimap.invalidate(edit.r1, edit.c1, edit.r2 + 1, edit.c2 + 1);
+        }
+        minimapEdits.erase(minimapEdits.begin(), minimapEdits.begin() + n);
+
+        return minimap.update(fillMinimap, this);
+    }
+
+    virtual void drawOverlay()
+    {
+        // 参数没变时不会重建网格，格子太小时不画
+        int cell = tilePixels();
+        if (cell >= GRID_MIN_CELL)
+            overlay.setGrid(originX, originY, map.rows(), map.cols(), cell, GRID_COLOR);
+        else
+            overlay.setGrid(originX, originY, 0, 0, 1, GRID_COLOR);
+
+        overlay.clearShapes();
+        if (highlightRow != -1 && highlightCol != -1)
+        {
+            int x1, y1, x2, y2;
+            footprintRect(x1, y1, x2, y2);
+            overlay.addOutline(static_cast<float>(x1), static_cast<float>(y1),
+                static_cast<float>(x2), static_cast<float>(y2), FOOTPRINT_COLOR);
+
+            if (graphics.highlight)
+            {
+                int x, y;
+                highlightOrigin(x, y);
+                overlay.addSprite(graphics.highlight, static_cast<float>(x), static_cast<float>(y),
+                    static_cast<float>(x + tilePixels()), static_cast<float>(y + tilePixels()));
+            }
+        }
+
+        if (viewportRight > viewportLeft && viewportBottom > viewportTop)
+            overlay.render(viewportLeft, viewportTop, viewportRight, viewportBottom);
+        else
+            overlay.render(originX, originY, screenX(map.cols()), screenY(map.rows()));
+    }
+
+protected:
+    virtual void execute(const EditCommand& command)
+    {
+        if (command.type == EDIT_STAMP)
+        {
+            TRACE_SCOPE_AT("stamp", command.row, command.col);
+            Mode::stamp(map, command.row, command.col, command.value);
+
+            // 这一帧改动的元件范围（不包含 regionRow2, regionCol2）
+            regionRow1 = std::min(regionRow1, command.row - Mode::FOOTPRINT_BEFORE);
+            regionCol1 = std::min(regionCol1, command.col - Mode::FOOTPRINT_BEFORE);
+            regionRow2 = std::max(regionRow2, command.row + Mode::FOOTPRINT_AFTER + 1);
+            regionCol2 = std::max(regionCol2, command.col + Mode::FOOTPRINT_AFTER + 1);
+            cornersStale = true;
+        }
+        else if (command.type == EDIT_SIMULATE)
+        {
+            simulateSteps(automatonRule(command.row), command.col);
+        }
+        else if (command.type == EDIT_COMMIT)
+        {
+            if (map.commit())
+            {
+                publish();
+                regions.update(regionRow1, regionCol1, regionRow2, regionCol2);
+            }
+            regionRow1 = map.rows();
+            regionCol1 = map.cols();
+            regionRow2 = regionCol2 = 0;
+
+            // 发布之后再计数，主线程读到这个数时对应的快照一定已经发布了
+            atomicAdd(&commitsExecuted, 1);
+            releaseRetired();
+        }
+    }
+
+private:
+    // 在拥有地图的线程中执行 steps 步，把变了的块写进地图，等下一个 commit 合并
+    void simulateSteps(const AutomatonRule& rule, int steps)
+    {
+        TRACE_SCOPE("simulate");
+
+        if (cornersStale)
+        {
+            automaton.load(map);
+            cornersStale = false;
+        }
+
+        for (int i = 0; i < steps; ++i)
+        {
+            if (automaton.step(rule) == 0)
+                break;
+        }
+
+        int r1, c1, r2, c2;
+        automaton.pendingBounds(r1, c1, r2, c2);
+        if (r1 < r2)
+        {
+            regionRow1 = std::min(regionRow1, r1);
+            regionCol1 = std::min(regionCol1, c1);
+            regionRow2 = std::max(regionRow2, r2);
+            regionCol2 = std::max(regionCol2, c2);
+
+            // 下一个执行的 commit 合并这些块之后主线程才更新小地图
+            MinimapEdit edit = { commitsExecuted + 1, r1, c1, r2 - 1, c2 - 1 };
+            ScopedLock lock(simulatedLock);
+            simulatedEdits.push_back(edit);
+        }
+        automaton.store(map);
+    }
+
+    // 以下在拥有地图的线程中调用：复制当前的块指针并持有引用
+    Snapshot* createSnapshot()
+    {
+        Snapshot* snapshot = new Snapshot;
+        snapshot->chunks.resize(map.chunkRows() * map.chunkCols());
+        snapshot->version = ++versions;
+        snapshot->next = 0;
+
+        for (int cr = 0; cr < map.chunkRows(); ++cr)
+        {
+            for (int cc = 0; cc < map.chunkCols(); ++cc)
+            {
+                typename Map::Chunk* chunk = map.chunkAt(cr, cc);
+                map.chunkPool().addRef(chunk);
+                snapshot->chunks[cr * map.chunkCols() + cc] = chunk;
+            }
+        }
+        return snapshot;
+    }
+
+    void releaseSnapshot(Snapshot* snapshot)
+    {
+        if (!snapshot)
+            return;
+
+        for (size_t i = 0; i < snapshot->chunks.size(); ++i)
+            map.chunkPool().release(snapshot->chunks[i]);
+        delete snapshot;
+    }
+
+    // 发布新的快照，主线程还没有取走的旧快照直接释放（换出来之后主线程已经拿不到它了）
+    void publish()
+    {
+        Snapshot* snapshot = createSnapshot();
+        releaseSnapshot(static_cast<Snapshot*>(atomicExchangePointer(&published, snapshot)));
+    }
+
+    // 释放主线程已经换下的快照
+    void releaseRetired()
+    {
+        Snapshot* list = static_cast<Snapshot*>(atomicExchangePointer(&retired, 0));
+        while (list)
+        {
+            Snapshot* next = list->next;
+            releaseSnapshot(list);
+            list = next;
+        }
+    }
+
+    // 主线程调用：换成最新发布的快照，旧的放进待释放的栈
+    // 只有入栈和整栈取走两种操作，不会出现 ABA 问题
+    void acquireSnapshot()
+    {
+        // 必须在取快照之前读
+        commitsAcquired = atomicLoad(&commitsExecuted);
+
+        Snapshot* snapshot = static_cast<Snapshot*>(atomicExchangePointer(&published, 0));
+        if (!snapshot)
+            return;
+
+        // 换了块的位置就是画面变化的区域，旧快照入栈之后就可能被释放，要在这之前比较
+        for (int cr = 0; cr < map.chunkRows(); ++cr)
+        {
+            for (int cc = 0; cc < map.chunkCols(); ++cc)
+            {
+                int i = cr * map.chunkCols() + cc;
+                if (snapshot->chunks[i] == view->chunks[i])
+                    continue;
+
+                viewSummary.set(cr, cc, snapshot->chunks[i]);
+
+                if (!lodDirty.empty())
+                    lodDirty[i] = 1;
+
+                int r0 = cr << Map::CHUNK_BITS, c0 = cc << Map::CHUNK_BITS;
+                damage.add(screenX(c0), screenY(r0), screenX(c0 + chunkColsAt(c0)), screenY(r0 + chunkRowsAt(r0)));
+            }
+        }
+
+        // 比较交换失败时返回的就是当前的栈顶，直接用它重试
+        void* head = 0;
+        for (;;)
+        {
+            view->next = static_cast<Snapshot*>(head);
+            void* seen = atomicCompareExchangePointer(&retired, view, head);
+            if (seen == head)
+                break;
+            head = seen;
+        }
+
+        view = snapshot;
+    }
+
+    typename Map::Chunk* viewChunk(int cr, int cc) const { return view->chunks[cr * map.chunkCols() + cc]; }
+
+    // 值为0的元件（没有地形）什么都不画时，没有地形的区域可以整块跳过
+    bool blankIsEmpty() const
+    {
+        const TileSet* tiles = graphics.tiles;
+        int blank = Mode::tileIndex(0);
+        return blank < tiles->count() && tiles->fill()[blank] == TILE_FILL_EMPTY;
+    }
+
+    // 还没有入池的块没有统计，当作有地形
+    static bool chunkEmpty(const typename Map::Chunk* chunk) { return chunk->shared && chunk->summary.empty(); }
+
+    // 第 col 列、第 row 行元件左边和上边的屏幕坐标
+    int screenX(int col) const { return originX + ((col << TILE_SHIFT) >> zoomLevel); }
+    int screenY(int row) const { return originY + ((row << TILE_SHIFT) >> zoomLevel); }
+
+    // 元件在屏幕上的大小
+    int tilePixels() const { return TILE_SIZE >> zoomLevel; }
+
+    // 高亮框左上角的屏幕坐标，选中顶点时高亮框要以顶点为中心
+    void highlightOrigin(int& x, int& y) const
+    {
+        x = screenX(highlightCol);
+        y = screenY(highlightRow);
+        if (Mode::PICK_VERTEX)
+        {
+            x -= tilePixels() / 2;
+            y -= tilePixels() / 2;
+        }
+    }
+
+    // 高亮位置 stamp() 会改动的元件，行 r0 ~ r1，列 c0 ~ c1（包含）
+    void footprintTiles(int& r0, int& c0, int& r1, int& c1) const
+    {
+        r0 = highlightRow - Mode::FOOTPRINT_BEFORE;
+        r1 = highlightRow + Mode::FOOTPRINT_AFTER;
+        c0 = highlightCol - Mode::FOOTPRINT_BEFORE;
+        c1 = highlightCol + Mode::FOOTPRINT_AFTER;
+        if (r0 < 0) r0 = 0;
+        if (c0 < 0) c0 = 0;
+        if (r1 > map.rows() - 1) r1 = map.rows() - 1;
+        if (c1 > map.cols() - 1) c1 = map.cols() - 1;
+    }
+
+    // footprintTiles() 的屏幕矩形，右下角的框线画在 x2, y2 上
+    void footprintRect(int& x1, int& y1, int& x2, int& y2) const
+    {
+        int r0, c0, r1, c1;
+        footprintTiles(r0, c0, r1, c1);
+
+        x1 = screenX(c0);
+        y1 = screenY(r0);
+        x2 = screenX(c1 + 1);
+        y2 = screenY(r1 + 1);
+    }
+
+    // 高亮框和笔刷范围所在的区域
+    void addHighlightDamage()
+    {
+        if (highlightRow == -1 || highlightCol == -1)
+            return;
+
+        int x, y;
+        highlightOrigin(x, y);
+        damage.add(x, y, x + tilePixels(), y + tilePixels());
+
+        int x1, y1, x2, y2;
+        footprintRect(x1, y1, x2, y2);
+        damage.add(x1, y1, x2 + 1, y2 + 1);
+    }
+
+    // 离可见区域越远的块优先级数值越大，单位是元件
+    int chunkPriority(int cr, int cc) const
+    {
+        int r0 = cr << Map::CHUNK_BITS, c0 = cc << Map::CHUNK_BITS;
+        int distance = viewportDistance(screenX(c0), screenY(r0),
+            screenX(c0 + Map::CHUNK_SIZE), screenY(r0 + Map::CHUNK_SIZE));
+        return distance < 0 ? 0 : (distance << zoomLevel) >> TILE_SHIFT;
+    }
+
+    bool chunkVisible(int cr, int cc) const
+    {
+        int r0 = cr << Map::CHUNK_BITS, c0 = cc << Map::CHUNK_BITS;
+        return viewportDistance(screenX(c0), screenY(r0),
+            screenX(c0 + Map::CHUNK_SIZE), screenY(r0 + Map::CHUNK_SIZE)) <= 0;
+    }
+
+    // 在工作线程中转换好的地图块，以块左上角为原点
+    struct BuiltChunk
+    {
+        ChunkHash hash;
+        typename Map::Chunk content;    // 只用到 cells，上传前用来确认块的内容没有变
+        int priority;
+        std::vector<float> quads;       // 每个四边形 x1, y1, x2, y2, u0, v0, u1, v1
+
+        // emitChunkTiles() 的批次接口
+        void add(float x1, float y1, float x2, float y2, float u0, float v0, float u1, float v1)
+        {
+            float q[8] = { x1, y1, x2, y2, u0, v0, u1, v1 };
+            quads.insert(quads.end(), q, q + 8);
+        }
+
+        static bool before(const BuiltChunk* a, const BuiltChunk* b) { return a->priority < b->priority; }
+    };
+
+    class BuildJob : public Job
+    {
+    public:
+        BuildJob(TileEditorT* e, BuiltChunk* b) : editor(e), result(b) {}
+        virtual ~BuildJob() { delete result; }
+
+        virtual void run()
+        {
+            editor->emitChunk(*result, &result->content, Map::CHUNK_SIZE, Map::CHUNK_SIZE, 0, 0);
+
+            ScopedLock lock(editor->builtLock);
+            editor->built.push_back(result);
+            result = 0;
+        }
+
+    private:
+        TileEditorT* editor;
+        BuiltChunk* result;
+    };
+
+    // 块的内容拷贝一份交给工作线程，块本身可能随时被编辑线程释放
+    void submitBuild(const typename Map::Chunk* chunk, int cr, int cc)
+    {
+        BuiltChunk* result = new BuiltChunk;
+        result->hash = chunk->hash;
+        memcpy(result->content.cells, chunk->cells, sizeof(chunk->cells));
+        result->priority = chunkPriority(cr, cc);
+
+        builders.submit(new BuildJob(this, result), result->priority);
+    }
+
+    // 按优先级把转换好的块画到渲染目标上，超出时间预算的留到下一帧
+    void uploadBuilt()
+    {
+        {
+            ScopedLock lock(builtLock);
+            ready.insert(ready.end(), built.begin(), built.end());
+            built.clear();
+        }
+
+        if (ready.empty())
+            return;
+
+        std::stable_sort(ready.begin(), ready.end(), BuiltChunk::before);
+
+        double start = getTicks();
+        size_t done = 0;
+        for (; done < ready.size(); ++done)
+        {
+            if (done > 0 && getTicks() - start >= uploadBudget)
+                break;
+
+            BuiltChunk* result = ready[done];
+            building.erase(result->hash);
+
+            // 转换期间块可能已经不在地图上了
+            typename std::map<ChunkHash, typename Map::Chunk*>::iterator it = stale.find(result->hash);
+            if (it != stale.end() && memcmp(it->second->cells, result->content.cells, sizeof(result->content.cells)) == 0)
+            {
+                uploadChunk(it->second, *result);
+                stale.erase(it);
+            }
+
+            delete result;
+        }
+
+        ready.erase(ready.begin(), ready.begin() + done);
+    }
+
+    void uploadChunk(typename Map::Chunk* chunk, const BuiltChunk& result)
+    {
+        TRACE_SCOPE("upload chunk");
+
+        if (!chunk->renderCache)
+        {
+            chunk->renderCache = hge->Target_Create(CHUNK_PIXELS, CHUNK_PIXELS, false);
+            if (!chunk->renderCache)
+                return;
+        }
+
+        hge->Gfx_BeginScene(static_cast<HTARGET>(chunk->renderCache));
+        hge->Gfx_Clear(0xFFFFFFFF);
+        {
+            QuadBatch batch(hge, graphics.tiles->texture());
+            for (size_t i = 0; i < result.quads.size(); i += 8)
+            {
+                const float* q = &result.quads[i];
+                batch.add(q[0], q[1], q[2], q[3], q[4], q[5], q[6], q[7]);
+            }
+        }
+        hge->Gfx_EndScene();
+
+        chunk->cacheGeneration = map.chunkPool().cacheGeneration();
+    }
+
+    // 把渲染目标左上角的一部分画到屏幕矩形上，不缩放
+    void drawTarget(HTARGET target, int x1, int y1, int x2, int y2) const
+    {
+        hgeQuad quad;
+        quad.tex = hge->Target_GetTexture(target);
+        quad.blend = BLEND_DEFAULT;
+
+        float tw = static_cast<float>(hge->Texture_GetWidth(quad.tex));
+        float th = static_cast<float>(hge->Texture_GetHeight(quad.tex));
+        float u = (x2 - x1) / tw, v = (y2 - y1) / th;
+
+        quad.v[0].x = static_cast<float>(x1); quad.v[0].y = static_cast<float>(y1); quad.v[0].tx = 0; quad.v[0].ty = 0;
+        quad.v[1].x = static_cast<float>(x2); quad.v[1].y = static_cast<float>(y1); quad.v[1].tx = u; quad.v[1].ty = 0;
+        quad.v[2].x = static_cast<float>(x2); quad.v[2].y = static_cast<float>(y2); quad.v[2].tx = u; quad.v[2].ty = v;
+        quad.v[3].x = static_cast<float>(x1); quad.v[3].y = static_cast<float>(y2); quad.v[3].tx = 0; quad.v[3].ty = v;
+
+        for (int i = 0; i < 4; ++i)
+        {
+            quad.v[i].z = 0.5f;
+            quad.v[i].col = 0xFFFFFFFF;
+        }
+
+        hge->Gfx_RenderQuad(&quad);
+    }
+
+    // 第 lr 行、第 lc 列的 LOD 图像覆盖从第 (lr << zoomLevel) 行、第 (lc << zoomLevel) 列开始的块
+    void lodRect(int lr, int lc, int& x1, int& y1, int& x2, int& y2) const
+    {
+        x1 = originX + lc * CHUNK_PIXELS;
+        y1 = originY + lr * CHUNK_PIXELS;
+        x2 = x1 + CHUNK_PIXELS;
+        y2 = y1 + CHUNK_PIXELS;
+
+        // 地图边缘的图像只有一部分在地图内
+        if (x2 > screenX(map.cols())) x2 = screenX(map.cols());
+        if (y2 > screenY(map.rows())) y2 = screenY(map.rows());
+    }
+
+    bool lodVisible(int lr, int lc) const
+    {
+        int x1, y1, x2, y2;
+        lodRect(lr, lc, x1, y1, x2, y2);
+        return viewportDistance(x1, y1, x2, y2) <= 0;
+    }
+
+    // LOD 图像覆盖的块正好是统计金字塔第 zoomLevel 级的一个节点
+    bool lodEmpty(int lr, int lc) const { return viewSummary.node(zoomLevel, lr, lc).empty(); }
+
+    // 把内容变了的块重画到可见的 LOD 图像上，只清除和重画这些块所在的区域，超出时间预算的留到下一帧
+    void updateLod()
+    {
+        int span = 1 << zoomLevel;
+        int chunkPixels = CHUNK_PIXELS >> zoomLevel;    // 一个块在 LOD 图像上的大小
+
+        double start = getTicks();
+        bool drawn = false;
+        bool skipEmpty = blankIsEmpty();
+        std::vector<int> dirty;
+
+        for (int lr = 0; lr < lodRows; ++lr)
+        {
+            for (int lc = 0; lc < lodCols; ++lc)
+            {
+                // 没有地形的图像不会被画出来，块的修改留到有地形时再重画
+                if (!lodVisible(lr, lc) || (skipEmpty && lodEmpty(lr, lc)))
+                    continue;
+
+                int cr0 = lr << zoomLevel, cc0 = lc << zoomLevel;
+                int cr1 = cr0 + span < map.chunkRows() ? cr0 + span : map.chunkRows();
+                int cc1 = cc0 + span < map.chunkCols() ? cc0 + span : map.chunkCols();
+
+                dirty.clear();
+                for (int cr = cr0; cr < cr1; ++cr)
+                {
+                    for (int cc = cc0; cc < cc1; ++cc)
+                    {
+                        if (lodDirty[cr * map.chunkCols() + cc])
+                            dirty.push_back(cr * map.chunkCols() + cc);
+                    }
+                }
+
+                if (dirty.empty())
+                    continue;
+                if (drawn && getTicks() - start >= uploadBudget)
+                    return;
+
+                int cell = lr * lodCols + lc;
+                if (!lodTargets[cell])
+                {
+                    lodTargets[cell] = hge->Target_Create(CHUNK_PIXELS, CHUNK_PIXELS, false);
+                    if (!lodTargets[cell])
+                        continue;
+                }
+
+                TRACE_SCOPE_AT("update lod", lr, lc);
+
+                size_t done = 0;
+                hge->Gfx_BeginScene(lodTargets[cell]);
+                for (; done < dirty.size(); ++done)
+                {
+                    if (drawn && getTicks() - start >= uploadBudget)
+                        break;
+
+                    int cr = dirty[done] / map.chunkCols(), cc = dirty[done] % map.chunkCols();
+                    int r0 = cr << Map::CHUNK_BITS, c0 = cc << Map::CHUNK_BITS;
+                    int x = (cc - cc0) * chunkPixels, y = (cr - cr0) * chunkPixels;
+
+                    // 裁剪区域同时限制 Gfx_Clear 的范围
+                    hge->Gfx_SetClipping(x, y, chunkPixels, chunkPixels);
+                    hge->Gfx_Clear(0xFFFFFFFF);
+                    {
+                        QuadBatch batch(hge, graphics.tiles->mipTexture());
+                        ScaledBatch<QuadBatch> scaled = { batch, zoomLevel, static_cast<float>(x), static_cast<float>(y) };
+                        emitChunk(scaled, viewChunk(cr, cc), chunkRowsAt(r0), chunkColsAt(c0), 0, 0);
+                    }
+
+                    lodDirty[dirty[done]] = 0;
+                    drawn = true;
+
+                    damage.add(screenX(c0), screenY(r0), screenX(c0 + chunkColsAt(c0)), screenY(r0 + chunkRowsAt(r0)));
+                }
+                hge->Gfx_SetClipping();
+                hge->Gfx_EndScene();
+
+                // 图像上的每个块都画过之后才能直接画这张图像
+                if (done == dirty.size())
+                    lodFilled[cell] = 1;
+            }
+        }
+    }
+
+    void drawLod()
+    {
+        bool skipEmpty = blankIsEmpty();
+        bool missing = false;
+        for (int lr = 0; lr < lodRows; ++lr)
+        {
+            for (int lc = 0; lc < lodCols; ++lc)
+            {
+                int cell = lr * lodCols + lc;
+                if (!lodVisible(lr, lc) || (skipEmpty && lodEmpty(lr, lc)))
+                    continue;
+
+                if (!useChunkCache || !lodTargets[cell] || !lodFilled[cell])
+                {
+                    missing = true;
+                    continue;
+                }
+
+                int x1, y1, x2, y2;
+                lodRect(lr, lc, x1, y1, x2, y2);
+                drawTarget(lodTargets[cell], x1, y1, x2, y2);
+            }
+        }
+
+        if (!missing)
+            return;
+
+        // 还没有画好的图像直接从带 mipmap 的元件纹理缩小绘制
+        QuadBatch batch(hge, graphics.tiles->mipTexture());
+        for (int cr = 0; cr < map.chunkRows(); ++cr)
+        {
+            for (int cc = 0; cc < map.chunkCols(); ++cc)
+            {
+                int cell = (cr >> zoomLevel) * lodCols + (cc >> zoomLevel);
+                if (!chunkVisible(cr, cc) || (useChunkCache && lodTargets[cell] && lodFilled[cell]))
+                    continue;
+                if (skipEmpty && chunkEmpty(viewChunk(cr, cc)))
+                    continue;
+
+                int r0 = cr << Map::CHUNK_BITS;
+                int c0 = cc << Map::CHUNK_BITS;
+                ScaledBatch<QuadBatch> scaled = { batch, zoomLevel,
+                    static_cast<float>(screenX(c0)), static_cast<float>(screenY(r0)) };
+                emitChunk(scaled, viewChunk(cr, cc), chunkRowsAt(r0), chunkColsAt(c0), 0, 0);
+            }
+        }
+    }
+
+    void freeLod()
+    {
+        for (size_t i = 0; i < lodTargets.size(); ++i)
+        {
+            if (lodTargets[i])
+                hge->Target_Free(lodTargets[i]);
+        }
+
+        lodTargets.clear();
+        lodFilled.clear();
+        lodDirty.clear();
+        lodRows = lodCols = 0;
+    }
+
+    // 小地图的纹素按当前快照中格子的元件颜色填充，一个纹素对应多个格子时取平均
+    static void fillMinimap(void* context, const DirtyRect& rect, DWORD* pixels, int pitch)
+    {
+        static_cast<TileEditorT*>(context)->fillMinimapRect(rect, pixels, pitch);
+    }
+
+    void fillMinimapRect(const DirtyRect& rect, DWORD* pixels, int pitch) const
+    {
+        int shift = minimap.shift();
+
+        // 区域内只有一种元件时（例如没有地形的大片区域）不用逐格读
+        typename Map::Summaries::Summary summary = viewSummary.query(rect.y1 << shift, rect.x1 << shift,
+            rect.y2 << shift, rect.x2 << shift);
+        if (summary.isUniform())
+        {
+            DWORD color = cellColor(summary.minValue);
+            for (int y = rect.y1; y < rect.y2; ++y)
+                for (int x = rect.x1; x < rect.x2; ++x)
+                    pixels[(y - rect.y1) * pitch + x - rect.x1] = color;
+            return;
+        }
+
+        for (int y = rect.y1; y < rect.y2; ++y)
+        {
+            DWORD* row = pixels + (y - rect.y1) * pitch;
+            for (int x = rect.x1; x < rect.x2; ++x)
+            {
+                if (shift == 0)
+                {
+                    row[x - rect.x1] = tileColor(y, x);
+                    continue;
+                }
+
+                int r0 = y << shift, c0 = x << shift;
+                int r1 = r0 + (1 << shift) < map.rows() ? r0 + (1 << shift) : map.rows();
+                int c1 = c0 + (1 << shift) < map.cols() ? c0 + (1 << shift) : map.cols();
+
+                unsigned long sum[4] = { 0, 0, 0, 0 };
+                for (int r = r0; r < r1; ++r)
+                {
+                    for (int c = c0; c < c1; ++c)
+                    {
+                        DWORD color = tileColor(r, c);
+                        for (int k = 0; k < 4; ++k)
+                            sum[k] += (color >> (k * 8)) & 0xFF;
+                    }
+                }
+
+                unsigned long n = static_cast<unsigned long>(r1 - r0) * (c1 - c0);
+                DWORD color = 0;
+                for (int k = 0; k < 4; ++k)
+                    color |= static_cast<DWORD>(sum[k] / n) << (k * 8);
+                row[x - rect.x1] = color;
+            }
+        }
+    }
+
+    DWORD tileColor(int r, int c) const
+    {
+        const typename Map::Chunk* chunk = viewChunk(r >> Map::CHUNK_BITS, c >> Map::CHUNK_BITS);
+        return cellColor(chunk->get(r & Map::CHUNK_MASK, c & Map::CHUNK_MASK));
+    }
+
+    DWORD cellColor(Cell value) const
+    {
+        int tile = Mode::tileIndex(value);
+        return tile < graphics.tiles->count() ? graphics.tiles->color()[tile] : 0xFFFFFFFF;
+    }
+
+    // 地图边缘的块可能只有一部分在地图内
+    int chunkRowsAt(int r0) const { return map.rows() - r0 < Map::CHUNK_SIZE ? map.rows() - r0 : Map::CHUNK_SIZE; }
+    int chunkColsAt(int c0) const { return map.cols() - c0 < Map::CHUNK_SIZE ? map.cols() - c0 : Map::CHUNK_SIZE; }
+
+    // 把块左上角 rows*cols 个元件加入批次，UV直接查元件集的表
+    template <typename Batch>
+    void emitChunk(Batch& batch, const typename Map::Chunk* chunk, int rows, int cols, int x0, int y0) const
+    {
+        const TileSet* tiles = graphics.tiles;
+        TileUVs uv = { tiles->u0(), tiles->v0(), tiles->u1(), tiles->v1(), tiles->count(), tiles->fill() };
+
+        emitChunkTiles<Mode, TILE_SHIFT>(batch, chunk, rows, cols, x0, y0, uv);
+    }
+
+    // 释放挂在地图块上的渲染目标，块可能在编辑线程中释放
+    static void releaseChunk(typename Map::Chunk* chunk)
+    {
+        deferTargetFree(static_cast<HTARGET>(chunk->renderCache));
+    }
+
+    Map map;                // 有编辑线程时只在编辑线程中访问块的内容和引用计数
+
+    // 地形区域和这一帧 stamp 过的范围，与地图一样只在拥有地图的线程中访问
+    RegionLabels<Map, Mode::REGION_SITE_BIT> regions;
+    int regionRow1, regionCol1, regionRow2, regionCol2;
+
+    // 元胞自动机，只在拥有地图的线程中访问；地图被 stamp、读入或生成之后顶点网格要重新读
+    // 并行的部分和地图块的重建一样提交给 builders，编辑线程和主线程可以同时提交
+    TerrainAutomaton automaton;
+    bool cornersStale;
+
+    TileGraphics graphics;
+
+    // 高亮位置，只在主线程中访问
+    int highlightRow, highlightCol;
+
+    // 主线程绘制用的快照，块的渲染缓存只由主线程读写
+    Snapshot* view;
+    typename Map::Summaries viewSummary;    // view 的区域统计，取快照时只更新换了的块
+
+    // 在两个线程之间传递快照
+    void* volatile published;   // 最新发布、主线程还没有取走的快照
+    void* volatile retired;     // 主线程换下、等待编辑线程释放的快照
+    long versions;              // 只在拥有地图的线程中修改
+
+    // 等待写进小地图的 stamp 范围，commit 是它所属的 commit 的序号（从1开始）
+    struct MinimapEdit
+    {
+        long commit;
+        int r1, c1, r2, c2;     // 包含
+
+        static bool before(const MinimapEdit& a, const MinimapEdit& b) { return a.commit < b.commit; }
+    };
+    std::vector<MinimapEdit> minimapEdits;  // 只在主线程中访问
+    Mutex simulatedLock;
+    std::vector<MinimapEdit> simulatedEdits;    // 编辑线程模拟后变了的范围，主线程在 updateMinimap() 中取走
+    long commitsSubmitted;                  // 只在主线程中访问
+    volatile long commitsExecuted;          // 只在拥有地图的线程中修改
+    long commitsAcquired;                   // 取当前快照之前读到的 commitsExecuted
+
+    // 当前缩放级别的 LOD 图像，只在主线程中访问
+    int lodRows, lodCols;
+    std::vector<HTARGET> lodTargets;
+    std::vector<unsigned char> lodFilled;   // 每张图像，所有块都已经画过一次
+    std::vector<unsigned char> lodDirty;    // 每个块，内容变了还没有重画到 LOD 图像上
+
+    // 地图块的重建，building / ready / stale 只在主线程中访问
+    std::set<ChunkHash> building;                       // 已经提交、还没有上传的块
+    std::vector<BuiltChunk*> ready;                     // 转换好、等待上传的块
+    std::map<ChunkHash, typename Map::Chunk*> stale;    // 本帧缓存失效的块
+    Mutex builtLock;
+    std::vector<BuiltChunk*> built;                     // 工作线程转换好的块
+
+    // 放在最后，析构时最先停下
+    JobScheduler builders;
+};
+
+#endif
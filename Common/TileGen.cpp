@@ -0,0 +1,170 @@
+/*
+** 程序生成地形
+**
+** author : gouki04 2011-12-30
+*/
+
+#include "TileGen.h"
+
+#include <algorithm>
+
+#if defined(_MSC_VER) || defined(__SSE__)
+#include <xmmintrin.h>
+#define TILEGEN_SSE 1
+#endif
+
+namespace
+{
+    // 一层噪声
+    struct Octave
+    {
+        int wavelength;
+        unsigned int seed;
+        float amplitude;
+        std::vector<float> weights;     // 波长内每个位置的平滑插值权重 t*t*(3 - 2*t)
+    };
+
+    struct NoiseArg
+    {
+        CornerGrid* grid;
+        std::vector<Octave> octaves;
+        float threshold;
+    };
+
+    // 格点 (x, y) 上的随机值，0 ~ 1
+    inline float latticeValue(unsigned int seed, int x, int y)
+    {
+        unsigned int h = seed ^ (static_cast<unsigned int>(x) * 0x27D4EB2Du) ^ (static_cast<unsigned int>(y) * 0x165667B1u);
+        h ^= h >> 15;
+        h *= 0x85EBCA6Bu;
+        h ^= h >> 13;
+        h *= 0xC2B2AE35u;
+        h ^= h >> 16;
+        return static_cast<float>(h >> 8) * (1.0f / 16777216.0f);
+    }
+
+    // 顶点网格第 begin ~ end 行
+    void noiseRows(int begin, int end, void* p)
+    {
+        NoiseArg& arg = *static_cast<NoiseArg*>(p);
+        CornerGrid& grid = *arg.grid;
+
+        // 一行按4个一组计算，多出来的几个顶点算了也不用
+        int cols = grid.cols();
+        int padded = (cols + 3) & ~3;
+        std::vector<float> sum(padded);
+
+        // 每层当前格点行上下两行的值，格点行变了才重算
+        size_t count = arg.octaves.size();
+        std::vector<std::vector<float> > upper(count), lower(count), blend(count);
+        std::vector<int> latticeRow(count, -1);
+        for (size_t o = 0; o < count; ++o)
+        {
+            int lattice = padded / arg.octaves[o].wavelength + 2;
+            upper[o].resize(lattice);
+            lower[o].resize(lattice);
+            blend[o].resize(lattice);
+        }
+
+        for (int y = begin; y < end; ++y)
+        {
+            std::fill(sum.begin(), sum.end(), 0.0f);
+
+            for (size_t o = 0; o < count; ++o)
+            {
+                const Octave& octave = arg.octaves[o];
+                int L = octave.wavelength;
+                int iy = y / L;
+                if (iy != latticeRow[o])
+                {
+                    latticeRow[o] = iy;
+                    for (size_t i = 0; i < upper[o].size(); ++i)
+                    {
+                        upper[o][i] = latticeValue(octave.seed, static_cast<int>(i), iy) * octave.amplitude;
+                        lower[o][i] = latticeValue(octave.seed, static_cast<int>(i), iy + 1) * octave.amplitude;
+                    }
+                }
+
+                // 先在格点列上按行插值，一个波长内的顶点再在左右两个格点列之间插值
+                float sy = octave.weights[y % L];
+                for (size_t i = 0; i < blend[o].size(); ++i)
+                    blend[o][i] = upper[o][i] + (lower[o][i] - upper[o][i]) * sy;
+
+                const float* w = &octave.weights[0];
+                for (int x0 = 0, i = 0; x0 < padded; x0 += L, ++i)
+                {
+                    float a = blend[o][i], d = blend[o][i + 1] - a;
+                    int n = padded - x0 < L ? padded - x0 : L;
+                    float* out = &sum[x0];
+#ifdef TILEGEN_SSE
+                    __m128 va = _mm_set1_ps(a), vd = _mm_set1_ps(d);
+                    for (int k = 0; k < n; k += 4)
+                    {
+                        __m128 v = _mm_add_ps(va, _mm_mul_ps(vd, _mm_loadu_ps(w + k)));
+                        _mm_storeu_ps(out + k, _mm_add_ps(_mm_loadu_ps(out + k), v));
+                    }
+#else
+                    for (int k = 0; k < n; ++k)
+                        out[k] += a + d * w[k];
+#endif
+                }
+            }
+
+            // 不小于阈值的顶点是地形，每次取出4个顶点的比较结果
+            unsigned int* row = grid.row(y);
+            for (int i = 0; i < grid.wordsPerRow(); ++i)
+                row[i] = 0;
+#ifdef TILEGEN_SSE
+            __m128 threshold = _mm_set1_ps(arg.threshold);
+            for (int x = 0; x < padded; x += 4)
+            {
+                unsigned int bits = static_cast<unsigned int>(_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(&sum[x]), threshold)));
+                row[x >> 5] |= bits << (x & 31);
+            }
+#else
+            for (int x = 0; x < padded; ++x)
+            {
+                if (sum[x] >= arg.threshold)
+                    row[x >> 5] |= 1u << (x & 31);
+            }
+#endif
+            if (cols & 31)
+                row[grid.wordsPerRow() - 1] &= (1u << (cols & 31)) - 1;
+        }
+    }
+}
+
+void generateCorners(CornerGrid& grid, const TerrainNoise& noise, JobScheduler* jobs)
+{
+    NoiseArg arg;
+    arg.grid = &grid;
+    arg.threshold = noise.threshold;
+
+    int wavelength = 4;
+    while (wavelength * 2 <= noise.wavelength)
+        wavelength *= 2;
+
+    float amplitude = 1.0f, total = 0.0f;
+    for (int o = 0; o < noise.octaves && wavelength >= 4; ++o, wavelength >>= 1)
+    {
+        Octave octave;
+        octave.wavelength = wavelength;
+        octave.seed = noise.seed + static_cast<unsigned int>(o) * 0x9E3779B9u;
+        octave.amplitude = amplitude;
+        for (int k = 0; k < wavelength; ++k)
+        {
+            float t = static_cast<float>(k) / wavelength;
+            octave.weights.push_back(t * t * (3.0f - 2.0f * t));
+        }
+        arg.octaves.push_back(octave);
+
+        total += amplitude;
+        amplitude *= noise.persistence;
+    }
+
+    // 振幅归一化，叠加后仍在 0 ~ 1 之间
+    for (size_t o = 0; o < arg.octaves.size(); ++o)
+        arg.octaves[o].amplitude /= total;
+
+    parallelFor(jobs, grid.rows(), noiseRows, &arg);
+}
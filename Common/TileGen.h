@@ -0,0 +1,218 @@
+/*
+** 程序生成地形
+** 用带种子的分形值噪声（几层波长逐层减半的格点值噪声叠加）填满顶点网格，噪声值不小于阈值的顶点是地形，
+** 再按块从顶点网格计算元件掩码。
+**
+** 顶点网格按行分段，每段交给一个工作线程，一行里的顶点四个一组用 SSE 计算；
+** 块的掩码按块行分段并行计算，整块都是空白或都是地形的块直接共用池中的同一个块，其余的块在调用线程中入池。
+** 每个顶点的值只取决于参数和它的坐标，计算顺序也固定，所以同样的参数在任何线程数下得到同样的地图。
+**
+** 只适用于4位掩码的地图（简单模式和魔兽模式）
+**
+** author : gouki04 2011-12-30
+*/
+
+#ifndef TILEGEN_H
+#define TILEGEN_H
+
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "JobScheduler.h"
+#include "TileOps.h"
+
+struct TerrainNoise
+{
+    unsigned int seed;
+    int wavelength;     // 第一层的波长（顶点），取不大于它的2的幂，至少为4
+    int octaves;        // 层数，每层波长减半，波长小于4的层不算
+    float persistence;  // 每层的振幅是上一层的几倍
+    float threshold;    // 0 ~ 1，叠加后的噪声也在 0 ~ 1 之间
+
+    TerrainNoise(unsigned int s = 1)
+        : seed(s), wavelength(256), octaves(6), persistence(0.5f), threshold(0.5f)
+    {
+    }
+};
+
+namespace gen_detail
+{
+    // 顶点网格第 r 行从第 c 列开始的 width 个顶点，低位是第 c 列（块边长不超过32时一定放得下）
+    inline unsigned long long cornerBits(const CornerGrid& grid, int r, int c, int width)
+    {
+        const unsigned int* row = grid.row(r);
+        int w = c >> 5;
+        unsigned long long bits = row[w];
+        if (w + 1 < grid.wordsPerRow())
+            bits |= static_cast<unsigned long long>(row[w + 1]) << 32;
+        return (bits >> (c & 31)) & ((1ull << width) - 1);
+    }
+
+    template <typename Map>
+    struct RetileBatch
+    {
+        typedef typename Map::Chunk Chunk;
+        typedef typename Map::ValueType T;
+
+        enum { EMPTY, FULL, MIXED };
+
+        const CornerGrid* grid;
+        int rows, cols;             // 地图大小
+        int chunkCols;
+        std::vector<int> chunks;    // 这一批的块（cr * chunkCols + cc）
+        std::vector<unsigned char> kinds;   // 每个块是 EMPTY、FULL 还是 MIXED
+        std::vector<T> cells;       // MIXED 块的内容，每个块 Chunk::CELLS 个格子，按块内排列
+
+        RetileBatch(const Map& map, const CornerGrid& g, int size)
+            : grid(&g), rows(map.rows()), cols(map.cols()), chunkCols(map.chunkCols()),
+              kinds(size), cells(size * Chunk::CELLS)
+        {
+            chunks.reserve(size);
+        }
+    };
+
+    // 计算一批中的第 begin ~ end 个块
+    template <typename Map>
+    void retileRange(int begin, int end, void* arg)
+    {
+        typedef typename Map::Chunk Chunk;
+        typedef typename Map::ValueType T;
+        RetileBatch<Map>& batch = *static_cast<RetileBatch<Map>*>(arg);
+        const CornerGrid& grid = *batch.grid;
+
+        for (int k = begin; k < end; ++k)
+        {
+            int r0 = (batch.chunks[k] / batch.chunkCols) << Map::CHUNK_BITS;
+            int c0 = (batch.chunks[k] % batch.chunkCols) << Map::CHUNK_BITS;
+            int rows = batch.rows - r0 < Map::CHUNK_SIZE ? batch.rows - r0 : Map::CHUNK_SIZE;
+            int cols = batch.cols - c0 < Map::CHUNK_SIZE ? batch.cols - c0 : Map::CHUNK_SIZE;
+
+            // 先按顶点判断是不是整块空白或整块地形，不满一块的块超出地图的部分是0，不算整块地形
+            unsigned long long all = (1ull << (cols + 1)) - 1, any = 0, every = all;
+            for (int r = 0; r <= rows; ++r)
+            {
+                unsigned long long bits = cornerBits(grid, r0 + r, c0, cols + 1);
+                any |= bits;
+                every &= bits;
+            }
+
+            bool full = rows == Map::CHUNK_SIZE && cols == Map::CHUNK_SIZE;
+            if (!any || (every == all && full))
+            {
+                batch.kinds[k] = any ? RetileBatch<Map>::FULL : RetileBatch<Map>::EMPTY;
+                continue;
+            }
+
+            batch.kinds[k] = RetileBatch<Map>::MIXED;
+            T* out = &batch.cells[k * Chunk::CELLS];
+            memset(out, 0, Chunk::CELLS * sizeof(T));
+
+            unsigned long long top = cornerBits(grid, r0, c0, cols + 1);
+            for (int r = 0; r < rows; ++r)
+            {
+                unsigned long long bottom = cornerBits(grid, r0 + r + 1, c0, cols + 1);
+                for (int c = 0; c < cols; ++c)
+                {
+                    int mask = static_cast<int>(((top >> c) & 3) | (((bottom >> c) & 3) << 2));
+                    out[Map::CellLayout::index(r, c)] = static_cast<T>(mask);
+                }
+                top = bottom;
+            }
+        }
+    }
+}
+
+// 按 noise 填满顶点网格，jobs 不为0时在工作线程中并行计算
+void generateCorners(CornerGrid& grid, const TerrainNoise& noise, JobScheduler* jobs = 0);
+
+// 从顶点网格重算整张地图的掩码，结果与 retile() 相同，直接替换地图上的块，不需要再 commit()
+template <typename Map>
+void retileChunks(Map& map, const CornerGrid& grid, JobScheduler* jobs = 0)
+{
+    typedef typename Map::Chunk Chunk;
+    typedef typename Map::ValueType T;
+    typedef gen_detail::RetileBatch<Map> Batch;
+    typename Map::Pool& pool = map.chunkPool();
+
+    Chunk* empty = pool.intern(pool.create(0));
+    Chunk* full = pool.intern(pool.create(0, static_cast<T>(0xF)));
+
+    // 每批若干行块，一批算完之后在调用线程中入池
+    int batchRows = jobs ? jobs->workerCount() * 4 : 4;
+    Batch batch(map, grid, batchRows * map.chunkCols());
+
+    for (int first = 0; first < map.chunkRows(); first += batchRows)
+    {
+        int last = first + batchRows < map.chunkRows() ? first + batchRows : map.chunkRows();
+        batch.chunks.clear();
+        for (int k = first * map.chunkCols(); k < last * map.chunkCols(); ++k)
+            batch.chunks.push_back(k);
+
+        int count = static_cast<int>(batch.chunks.size());
+        parallelFor(jobs, count, gen_detail::retileRange<Map>, &batch);
+
+        for (int i = 0; i < count; ++i)
+        {
+            int cr = batch.chunks[i] / map.chunkCols(), cc = batch.chunks[i] % map.chunkCols();
+            if (batch.kinds[i] != Batch::MIXED)
+            {
+                map.replaceChunk(cr, cc, batch.kinds[i] == Batch::FULL ? full : empty);
+                continue;
+            }
+
+            Chunk* chunk = pool.create(0);
+            memcpy(chunk->cells, &batch.cells[i * Chunk::CELLS], sizeof(chunk->cells));
+            chunk = pool.intern(chunk);
+            map.replaceChunk(cr, cc, chunk);
+            pool.release(chunk);
+        }
+    }
+
+    pool.release(empty);
+    pool.release(full);
+    map.rebuildSummaries();
+}
+
+// 只重算 chunks 中的块（cr * chunkCols() + cc），和编辑一样写进私有块，之后要 commit()
+template <typename Map>
+void retileChunks(Map& map, const CornerGrid& grid, const std::vector<int>& chunks, JobScheduler* jobs = 0)
+{
+    typedef typename Map::Chunk Chunk;
+    typedef typename Map::ValueType T;
+    typedef gen_detail::RetileBatch<Map> Batch;
+
+    int batchSize = (jobs ? jobs->workerCount() * 4 : 4) * map.chunkCols();
+    if (batchSize > static_cast<int>(chunks.size()))
+        batchSize = static_cast<int>(chunks.size());
+    Batch batch(map, grid, batchSize);
+
+    for (size_t first = 0; first < chunks.size(); first += batchSize)
+    {
+        size_t last = first + batchSize < chunks.size() ? first + batchSize : chunks.size();
+        batch.chunks.assign(chunks.begin() + first, chunks.begin() + last);
+
+        int count = static_cast<int>(batch.chunks.size());
+        parallelFor(jobs, count, gen_detail::retileRange<Map>, &batch);
+
+        for (int i = 0; i < count; ++i)
+        {
+            Chunk* chunk = map.writableChunk(batch.chunks[i] / map.chunkCols(), batch.chunks[i] % map.chunkCols());
+            if (batch.kinds[i] == Batch::MIXED)
+                memcpy(chunk->cells, &batch.cells[i * Chunk::CELLS], sizeof(chunk->cells));
+            else
+                std::fill(chunk->cells, chunk->cells + Chunk::CELLS, static_cast<T>(batch.kinds[i] == Batch::FULL ? 0xF : 0));
+        }
+    }
+}
+
+// 生成整张地图：填满顶点网格，再重算掩码
+template <typename Map>
+void generateTerrain(Map& map, const TerrainNoise& noise, JobScheduler* jobs = 0)
+{
+    CornerGrid grid(map.rows() + 1, map.cols() + 1);
+    generateCorners(grid, noise, jobs);
+    retileChunks(map, grid, jobs);
+}
+
+#endif
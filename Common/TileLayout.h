@@ -0,0 +1,52 @@
+/*
+** 地图块内部的格子排列方式
+** RowMajorLayout : 按行排列，同一行相邻的格子在内存中相邻
+** MortonLayout   : Z序（Morton序）排列，二维上相邻的格子在内存中也尽量相邻
+**
+** 两种排列都通过 index(r, c) 把块内坐标换算成下标，ChunkMap 只通过它访问格子；
+** ID 写进存档的文件头，读入时排列方式不同的存档会被拒绝
+**
+** author : gouki04 2011-12-30
+*/
+
+#ifndef TILELAYOUT_H
+#define TILELAYOUT_H
+
+template <int BITS>
+struct RowMajorLayout
+{
+    enum { ID = 1 };    // 与以前按 index(0, 1) 记录的存档兼容
+
+    static int index(int r, int c)
+    {
+        return (r << BITS) | c;
+    }
+
+    static const char* name() { return "row-major"; }
+};
+
+// 把x的低16位隔位展开：abcd -> 0a0b0c0d
+inline unsigned int spreadBits(unsigned int x)
+{
+    x &= 0x0000FFFF;
+    x = (x | (x << 8)) & 0x00FF00FF;
+    x = (x | (x << 4)) & 0x0F0F0F0F;
+    x = (x | (x << 2)) & 0x33333333;
+    x = (x | (x << 1)) & 0x55555555;
+    return x;
+}
+
+template <int BITS>
+struct MortonLayout
+{
+    enum { ID = 2 };
+
+    static int index(int r, int c)
+    {
+        return static_cast<int>((spreadBits(r) << 1) | spreadBits(c));
+    }
+
+    static const char* name() { return "morton"; }
+};
+
+#endif
@@ -0,0 +1,123 @@
+/*
+** 把地图块转换成四边形
+** 只依赖元件的UV表和批次的 add(x1, y1, x2, y2, u0, v0, u1, v1) 接口，
+** 编辑器交给 QuadBatch 绘制，没有窗口的回放工具（TileBench）交给只做统计的批次。
+**
+** 实际的地图大部分是完全在地形内或完全在地形外的元件，所以按元件的填充方式合并：
+** 空白元件不画；单色元件和可以平铺的元件向右、再向下贪心地合并成尽量大的矩形，
+** 每个矩形只画一个四边形。单色元件的四个角都取元件中心的UV，拉伸后颜色不变，也不会采样到图集里的相邻元件；
+** 可平铺的元件（占满整张纹理）按格数重复UV，依赖纹理默认的 WRAP 寻址方式。
+**
+** author : gouki04 2011-12-30
+*/
+
+#ifndef TILEMESH_H
+#define TILEMESH_H
+
+#include <string.h>
+
+#define LOD_LEVELS 5    // 缩小显示的最大级数，第 n 级缩小到 1/(1 << n)
+
+// 元件的填充方式，由 TileSet 加载时读取像素得出
+enum TileFill
+{
+    TILE_FILL_NONE,     // 普通元件，只能逐个画
+    TILE_FILL_EMPTY,    // 完全透明，不用画
+    TILE_FILL_SOLID,    // 所有像素相同，可以拉伸
+    TILE_FILL_WRAP      // 占满整张纹理，可以重复UV
+};
+
+// 元件的UV表，按分量分别存放
+struct TileUVs
+{
+    const float* u0;
+    const float* v0;
+    const float* u1;
+    const float* v1;
+    int count;
+    const unsigned char* fill;  // 每个元件的 TileFill，为0时逐个画所有元件
+};
+
+// 把坐标缩小到 1/(1 << shift) 再平移到 (x0, y0) 后交给另一个批次，用来画缩小的地图
+template <typename Batch>
+struct ScaledBatch
+{
+    Batch& batch;
+    int shift;
+    float x0, y0;
+
+    void add(float x1, float y1, float x2, float y2, float u0, float v0, float u1, float v1)
+    {
+        float scale = 1.f / static_cast<float>(1 << shift);
+        batch.add(x0 + x1 * scale, y0 + y1 * scale, x0 + x2 * scale, y0 + y2 * scale, u0, v0, u1, v1);
+    }
+};
+
+// 把块左上角 rows*cols 个元件加入批次，(x0, y0) 是块左上角的屏幕坐标
+template <typename Mode, int TILE_SHIFT, typename Chunk, typename Batch>
+void emitChunkTiles(Batch& batch, const Chunk* chunk, int rows, int cols, int x0, int y0, const TileUVs& uv)
+{
+    // 已经合并进前面的矩形的元件
+    unsigned char merged[Chunk::CELLS];
+    memset(merged, 0, sizeof(merged));
+
+    for (int i = 0; i < rows; ++i)
+    {
+        for (int j = 0; j < cols; ++j)
+        {
+            if (merged[i * Chunk::SIZE + j])
+                continue;
+
+            int tile = Mode::tileIndex(chunk->get(i, j));
+            if (tile >= uv.count)
+                continue;
+
+            int fill = uv.fill ? uv.fill[tile] : static_cast<int>(TILE_FILL_NONE);
+            if (fill == TILE_FILL_EMPTY)
+                continue;
+
+            // 先向右扩展，再向下扩展到整行都是同一个元件为止
+            int w = 1, h = 1;
+            if (fill != TILE_FILL_NONE)
+            {
+                while (j + w < cols && !merged[i * Chunk::SIZE + j + w]
+                    && Mode::tileIndex(chunk->get(i, j + w)) == tile)
+                    ++w;
+
+                for (; i + h < rows; ++h)
+                {
+                    int k = 0;
+                    while (k < w && !merged[(i + h) * Chunk::SIZE + j + k]
+                        && Mode::tileIndex(chunk->get(i + h, j + k)) == tile)
+                        ++k;
+                    if (k < w)
+                        break;
+
+                    memset(merged + (i + h) * Chunk::SIZE + j, 1, w);
+                }
+            }
+
+            float x1 = static_cast<float>(x0 + (j << TILE_SHIFT));
+            float y1 = static_cast<float>(y0 + (i << TILE_SHIFT));
+            float x2 = static_cast<float>(x0 + ((j + w) << TILE_SHIFT));
+            float y2 = static_cast<float>(y0 + ((i + h) << TILE_SHIFT));
+
+            float u0 = uv.u0[tile], v0 = uv.v0[tile], u1 = uv.u1[tile], v1 = uv.v1[tile];
+            if (fill == TILE_FILL_SOLID)
+            {
+                u0 = u1 = (u0 + u1) * 0.5f;
+                v0 = v1 = (v0 + v1) * 0.5f;
+            }
+            else if (fill == TILE_FILL_WRAP)
+            {
+                u1 = u0 + (u1 - u0) * w;
+                v1 = v0 + (v1 - v0) * h;
+            }
+
+            batch.add(x1, y1, x2, y2, u0, v0, u1, v1);
+            j += w - 1;
+        }
+    }
+}
+
+#endif
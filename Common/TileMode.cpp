@@ -0,0 +1,10 @@
+/*
+** 地图模式
+**
+** author : gouki04 2011-12-30
+*/
+
+#include "TileMode.h"
+
+// 在进入 main() 之前建好，之后任何线程都可以直接读
+const BlobMode::TileTable BlobMode::tileTable;
@@ -0,0 +1,239 @@
+/*
+** 地图模式
+** 每种模式决定：鼠标选中的是元件还是顶点、绘制一次修改哪些格子、格子的值对应哪个地图元件
+**
+** EasyMode     : 简单模式，选中元件，一次填满元件的四个角（影响周围3*3个元件），16个元件
+** WarcraftMode : 魔兽争霸模式，选中顶点，一次只填一个顶点（影响周围2*2个元件），16个元件
+** BlobMode     : 8邻接模式，每个格子记录自己和8个邻居是否有地形，
+**                按邻居关系挑选47种元件之一（再加一个空白元件），共48个元件
+**
+** author : gouki04 2011-12-30
+*/
+
+#ifndef TILEMODE_H
+#define TILEMODE_H
+
+#include "TileOps.h"
+
+enum TileModeId
+{
+    TILEMODE_EASY = 0,
+    TILEMODE_WARCRAFT = 1,
+    TILEMODE_BLOB = 2
+};
+
+// 存档文件头中记录的地图格式
+#define TILE_EDITOR_TAG(mode, cellBits, tileShift) ((mode) | ((cellBits) << 8) | ((tileShift) << 16))
+
+// 按位宽选择格子类型
+template <int BITS> struct TileCell;
+template <> struct TileCell<8> { typedef unsigned char Type; };
+template <> struct TileCell<16> { typedef unsigned short Type; };
+
+struct EasyMode
+{
+    enum { ID = TILEMODE_EASY, TILE_COUNT = 16, MIN_CELL_BITS = 8, PICK_VERTEX = 0 };
+
+    // stamp(r, c) 改动的元件范围：行 r - FOOTPRINT_BEFORE ~ r + FOOTPRINT_AFTER，列相同
+    enum { FOOTPRINT_BEFORE = 1, FOOTPRINT_AFTER = 1 };
+
+    // 地形区域（TileRegions.h）的格点：0 是元件的顶点，否则是元件本身，值是格子的这一位
+    enum { REGION_SITE_BIT = 0 };
+
+    static const char* name() { return "easy"; }
+
+    template <typename Map>
+    static void stamp(Map& map, int r, int c, bool value)
+    {
+        int rows = map.rows(), cols = map.cols();
+
+        if (value)
+        {
+            // 将中心点周围的16个小格填为1
+
+            if (r > 0)
+            {
+                if (c > 0) map.orBits(r - 1, c - 1, 0x8);   // 1000
+                map.orBits(r - 1, c, 0xC);  // 1100
+                if (c < cols - 1) map.orBits(r - 1, c + 1, 0x4);    // 0100
+            }
+
+            if (c > 0) map.orBits(r, c - 1, 0xA);   // 1010
+            map.orBits(r, c, 0xF);  // 1111
+            if (c < cols - 1) map.orBits(r, c + 1, 0x5);    // 0101
+
+            if (r < rows - 1)
+            {
+                if (c > 0) map.orBits(r + 1, c - 1, 0x2);   // 0010
+                map.orBits(r + 1, c, 0x3);  // 0011
+                if (c < cols - 1) map.orBits(r + 1, c + 1, 0x1);    // 0001
+            }
+        }
+        else
+        {
+            // 将中心点周围的16个小格填为0
+
+            if (r > 0)
+            {
+                if (c > 0) map.clearBits(r - 1, c - 1, 0x8);    // 0111
+                map.clearBits(r - 1, c, 0xC);   // 0011
+                if (c < cols - 1) map.clearBits(r - 1, c + 1, 0x4); // 1011
+            }
+
+            if (c > 0) map.clearBits(r, c - 1, 0xA);    // 0101
+            map.clearBits(r, c, 0xF);   // 0000
+            if (c < cols - 1) map.clearBits(r, c + 1, 0x5); // 1010
+
+            if (r < rows - 1)
+            {
+                if (c > 0) map.clearBits(r + 1, c - 1, 0x2);    // 1101
+                map.clearBits(r + 1, c, 0x3);   // 1100
+                if (c < cols - 1) map.clearBits(r + 1, c + 1, 0x1); // 1110
+            }
+        }
+    }
+
+    static int tileIndex(int cell) { return cell; }
+
+    // 完全在地形内的元件，空白元件都是 0
+    static int fullTile() { return 0xF; }
+};
+
+struct WarcraftMode
+{
+    enum { ID = TILEMODE_WARCRAFT, TILE_COUNT = 16, MIN_CELL_BITS = 8, PICK_VERTEX = 1 };
+    enum { FOOTPRINT_BEFORE = 1, FOOTPRINT_AFTER = 0 };
+    enum { REGION_SITE_BIT = 0 };
+
+    static const char* name() { return "warcraft"; }
+
+    // 将顶点周围的4个小格填为 value
+    template <typename Map>
+    static void stamp(Map& map, int r, int c, bool value)
+    {
+        setCorner(map, r, c, value);
+    }
+
+    static int tileIndex(int cell) { return cell; }
+    static int fullTile() { return 0xF; }
+};
+
+struct BlobMode
+{
+    enum { ID = TILEMODE_BLOB, TILE_COUNT = 48, MIN_CELL_BITS = 16, PICK_VERTEX = 0 };
+    enum { FOOTPRINT_BEFORE = 1, FOOTPRINT_AFTER = 1 };
+
+    // 格子的低8位是8个邻居，第9位是自己
+    enum
+    {
+        NW = 0x01, N = 0x02, NE = 0x04,
+        W = 0x08,            E = 0x10,
+        SW = 0x20, S = 0x40, SE = 0x80,
+        SELF = 0x100
+    };
+
+    enum { REGION_SITE_BIT = SELF };
+
+    static const char* name() { return "blob"; }
+
+    template <typename Map>
+    static void stamp(Map& map, int r, int c, bool value)
+    {
+        static const int neighbourBit[3][3] =
+        {
+            { SE, S, SW },  // 上一行的格子看自己，是在它的下方
+            { E,  0, W  },
+            { NE, N, NW },
+        };
+
+        int rows = map.rows(), cols = map.cols();
+
+        for (int dr = -1; dr <= 1; ++dr)
+        {
+            int nr = r + dr;
+            if (nr < 0 || nr >= rows) continue;
+
+            for (int dc = -1; dc <= 1; ++dc)
+            {
+                int nc = c + dc;
+                if (nc < 0 || nc >= cols) continue;
+
+                int bit = (dr == 0 && dc == 0) ? SELF : neighbourBit[dr + 1][dc + 1];
+                if (value) map.orBits(nr, nc, bit);
+                else map.clearBits(nr, nc, bit);
+            }
+        }
+    }
+
+    // 0 是空白元件，1~47 是按邻居关系区分的元件，按规约后的掩码从小到大排列
+    static int tileIndex(int cell)
+    {
+        if (!(cell & SELF))
+            return 0;
+        return 1 + tileTable.index[cell & 0xFF];
+    }
+
+    static int fullTile() { return tileIndex(SELF | 0xFF); }
+
+private:
+    // 每个邻居掩码对应的元件编号，在静态初始化时建好（见 TileMode.cpp），工作线程转换地图块时只读
+    struct TileTable
+    {
+        int index[256];
+        TileTable() { buildTable(index); }
+    };
+    friend struct TileTable;
+    static const TileTable tileTable;
+
+    // 角上的邻居只有在相邻两条边都有地形时才有意义，去掉无意义的位后剩下47种情况
+    static int reduce(int mask)
+    {
+        if ((mask & (N | W)) != (N | W)) mask &= ~NW;
+        if ((mask & (N | E)) != (N | E)) mask &= ~NE;
+        if ((mask & (S | W)) != (S | W)) mask &= ~SW;
+        if ((mask & (S | E)) != (S | E)) mask &= ~SE;
+        return mask;
+    }
+
+    static void buildTable(int* table)
+    {
+        int index[256];
+        int count = 0;
+
+        for (int i = 0; i < 256; ++i)
+            index[i] = -1;
+
+        for (int mask = 0; mask < 256; ++mask)
+        {
+            int reduced = reduce(mask);
+            if (index[reduced] < 0)
+                index[reduced] = count++;
+            table[mask] = index[reduced];
+        }
+    }
+};
+
+// 把相对地图左上角的像素坐标换算成选中的元件（或顶点），不在地图内时为 -1
+template <typename Mode, int TILE_SHIFT>
+void pickTile(int px, int py, int rows, int cols, int& row, int& col)
+{
+    // 选中顶点时要加上半个元件大小，是为了四舍五入
+    if (Mode::PICK_VERTEX)
+    {
+        px += (1 << TILE_SHIFT) / 2;
+        py += (1 << TILE_SHIFT) / 2;
+    }
+
+    // 与原来的浮点除法一致，向0取整：左边和上边不到一个元件的部分仍然算第0格
+    col = px <= -(1 << TILE_SHIFT) ? -1 : (px < 0 ? 0 : px >> TILE_SHIFT);
+    row = py <= -(1 << TILE_SHIFT) ? -1 : (py < 0 ? 0 : py >> TILE_SHIFT);
+
+    // 选中顶点时可以选到地图最右和最下的一条边上
+    int maxRow = Mode::PICK_VERTEX ? rows : rows - 1;
+    int maxCol = Mode::PICK_VERTEX ? cols : cols - 1;
+
+    if (col > maxCol) col = -1;
+    if (row > maxRow) row = -1;
+}
+
+#endif
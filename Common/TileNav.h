@@ -0,0 +1,71 @@
+/*
+** 从分块地图生成导航图（见 NavGraph.h），一个地图块就是一个簇
+** update() 时只把换了块的位置重新写进子格，再修复这些簇的入口和簇内边。
+** 只适用于4位掩码的地图（简单模式和魔兽模式）
+**
+** author : gouki04 2011-12-30
+*/
+
+#ifndef TILENAV_H
+#define TILENAV_H
+
+#include <vector>
+
+#include "NavGraph.h"
+#include "TileChunk.h"
+
+template <typename Map>
+class NavMap
+{
+public:
+    // 地图必须比 NavMap 活得久，并且只在地图 commit() 之后调用 update()
+    // 每个区域 (1 << regionBits)*(1 << regionBits) 个块
+    NavMap(Map& m, bool terrainWalkable, int regionBits = NAV_REGION_BITS) : map(m), watcher(m)
+    {
+        nav.create(m.rows(), m.cols(), Map::CHUNK_BITS, regionBits, terrainWalkable);
+    }
+
+    NavGraph& graph() { return nav; }
+
+    // 返回修复的簇数
+    int update()
+    {
+        return update(0, 0, map.rows(), map.cols());
+    }
+
+    // 只检查第 r1 ~ r2 行、第 c1 ~ c2 列（不包含 r2, c2）的元件所在的块，编辑的范围已知时用这个
+    int update(int r1, int c1, int r2, int c2)
+    {
+        changed.clear();
+        watcher.collect(r1, c1, r2, c2, changed);
+        if (changed.empty())
+            return 0;
+
+        for (size_t i = 0; i < changed.size(); ++i)
+        {
+            int cr = changed[i] / map.chunkCols(), cc = changed[i] % map.chunkCols();
+            const typename Map::Chunk* chunk = map.chunkAt(cr, cc);
+
+            int r0 = cr << Map::CHUNK_BITS, c0 = cc << Map::CHUNK_BITS;
+            int rows = map.rows() - r0 < Map::CHUNK_SIZE ? map.rows() - r0 : Map::CHUNK_SIZE;
+            int cols = map.cols() - c0 < Map::CHUNK_SIZE ? map.cols() - c0 : Map::CHUNK_SIZE;
+            for (int r = 0; r < rows; ++r)
+                for (int c = 0; c < cols; ++c)
+                    nav.setTile(r0 + r, c0 + c, chunk->get(r, c) & 0xF);
+        }
+
+        nav.repair(changed);
+        return static_cast<int>(changed.size());
+    }
+
+private:
+    NavMap(const NavMap&);
+    NavMap& operator=(const NavMap&);
+
+    Map& map;
+    ChunkWatcher<Map> watcher;
+    NavGraph nav;
+    std::vector<int> changed;
+};
+
+#endif
@@ -0,0 +1,203 @@
+/*
+** 地图上的基本编辑操作
+**
+** 两种编辑器其实都在编辑同一个东西：一张 (MAPROW+1)*(MAPCOL+1) 的顶点（角）网格，
+** 每个顶点非0即1，每个地图元件的值就是它四个角拼成的4位掩码：
+**
+**   0x1 --- 0x2
+**    |       |
+**   0x4 --- 0x8
+**
+** 简单模式一次把一个元件的四个角置1，魔兽模式一次只置一个顶点。
+** 这里的函数只要求地图提供 ValueType rows() cols() get() orBits() clearBits() set()
+**
+** author : gouki04 2011-12-30
+*/
+
+#ifndef TILEOPS_H
+#define TILEOPS_H
+
+#include <vector>
+
+// 按行压缩存储的顶点网格，每个顶点1位
+class CornerGrid
+{
+public:
+    CornerGrid(int row = 0, int col = 0) { resize(row, col); }
+
+    void resize(int row, int col)
+    {
+        rowCount = row;
+        colCount = col;
+        wordCount = (col + 31) >> 5;
+        bits.assign(row * wordCount, 0);
+    }
+
+    int rows() const { return rowCount; }
+    int cols() const { return colCount; }
+    int wordsPerRow() const { return wordCount; }
+
+    bool get(int r, int c) const
+    {
+        return (bits[r * wordCount + (c >> 5)] >> (c & 31)) & 1;
+    }
+
+    void set(int r, int c, bool value)
+    {
+        unsigned int& word = bits[r * wordCount + (c >> 5)];
+        if (value) word |= 1u << (c & 31);
+        else word &= ~(1u << (c & 31));
+    }
+
+    unsigned int* row(int r) { return &bits[r * wordCount]; }
+    const unsigned int* row(int r) const { return &bits[r * wordCount]; }
+
+private:
+    int rowCount, colCount, wordCount;
+    std::vector<unsigned int> bits;
+};
+
+// 读取顶点(vr, vc)的值，从包含它的任意一个元件中取对应的角
+template <typename Map>
+bool cornerAt(const Map& map, int vr, int vc)
+{
+    if (vr < map.rows())
+    {
+        if (vc < map.cols()) return (map.get(vr, vc) & 0x1) != 0;
+        return (map.get(vr, vc - 1) & 0x2) != 0;
+    }
+
+    if (vc < map.cols()) return (map.get(vr - 1, vc) & 0x4) != 0;
+    return (map.get(vr - 1, vc - 1) & 0x8) != 0;
+}
+
+// 设置顶点(vr, vc)的值，同时修改包含它的4个元件
+template <typename Map>
+void setCorner(Map& map, int vr, int vc, bool value)
+{
+    int rows = map.rows(), cols = map.cols();
+
+    if (value)
+    {
+        if (vr > 0)
+        {
+            if (vc > 0) map.orBits(vr - 1, vc - 1, 0x8);
+            if (vc < cols) map.orBits(vr - 1, vc, 0x4);
+        }
+        if (vr < rows)
+        {
+            if (vc > 0) map.orBits(vr, vc - 1, 0x2);
+            if (vc < cols) map.orBits(vr, vc, 0x1);
+        }
+    }
+    else
+    {
+        if (vr > 0)
+        {
+            if (vc > 0) map.clearBits(vr - 1, vc - 1, 0x8);
+            if (vc < cols) map.clearBits(vr - 1, vc, 0x4);
+        }
+        if (vr < rows)
+        {
+            if (vc > 0) map.clearBits(vr, vc - 1, 0x2);
+            if (vc < cols) map.clearBits(vr, vc, 0x1);
+        }
+    }
+}
+
+// 简单模式：把元件(r, c)的四个角都置为 value（即周围3*3个元件）
+template <typename Map>
+void stampTile(Map& map, int r, int c, bool value)
+{
+    setCorner(map, r, c, value);
+    setCorner(map, r, c + 1, value);
+    setCorner(map, r + 1, c, value);
+    setCorner(map, r + 1, c + 1, value);
+}
+
+// 从地图中读出整张顶点网格
+template <typename Map>
+void readCorners(const Map& map, CornerGrid& grid)
+{
+    grid.resize(map.rows() + 1, map.cols() + 1);
+    for (int r = 0; r <= map.rows(); ++r)
+        for (int c = 0; c <= map.cols(); ++c)
+            if (cornerAt(map, r, c)) grid.set(r, c, true);
+}
+
+// 根据顶点网格重新计算矩形区域内所有元件的掩码
+template <typename Map>
+void retile(Map& map, const CornerGrid& grid, int r0, int c0, int r1, int c1)
+{
+    for (int r = r0; r < r1; ++r)
+    {
+        for (int c = c0; c < c1; ++c)
+        {
+            int mask = (grid.get(r, c) ? 0x1 : 0)
+                | (grid.get(r, c + 1) ? 0x2 : 0)
+                | (grid.get(r + 1, c) ? 0x4 : 0)
+                | (grid.get(r + 1, c + 1) ? 0x8 : 0);
+            map.set(r, c, static_cast<typename Map::ValueType>(mask));
+        }
+    }
+}
+
+template <typename Map>
+void retile(Map& map, const CornerGrid& grid)
+{
+    retile(map, grid, 0, 0, map.rows(), map.cols());
+}
+
+// 从顶点(vr, vc)开始，把与它相连（4邻接）且值相同的顶点全部置为 value
+// 返回被修改的顶点数
+template <typename Map>
+int floodFill(Map& map, int vr, int vc, bool value)
+{
+    if (cornerAt(map, vr, vc) == value)
+        return 0;
+
+    int vrows = map.rows() + 1, vcols = map.cols() + 1;
+    int count = 0;
+
+    // 扫描线填充，栈中保存待处理的顶点
+    std::vector<int> stack;
+    stack.push_back(vr * vcols + vc);
+
+    while (!stack.empty())
+    {
+        int v = stack.back();
+        stack.pop_back();
+
+        int r = v / vcols, c = v % vcols;
+        if (cornerAt(map, r, c) == value)
+            continue;
+
+        int left = c, right = c;
+        while (left > 0 && cornerAt(map, r, left - 1) != value) --left;
+        while (right < vcols - 1 && cornerAt(map, r, right + 1) != value) ++right;
+
+        for (int i = left; i <= right; ++i)
+        {
+            setCorner(map, r, i, value);
+            ++count;
+        }
+
+        for (int dr = -1; dr <= 1; dr += 2)
+        {
+            int nr = r + dr;
+            if (nr < 0 || nr >= vrows) continue;
+
+            bool inSpan = false;
+            for (int i = left; i <= right; ++i)
+            {
+                bool open = cornerAt(map, nr, i) != value;
+                if (open && !inSpan) stack.push_back(nr * vcols + i);
+                inSpan = open;
+            }
+        }
+    }
+
+    return count;
+}
+
+#endif
@@ -0,0 +1,842 @@
+/*
+** 地形区域（连通块）
+** 把地图看成格点网格：4位掩码的地图（简单模式和魔兽模式）的格点是元件的顶点，8邻接模式的格点是元件本身。
+** 值相同并且4邻接的格点属于同一个区域，与 floodFill() 一次填充的范围一致。
+** 地形的区域是岛，不碰到地图边缘的空白区域是湖。区域存在期间编号不变，可以用来指定出生点之类。
+**
+** 每个地图块先在块内把格点分成碎片（块内的连通块），相邻块中相连的碎片属于同一个区域：
+** build() 时块内的标记和每一段块行内的合并（并查集）交给工作线程并行执行，段与段之间的接缝在调用线程中合并。
+**
+** update() 只重新标记换了块的位置，区域的合并和分裂也只在这些块附近判断：
+** 换掉的块里的新碎片和块外贴着它们的碎片按是否相连分组；原来属于同一个区域、现在分在几组里的，
+** 从各组同时在块外一次一个碎片地往外找，碰到一起的还是同一个区域，找完了也没碰到的是分出来的区域，
+** 所以分裂的代价只和分出来的小的部分有关。合并时保留大的区域的编号，只改小的那部分。
+**
+** author : gouki04 2011-12-30
+*/
+
+#ifndef TILEREGIONS_H
+#define TILEREGIONS_H
+
+#include <algorithm>
+#include <vector>
+
+#include "JobScheduler.h"
+#include "Platform.h"
+#include "TileChunk.h"
+
+struct TerrainRegion
+{
+    int size;           // 格点数
+    int pieces;         // 碎片数，为0时这个编号没有使用
+    int edgePieces;     // 碰到地图边缘的碎片数
+    bool terrain;
+
+    bool used() const { return pieces > 0; }
+    bool island() const { return used() && terrain; }
+    bool lake() const { return used() && !terrain && edgePieces == 0; }
+};
+
+struct RegionStats
+{
+    int regions, islands, lakes;
+    int largestIsland, largestLake;     // 格点数
+};
+
+/*
+** SITE_BIT 为 0 时格点是元件的顶点（4位掩码），否则格点是元件本身，值是格子的这一位（8邻接模式的 SELF）
+** 地图必须比 RegionLabels 活得久，先调用一次 build()，之后只在地图 commit() 之后调用 update()
+*/
+template <typename Map, int SITE_BIT = 0>
+class RegionLabels
+{
+public:
+    enum { CORNERS = SITE_BIT == 0 ? 1 : 0 };
+
+    explicit RegionLabels(Map& m)
+        : map(m), watcher(m), chunks(m.chunkRows() * m.chunkCols()), pending(0), chunkMark(chunks.size(), 0),
+          stamp(0), searchStamp(0)
+    {
+        for (int cr = 0; cr < map.chunkRows(); ++cr)
+        {
+            for (int cc = 0; cc < map.chunkCols(); ++cc)
+            {
+                ChunkSites& cs = chunks[cr * map.chunkCols() + cc];
+                int r0 = cr << Map::CHUNK_BITS, c0 = cc << Map::CHUNK_BITS;
+                cs.tileRows = map.rows() - r0 < Map::CHUNK_SIZE ? map.rows() - r0 : Map::CHUNK_SIZE;
+                cs.tileCols = map.cols() - c0 < Map::CHUNK_SIZE ? map.cols() - c0 : Map::CHUNK_SIZE;
+
+                // 最后一行（列）顶点属于最下面（右边）的块
+                cs.rows = cs.tileRows + (CORNERS && cr == map.chunkRows() - 1 ? 1 : 0);
+                cs.cols = cs.tileCols + (CORNERS && cc == map.chunkCols() - 1 ? 1 : 0);
+            }
+        }
+    }
+
+    int siteRows() const { return map.rows() + CORNERS; }
+    int siteCols() const { return map.cols() + CORNERS; }
+
+    // 重新标记整张地图，jobs 不为 0 时块内的标记和块行内的合并在工作线程中并行执行
+    void build(JobScheduler* jobs = 0)
+    {
+        changed.clear();
+        watcher.collect(changed);
+
+        regions.clear();
+        freeRegions.clear();
+        regionMark.clear();
+        keeper.clear();
+
+        // 按块行分段，每段一个任务
+        int segments = jobs ? jobs->workerCount() * 4 : 1;
+        if (segments > map.chunkRows())
+            segments = map.chunkRows();
+        bands.clear();
+        for (int i = 0; i <= segments; ++i)
+            bands.push_back(map.chunkRows() * i / segments);
+
+        runBands(jobs, &RegionLabels::labelRows);
+
+        // 碎片的全局编号
+        base.assign(chunks.size() + 1, 0);
+        for (size_t k = 0; k < chunks.size(); ++k)
+            base[k + 1] = base[k] + static_cast<int>(chunks[k].pieces.size());
+        parent.resize(base.back());
+        for (int i = 0; i < base.back(); ++i)
+            parent[i] = i;
+
+        runBands(jobs, &RegionLabels::joinRows);
+
+        // 段与段之间的接缝
+        std::vector<std::pair<int, int> > pairs;
+        for (size_t b = 1; b + 1 < bands.size(); ++b)
+        {
+            for (int cc = 0; cc < map.chunkCols(); ++cc)
+                joinSide((bands[b] - 1) * map.chunkCols() + cc, SIDE_BOTTOM, pairs);
+        }
+
+        // 每个并查集的根一个区域
+        std::vector<int> rootRegion(base.back(), -1);
+        for (size_t k = 0; k < chunks.size(); ++k)
+        {
+            std::vector<Piece>& pieces = chunks[k].pieces;
+            for (size_t p = 0; p < pieces.size(); ++p)
+            {
+                int root = find(base[k] + static_cast<int>(p));
+                if (rootRegion[root] < 0)
+                    rootRegion[root] = allocRegion(pieces[p].terrain);
+                pieces[p].region = rootRegion[root];
+                addPiece(pieces[p].region, pieces[p]);
+            }
+        }
+
+        std::vector<int>().swap(parent);
+        std::vector<int>().swap(base);
+    }
+
+    // 返回重新标记的块数
+    int update()
+    {
+        return update(0, 0, map.rows(), map.cols());
+    }
+
+    // 只检查第 r1 ~ r2 行、第 c1 ~ c2 列（不包含 r2, c2）的元件所在的块，编辑的范围已知时用这个
+    int update(int r1, int c1, int r2, int c2)
+    {
+        changed.clear();
+        watcher.collect(r1, c1, r2, c2, changed);
+        if (changed.empty())
+            return 0;
+
+        ++stamp;
+        for (size_t i = 0; i < changed.size(); ++i)
+            chunkMark[changed[i]] = stamp;
+
+        // 换掉的块里原来的碎片先从区域中去掉
+        emptied.clear();
+        for (size_t i = 0; i < changed.size(); ++i)
+        {
+            std::vector<Piece>& pieces = chunks[changed[i]].pieces;
+            for (size_t p = 0; p < pieces.size(); ++p)
+            {
+                removePiece(pieces[p].region, pieces[p]);
+                if (regionMark[pieces[p].region] != stamp)
+                {
+                    regionMark[pieces[p].region] = stamp;
+                    emptied.push_back(pieces[p].region);
+                }
+            }
+        }
+
+        for (size_t i = 0; i < changed.size(); ++i)
+            labelChunk(changed[i]);
+
+        groupPieces();
+        resolveRegions();
+        assignRegions();
+
+        // 碎片全部去掉了的区域
+        std::sort(emptied.begin(), emptied.end());
+        emptied.erase(std::unique(emptied.begin(), emptied.end()), emptied.end());
+        for (size_t i = 0; i < emptied.size(); ++i)
+        {
+            if (!regions[emptied[i]].used())
+                freeRegions.push_back(emptied[i]);
+        }
+
+        return static_cast<int>(changed.size());
+    }
+
+    // 格点 (r, c) 所属的区域
+    int regionAt(int r, int c) const
+    {
+        int cr = r >> Map::CHUNK_BITS, cc = c >> Map::CHUNK_BITS;
+        if (cr >= map.chunkRows()) cr = map.chunkRows() - 1;
+        if (cc >= map.chunkCols()) cc = map.chunkCols() - 1;
+
+        const ChunkSites& cs = chunks[cr * map.chunkCols() + cc];
+        int local = (r - (cr << Map::CHUNK_BITS)) * cs.cols + c - (cc << Map::CHUNK_BITS);
+        return cs.pieces[cs.labels[local]].region;
+    }
+
+    // 编号从 0 到 regionCapacity() - 1，其中没有使用的编号 used() 为 false
+    int regionCapacity() const { return static_cast<int>(regions.size()); }
+    const TerrainRegion& region(int id) const { return regions[id]; }
+
+    RegionStats stats() const
+    {
+        RegionStats s = { 0, 0, 0, 0, 0 };
+        for (size_t i = 0; i < regions.size(); ++i)
+        {
+            const TerrainRegion& g = regions[i];
+            if (!g.used())
+                continue;
+
+            ++s.regions;
+            if (g.island())
+            {
+                ++s.islands;
+                if (g.size > s.largestIsland) s.largestIsland = g.size;
+            }
+            else if (g.lake())
+            {
+                ++s.lakes;
+                if (g.size > s.largestLake) s.largestLake = g.size;
+            }
+        }
+        return s;
+    }
+
+private:
+    RegionLabels(const RegionLabels&);
+    RegionLabels& operator=(const RegionLabels&);
+
+    enum { SIDE_RIGHT, SIDE_BOTTOM, SIDE_LEFT, SIDE_TOP };
+    // 碎片的 key 是 (块 << PIECE_SHIFT) | 块内编号，一个块最多 (CHUNK_SIZE + 1)*(CHUNK_SIZE + 1) 个碎片
+    enum { PIECE_SHIFT = Map::CHUNK_BITS * 2 + 2, NO_PIECE = 0xFFFF };
+
+    struct Piece
+    {
+        int region;
+        int size;
+        bool terrain, edge;
+        int mark;           // update() 中分过组时为当时的 stamp
+        int term;           // 所在的组
+        int searchMark;     // separate() 中找到过时为当时的 searchStamp
+        int owner;          // 找到它的搜索
+    };
+
+    struct ChunkSites
+    {
+        int tileRows, tileCols;
+        int rows, cols;                         // 块内的格点数
+        std::vector<unsigned short> labels;     // 每个格点所属的碎片
+        std::vector<Piece> pieces;
+    };
+
+    // separate() 中从一组出发的搜索
+    struct Search
+    {
+        int term;
+        std::vector<int> queue;
+        size_t head;
+        int found;
+    };
+
+    class BandJob : public Job
+    {
+    public:
+        BandJob(RegionLabels* o, void (RegionLabels::*f)(int, int), int b, int e)
+            : owner(o), func(f), begin(b), end(e)
+        {
+        }
+
+        virtual void run()
+        {
+            (owner->*func)(begin, end);
+            if (atomicAdd(&owner->pending, -1) == 0)
+                owner->finished.signal();
+        }
+
+    private:
+        RegionLabels* owner;
+        void (RegionLabels::*func)(int, int);
+        int begin, end;
+    };
+
+    // 每一段块行调用一次 func，有工作线程时等所有段执行完才返回
+    void runBands(JobScheduler* jobs, void (RegionLabels::*func)(int, int))
+    {
+        int segments = static_cast<int>(bands.size()) - 1;
+        if (!jobs || segments <= 1)
+        {
+            (this->*func)(0, map.chunkRows());
+            return;
+        }
+
+        atomicStore(&pending, segments);
+        for (int b = 0; b < segments; ++b)
+            jobs->submit(new BandJob(this, func, bands[b], bands[b + 1]), -1);
+        finished.wait();
+    }
+
+    void labelRows(int begin, int end)
+    {
+        for (int cr = begin; cr < end; ++cr)
+            for (int cc = 0; cc < map.chunkCols(); ++cc)
+                labelChunk(cr * map.chunkCols() + cc);
+    }
+
+    // 段内的块和右边、下边（同一段内）的块合并
+    void joinRows(int begin, int end)
+    {
+        std::vector<std::pair<int, int> > pairs;
+        for (int cr = begin; cr < end; ++cr)
+        {
+            for (int cc = 0; cc < map.chunkCols(); ++cc)
+            {
+                int k = cr * map.chunkCols() + cc;
+                joinSide(k, SIDE_RIGHT, pairs);
+                if (cr + 1 < end)
+                    joinSide(k, SIDE_BOTTOM, pairs);
+            }
+        }
+    }
+
+    void joinSide(int k, int side, std::vector<std::pair<int, int> >& pairs)
+    {
+        pairs.clear();
+        sidePairs(k, side, pairs);
+        for (size_t i = 0; i < pairs.size(); ++i)
+        {
+            int n = pairs[i].second >> PIECE_SHIFT, q = pairs[i].second & ((1 << PIECE_SHIFT) - 1);
+            if (chunks[k].pieces[pairs[i].first].terrain != chunks[n].pieces[q].terrain)
+                continue;
+
+            int a = find(base[k] + pairs[i].first), b = find(base[n] + q);
+            if (a != b)
+                parent[a > b ? a : b] = a < b ? a : b;
+        }
+    }
+
+    int find(int i)
+    {
+        while (parent[i] != i)
+        {
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+        }
+        return i;
+    }
+
+    bool siteValue(const typename Map::Chunk* chunk, const ChunkSites& cs, int y, int x) const
+    {
+        if (!CORNERS)
+            return (chunk->get(y, x) & SITE_BIT) != 0;
+
+        // 最后一行（列）顶点从上面（左边）的元件的下角（右角）取
+        int bit = 0x1;
+        if (y == cs.tileRows) { --y; bit <<= 2; }
+        if (x == cs.tileCols) { --x; bit <<= 1; }
+        return (chunk->get(y, x) & bit) != 0;
+    }
+
+    // 块内的连通块，只读块本身，可以在工作线程中执行
+    void labelChunk(int k)
+    {
+        ChunkSites& cs = chunks[k];
+        int cr = k / map.chunkCols(), cc = k % map.chunkCols();
+        const typename Map::Chunk* chunk = map.chunkAt(cr, cc);
+        int r0 = cr << Map::CHUNK_BITS, c0 = cc << Map::CHUNK_BITS;
+
+        bool value[(Map::CHUNK_SIZE + 1) * (Map::CHUNK_SIZE + 1)];
+        for (int y = 0; y < cs.rows; ++y)
+            for (int x = 0; x < cs.cols; ++x)
+                value[y * cs.cols + x] = siteValue(chunk, cs, y, x);
+
+        int n = cs.rows * cs.cols;
+        cs.labels.assign(n, NO_PIECE);
+        cs.pieces.clear();
+
+        int todo[(Map::CHUNK_SIZE + 1) * (Map::CHUNK_SIZE + 1)];
+        for (int start = 0; start < n; ++start)
+        {
+            if (cs.labels[start] != NO_PIECE)
+                continue;
+
+            Piece piece = { -1, 0, value[start], false, 0, 0, 0, 0 };
+            unsigned short label = static_cast<unsigned short>(cs.pieces.size());
+
+            int top = 0;
+            todo[top++] = start;
+            cs.labels[start] = label;
+            while (top > 0)
+            {
+                int i = todo[--top];
+                int y = i / cs.cols, x = i % cs.cols;
+                ++piece.size;
+
+                int r = r0 + y, c = c0 + x;
+                if (r == 0 || c == 0 || r == siteRows() - 1 || c == siteCols() - 1)
+                    piece.edge = true;
+
+                int around[4] = { y > 0 ? i - cs.cols : -1, y < cs.rows - 1 ? i + cs.cols : -1,
+                                  x > 0 ? i - 1 : -1, x < cs.cols - 1 ? i + 1 : -1 };
+                for (int d = 0; d < 4; ++d)
+                {
+                    int j = around[d];
+                    if (j >= 0 && cs.labels[j] == NO_PIECE && value[j] == piece.terrain)
+                    {
+                        cs.labels[j] = label;
+                        todo[top++] = j;
+                    }
+                }
+            }
+            cs.pieces.push_back(piece);
+        }
+    }
+
+    // 块 k 的 side 边上与相邻块贴着的格点对：(块内的碎片, 相邻块的碎片的 key)，相同的对只放一次
+    void sidePairs(int k, int side, std::vector<std::pair<int, int> >& out) const
+    {
+        static const int DR[4] = { 0, 1, 0, -1 };
+        static const int DC[4] = { 1, 0, -1, 0 };
+
+        int nr = k / map.chunkCols() + DR[side], nc = k % map.chunkCols() + DC[side];
+        if (nr < 0 || nc < 0 || nr >= map.chunkRows() || nc >= map.chunkCols())
+            return;
+
+        int n = nr * map.chunkCols() + nc;
+        const ChunkSites& a = chunks[k];
+        const ChunkSites& b = chunks[n];
+        int count = side == SIDE_RIGHT || side == SIDE_LEFT ? a.rows : a.cols;
+        size_t first = out.size();
+
+        for (int i = 0; i < count; ++i)
+        {
+            int ia, ib;
+            switch (side)
+            {
+            case SIDE_RIGHT: ia = i * a.cols + a.cols - 1; ib = i * b.cols; break;
+            case SIDE_BOTTOM: ia = (a.rows - 1) * a.cols + i; ib = i; break;
+            case SIDE_LEFT: ia = i * a.cols; ib = i * b.cols + b.cols - 1; break;
+            default: ia = i; ib = (b.rows - 1) * b.cols + i; break;
+            }
+
+            std::pair<int, int> p(a.labels[ia], (n << PIECE_SHIFT) | b.labels[ib]);
+            if (out.size() == first || out.back() != p)
+                out.push_back(p);
+        }
+    }
+
+    Piece& piece(int key) { return chunks[key >> PIECE_SHIFT].pieces[key & ((1 << PIECE_SHIFT) - 1)]; }
+
+    // 相邻块中与碎片 key 相连的碎片，可能有重复
+    void linked(int key, std::vector<int>& out)
+    {
+        out.clear();
+        int k = key >> PIECE_SHIFT, p = key & ((1 << PIECE_SHIFT) - 1);
+        bool terrain = chunks[k].pieces[p].terrain;
+
+        for (int side = 0; side < 4; ++side)
+        {
+            pairs.clear();
+            sidePairs(k, side, pairs);
+            for (size_t i = 0; i < pairs.size(); ++i)
+            {
+                if (pairs[i].first == p && piece(pairs[i].second).terrain == terrain)
+                    out.push_back(pairs[i].second);
+            }
+        }
+    }
+
+    int allocRegion(bool terrain)
+    {
+        int id;
+        if (!freeRegions.empty())
+        {
+            id = freeRegions.back();
+            freeRegions.pop_back();
+        }
+        else
+        {
+            id = static_cast<int>(regions.size());
+            regions.push_back(TerrainRegion());
+            regionMark.push_back(0);
+            keeper.push_back(-1);
+        }
+
+        TerrainRegion& g = regions[id];
+        g.size = g.pieces = g.edgePieces = 0;
+        g.terrain = terrain;
+        return id;
+    }
+
+    void addPiece(int id, const Piece& p)
+    {
+        TerrainRegion& g = regions[id];
+        g.size += p.size;
+        ++g.pieces;
+        if (p.edge) ++g.edgePieces;
+    }
+
+    void removePiece(int id, const Piece& p)
+    {
+        TerrainRegion& g = regions[id];
+        g.size -= p.size;
+        --g.pieces;
+        if (p.edge) --g.edgePieces;
+    }
+
+    int findTerm(int t)
+    {
+        while (terms[t] != t)
+        {
+            terms[t] = terms[terms[t]];
+            t = terms[t];
+        }
+        return t;
+    }
+
+    void uniteTerms(int a, int b)
+    {
+        a = findTerm(a);
+        b = findTerm(b);
+        if (a != b)
+            terms[a > b ? a : b] = a < b ? a : b;
+    }
+
+    // 新碎片在换掉的块之间相连的各成一组，块外贴着换掉的块的碎片各自一组，贴着并且值相同的组合并
+    void groupPieces()
+    {
+        terms.clear();
+        newPieces.clear();
+        borderPieces.clear();
+
+        for (size_t i = 0; i < changed.size(); ++i)
+        {
+            int k = changed[i];
+            for (size_t p = 0; p < chunks[k].pieces.size(); ++p)
+            {
+                int key = (k << PIECE_SHIFT) | static_cast<int>(p);
+                if (piece(key).mark == stamp)
+                    continue;
+
+                int t = static_cast<int>(terms.size());
+                terms.push_back(t);
+
+                stack.assign(1, key);
+                piece(key).mark = stamp;
+                piece(key).term = t;
+                while (!stack.empty())
+                {
+                    int v = stack.back();
+                    stack.pop_back();
+                    newPieces.push_back(v);
+
+                    linked(v, links);
+                    for (size_t j = 0; j < links.size(); ++j)
+                    {
+                        Piece& q = piece(links[j]);
+                        if (chunkMark[links[j] >> PIECE_SHIFT] != stamp || q.mark == stamp)
+                            continue;
+                        q.mark = stamp;
+                        q.term = t;
+                        stack.push_back(links[j]);
+                    }
+                }
+            }
+        }
+
+        for (size_t i = 0; i < changed.size(); ++i)
+        {
+            int k = changed[i];
+            for (int side = 0; side < 4; ++side)
+            {
+                pairs.clear();
+                sidePairs(k, side, pairs);
+                for (size_t j = 0; j < pairs.size(); ++j)
+                {
+                    int key = pairs[j].second;
+                    if (chunkMark[key >> PIECE_SHIFT] == stamp)
+                        continue;
+
+                    Piece& q = piece(key);
+                    if (q.mark != stamp)
+                    {
+                        q.mark = stamp;
+                        q.term = static_cast<int>(terms.size());
+                        terms.push_back(q.term);
+                        borderPieces.push_back(std::make_pair(q.region, key));
+                    }
+
+                    const Piece& inside = chunks[k].pieces[pairs[j].first];
+                    if (inside.terrain == q.terrain)
+                        uniteTerms(inside.term, q.term);
+                }
+            }
+        }
+
+        std::sort(borderPieces.begin(), borderPieces.end());
+    }
+
+    // 判断每个原来的区域在块外贴着的碎片之间是否还相连，并决定谁保留原来的编号
+    void resolveRegions()
+    {
+        // 块内没有碎片被换掉的区域在块外本来就是连通的
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            for (size_t i = 0; i < borderPieces.size(); )
+            {
+                size_t end = i;
+                while (end < borderPieces.size() && borderPieces[end].first == borderPieces[i].first)
+                    ++end;
+
+                int id = borderPieces[i].first;
+                bool touched = regionMark[id] == stamp;
+                if (pass == 0 && !touched)
+                {
+                    for (size_t j = i + 1; j < end; ++j)
+                        uniteTerms(piece(borderPieces[i].second).term, piece(borderPieces[j].second).term);
+                    keeper[id] = piece(borderPieces[i].second).term;
+                }
+                else if (pass == 1 && touched)
+                {
+                    keeper[id] = separate(id, i, end);
+                }
+                i = end;
+            }
+        }
+    }
+
+    // 区域 id 在块外贴着的碎片 borderPieces[begin, end) 分属几组时，从各组同时往外找，
+    // 碰到一起的组合并，返回还没找完的那一组（都找完了时是最大的一组）
+    int separate(int id, size_t begin, size_t end)
+    {
+        searches.clear();
+        ++searchStamp;
+
+        for (size_t i = begin; i < end; ++i)
+        {
+            int key = borderPieces[i].second;
+            int root = findTerm(piece(key).term);
+
+            size_t s = 0;
+            while (s < searches.size() && findTerm(searches[s].term) != root)
+                ++s;
+            if (s == searches.size())
+            {
+                searches.push_back(Search());
+                searches.back().term = root;
+                searches.back().head = 0;
+                searches.back().found = 0;
+            }
+
+            piece(key).searchMark = searchStamp;
+            piece(key).owner = static_cast<int>(s);
+            searches[s].queue.push_back(key);
+        }
+
+        if (searches.size() == 1)
+            return searches[0].term;
+
+        for (;;)
+        {
+            // 还没找完的组（合并过的算一组）只剩一个时就不用再找了
+            int live = -1;
+            bool several = false;
+            for (size_t s = 0; s < searches.size(); ++s)
+            {
+                if (searches[s].head == searches[s].queue.size())
+                    continue;
+
+                int root = findTerm(searches[s].term);
+                if (live >= 0 && live != root)
+                    several = true;
+                live = root;
+            }
+
+            if (!several)
+            {
+                if (live >= 0)
+                    return live;
+
+                size_t best = 0;
+                for (size_t s = 1; s < searches.size(); ++s)
+                {
+                    if (searches[s].found > searches[best].found)
+                        best = s;
+                }
+                return searches[best].term;
+            }
+
+            for (size_t s = 0; s < searches.size(); ++s)
+            {
+                Search& search = searches[s];
+                if (search.head == search.queue.size())
+                    continue;
+
+                int key = search.queue[search.head++];
+                ++search.found;
+
+                linked(key, links);
+                for (size_t j = 0; j < links.size(); ++j)
+                {
+                    if (chunkMark[links[j] >> PIECE_SHIFT] == stamp)
+                        continue;
+
+                    Piece& q = piece(links[j]);
+                    if (q.region != id)
+                        continue;
+
+                    if (q.searchMark != searchStamp)
+                    {
+                        q.searchMark = searchStamp;
+                        q.owner = static_cast<int>(s);
+                        search.queue.push_back(links[j]);
+                    }
+                    else
+                    {
+                        uniteTerms(search.term, searches[q.owner].term);
+                    }
+                }
+            }
+        }
+    }
+
+    // 每组最终的区域：保留能保留的最大的原区域的编号，组内其余的原区域改成这个编号
+    void assignRegions()
+    {
+        classes.clear();
+        for (size_t i = 0; i < borderPieces.size(); ++i)
+            classes.push_back(std::make_pair(findTerm(piece(borderPieces[i].second).term), static_cast<int>(i)));
+        for (size_t i = 0; i < newPieces.size(); ++i)
+            classes.push_back(std::make_pair(findTerm(piece(newPieces[i]).term), -1 - static_cast<int>(i)));
+        std::sort(classes.begin(), classes.end());
+
+        for (size_t i = 0; i < classes.size(); )
+        {
+            size_t end = i;
+            while (end < classes.size() && classes[end].first == classes[i].first)
+                ++end;
+
+            int root = classes[i].first;
+
+            // 先从组内块外的碎片原来的区域中选保留的编号
+            int id = -1;
+            for (size_t j = i; j < end; ++j)
+            {
+                if (classes[j].second < 0)
+                    continue;
+
+                int old = borderPieces[classes[j].second].first;
+                if (findTerm(keeper[old]) == root && (id < 0 || regions[old].size > regions[id].size))
+                    id = old;
+            }
+            if (id < 0)
+            {
+                int key = classes[i].second >= 0 ? borderPieces[classes[i].second].second
+                    : newPieces[-1 - classes[i].second];
+                id = allocRegion(piece(key).terrain);
+            }
+
+            for (size_t j = i; j < end; ++j)
+            {
+                if (classes[j].second < 0)
+                {
+                    Piece& p = piece(newPieces[-1 - classes[j].second]);
+                    p.region = id;
+                    addPiece(id, p);
+                    continue;
+                }
+
+                int old = borderPieces[classes[j].second].first;
+                if (old != id)
+                    relabel(borderPieces[classes[j].second].second, old, id);
+            }
+            i = end;
+        }
+    }
+
+    // 从块外的碎片 key 出发，把相连的、还是原区域 from 的块外碎片改成区域 to
+    void relabel(int key, int from, int to)
+    {
+        if (piece(key).region != from)
+            return;
+
+        if (regionMark[from] != stamp)
+        {
+            regionMark[from] = stamp;
+            emptied.push_back(from);
+        }
+
+        stack.assign(1, key);
+        moveTo(piece(key), to);
+        while (!stack.empty())
+        {
+            int v = stack.back();
+            stack.pop_back();
+
+            linked(v, links);
+            for (size_t j = 0; j < links.size(); ++j)
+            {
+                Piece& q = piece(links[j]);
+                if (chunkMark[links[j] >> PIECE_SHIFT] == stamp || q.region != from)
+                    continue;
+                moveTo(q, to);
+                stack.push_back(links[j]);
+            }
+        }
+    }
+
+    void moveTo(Piece& p, int to)
+    {
+        removePiece(p.region, p);
+        p.region = to;
+        addPiece(to, p);
+    }
+
+    Map& map;
+    ChunkWatcher<Map> watcher;
+    std::vector<ChunkSites> chunks;
+
+    std::vector<TerrainRegion> regions;
+    std::vector<int> freeRegions;
+
+    // build() 用：按块行分段，碎片的全局编号和并查集
+    std::vector<int> bands, base, parent;
+    volatile long pending;
+    Event finished;
+
+    // update() 用
+    std::vector<int> changed, chunkMark, regionMark, keeper, emptied;
+    std::vector<int> terms;                             // 分组的并查集
+    std::vector<int> newPieces;                         // 换掉的块里的新碎片
+    std::vector<std::pair<int, int> > borderPieces;     // 块外贴着的碎片：(原来的区域, key)
+    std::vector<std::pair<int, int> > classes, pairs;
+    std::vector<int> stack, links;
+    std::vector<Search> searches;
+    int stamp, searchStamp;
+};
+
+#endif
@@ -0,0 +1,266 @@
+/*
+** 地图元件集
+**
+** author : gouki04 2011-12-30
+*/
+
+#include "TileSet.h"
+#include "TileMesh.h"
+
+#include <stdio.h>
+#include <string.h>
+
+HGE* TileSet::hge = 0;
+
+namespace
+{
+    // 未压缩 A8R8G8B8 格式的 DDS 文件头，前面还有4字节的 "DDS "
+    struct DdsHeader
+    {
+        DWORD size, flags, height, width, pitch, depth, mipMapCount;
+        DWORD reserved1[11];
+        DWORD pfSize, pfFlags, pfFourCC, pfBitCount, pfRMask, pfGMask, pfBMask, pfAMask;
+        DWORD caps, caps2, caps3, caps4, reserved2;
+    };
+
+    // pitch 是一行的像素数
+    TileFill classifyPixels(const DWORD* pixels, int w, int h, int pitch)
+    {
+        DWORD first = pixels[0];
+        bool transparent = true, uniform = true;
+
+        for (int y = 0; y < h; ++y)
+        {
+            const DWORD* row = pixels + y * pitch;
+            for (int x = 0; x < w; ++x)
+            {
+                if (row[x] >> 24)
+                    transparent = false;
+                if (row[x] != first)
+                    uniform = false;
+            }
+
+            if (!transparent && !uniform)
+                return TILE_FILL_NONE;
+        }
+
+        return transparent ? TILE_FILL_EMPTY : TILE_FILL_SOLID;
+    }
+
+    // 各分量分别平均
+    DWORD averagePixels(const DWORD* pixels, int w, int h, int pitch)
+    {
+        unsigned long sum[4] = { 0, 0, 0, 0 };
+        for (int y = 0; y < h; ++y)
+        {
+            const DWORD* row = pixels + y * pitch;
+            for (int x = 0; x < w; ++x)
+            {
+                for (int k = 0; k < 4; ++k)
+                    sum[k] += (row[x] >> (k * 8)) & 0xFF;
+            }
+        }
+
+        unsigned long n = static_cast<unsigned long>(w) * h;
+        DWORD color = 0;
+        for (int k = 0; k < 4; ++k)
+            color |= static_cast<DWORD>(sum[k] / n) << (k * 8);
+        return color;
+    }
+}
+
+TileSet::TileSet() : tex(0), mipTex(0), texWidth(1.f), texHeight(1.f)
+{
+    hge = hgeCreate(HGE_VERSION);
+}
+
+TileSet::~TileSet()
+{
+    hge->Release();
+}
+
+void TileSet::freeMipmaps()
+{
+    if (mipTex)
+        hge->Texture_Free(mipTex);
+    mipTex = 0;
+}
+
+void TileSet::clear()
+{
+    u0s.clear();
+    v0s.clear();
+    u1s.clear();
+    v1s.clear();
+    fills.clear();
+    colors.clear();
+}
+
+void TileSet::setTexture(HTEXTURE texture, int width, int height)
+{
+    clear();
+    freeMipmaps();
+
+    tex = texture;
+    texWidth = static_cast<float>(width > 0 ? width : 1);
+    texHeight = static_cast<float>(height > 0 ? height : 1);
+}
+
+void TileSet::setTile(int index, float x, float y, float w, float h)
+{
+    if (index >= count())
+    {
+        u0s.resize(index + 1, 0.f);
+        v0s.resize(index + 1, 0.f);
+        u1s.resize(index + 1, 0.f);
+        v1s.resize(index + 1, 0.f);
+        fills.resize(index + 1, TILE_FILL_NONE);
+        colors.resize(index + 1, 0xFFFFFFFF);
+    }
+
+    u0s[index] = x / texWidth;
+    v0s[index] = y / texHeight;
+    u1s[index] = (x + w) / texWidth;
+    v1s[index] = (y + h) / texHeight;
+}
+
+int TileSet::addTile(float x, float y, float w, float h)
+{
+    int index = count();
+    setTile(index, x, y, w, h);
+    return index;
+}
+
+bool TileSet::loadGrid(HTEXTURE texture, int n, int tileW, int tileH, int x0, int y0, int columns, int spacing)
+{
+    if (!texture || n <= 0 || tileW <= 0 || tileH <= 0)
+        return false;
+
+    int width = hge->Texture_GetWidth(texture);
+    int height = hge->Texture_GetHeight(texture);
+    setTexture(texture, width, height);
+
+    if (columns <= 0)
+        columns = (hge->Texture_GetWidth(texture, true) - x0 + spacing) / (tileW + spacing);
+    if (columns <= 0)
+        return false;
+
+    for (int i = 0; i < n; ++i)
+    {
+        int x = x0 + (i % columns) * (tileW + spacing);
+        int y = y0 + (i / columns) * (tileH + spacing);
+        addTile(static_cast<float>(x), static_cast<float>(y),
+            static_cast<float>(tileW), static_cast<float>(tileH));
+    }
+
+    classifyTiles();
+    return true;
+}
+
+bool TileSet::loadLayout(HTEXTURE texture, const char* layoutFile)
+{
+    if (!texture)
+        return false;
+
+    DWORD size = 0;
+    char* data = static_cast<char*>(hge->Resource_Load(layoutFile, &size));
+    if (!data)
+        return false;
+
+    // 复制一份以0结尾的文本
+    std::vector<char> text(data, data + size);
+    text.push_back(0);
+    hge->Resource_Free(data);
+
+    setTexture(texture, hge->Texture_GetWidth(texture), hge->Texture_GetHeight(texture));
+
+    char* line = &text[0];
+    while (line && *line)
+    {
+        char* next = strchr(line, '\n');
+        if (next) *next++ = 0;
+
+        int index;
+        float x, y, w, h;
+        if (line[0] != '#' && sscanf(line, "%d %f %f %f %f", &index, &x, &y, &w, &h) == 5 && index >= 0)
+            setTile(index, x, y, w, h);
+
+        line = next;
+    }
+
+    classifyTiles();
+    return count() > 0;
+}
+
+bool TileSet::createMipmaps()
+{
+    if (mipTex)
+        return true;
+    if (!tex)
+        return false;
+
+    int width = hge->Texture_GetWidth(tex);
+    int height = hge->Texture_GetHeight(tex);
+    const DWORD* pixels = hge->Texture_Lock(tex, true);
+    if (!pixels)
+        return false;
+
+    // 在内存中拼出一个没有 mipmap 的 DDS 文件，Texture_Load 加载时会生成完整的 mipmap 链
+    DdsHeader header;
+    memset(&header, 0, sizeof(header));
+    header.size = sizeof(DdsHeader);
+    header.flags = 0x100F;          // CAPS | HEIGHT | WIDTH | PITCH | PIXELFORMAT
+    header.height = height;
+    header.width = width;
+    header.pitch = width * sizeof(DWORD);
+    header.pfSize = 32;
+    header.pfFlags = 0x41;          // RGB | ALPHAPIXELS
+    header.pfBitCount = 32;
+    header.pfRMask = 0x00FF0000;
+    header.pfGMask = 0x0000FF00;
+    header.pfBMask = 0x000000FF;
+    header.pfAMask = 0xFF000000;
+    header.caps = 0x1000;           // TEXTURE
+
+    size_t pixelBytes = static_cast<size_t>(width) * height * sizeof(DWORD);
+    std::vector<char> file(4 + sizeof(header) + pixelBytes);
+    memcpy(&file[0], "DDS ", 4);
+    memcpy(&file[4], &header, sizeof(header));
+    memcpy(&file[4 + sizeof(header)], pixels, pixelBytes);
+
+    hge->Texture_Unlock(tex);
+
+    mipTex = hge->Texture_Load(&file[0], static_cast<DWORD>(file.size()), true);
+    return mipTex != 0;
+}
+
+void TileSet::classifyTiles()
+{
+    fills.assign(count(), TILE_FILL_NONE);
+    colors.assign(count(), 0xFFFFFFFF);
+    if (!tex || fills.empty())
+        return;
+
+    int pitch = hge->Texture_GetWidth(tex);
+    int height = hge->Texture_GetHeight(tex);
+    const DWORD* pixels = hge->Texture_Lock(tex, true);
+    if (!pixels)
+        return;
+
+    for (int i = 0; i < count(); ++i)
+    {
+        // UV换回像素矩形
+        int x1 = static_cast<int>(u0s[i] * texWidth + 0.5f), x2 = static_cast<int>(u1s[i] * texWidth + 0.5f);
+        int y1 = static_cast<int>(v0s[i] * texHeight + 0.5f), y2 = static_cast<int>(v1s[i] * texHeight + 0.5f);
+        if (x1 < 0 || y1 < 0 || x2 > pitch || y2 > height || x1 >= x2 || y1 >= y2)
+            continue;
+
+        fills[i] = static_cast<unsigned char>(classifyPixels(pixels + y1 * pitch + x1, x2 - x1, y2 - y1, pitch));
+        colors[i] = averagePixels(pixels + y1 * pitch + x1, x2 - x1, y2 - y1, pitch);
+
+        if (fills[i] == TILE_FILL_NONE && x1 == 0 && y1 == 0 && x2 == pitch && y2 == height)
+            fills[i] = TILE_FILL_WRAP;
+    }
+
+    hge->Texture_Unlock(tex);
+}
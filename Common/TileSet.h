@@ -0,0 +1,88 @@
+/*
+** 地图元件集
+** 只记录一张纹理和每个元件在纹理上的UV矩形，不再为每个元件创建 hgeSprite。
+** UV按分量分别存成连续数组（u0[] v0[] u1[] v1[]），绘制时只需要顺序读这几个数组。
+** 另外记录每个元件的填充方式（空白、单色等，见 TileMesh.h），绘制时用来合并相同的元件。
+** 缩小显示时需要带 mipmap 的纹理，createMipmaps() 按原纹理的像素创建一份，UV不变。
+**
+** 元件在纹理上的排列可以是规则网格（loadGrid），也可以由描述文件任意指定（loadLayout）。
+**
+** author : gouki04 2011-12-30
+*/
+
+#ifndef TILESET_H
+#define TILESET_H
+
+#include "..\hge\hge.h"
+
+#include <vector>
+
+class TileSet
+{
+public:
+    TileSet();
+    ~TileSet();
+
+    void clear();
+
+    // 设置元件所在的纹理，之后用 addTile() 逐个添加元件
+    void setTexture(HTEXTURE tex, int width, int height);
+
+    // 按像素矩形添加一个元件，返回元件编号
+    int addTile(float x, float y, float w, float h);
+
+    // 从规则网格中切出 count 个元件：从(x0, y0)开始，每个元件 tileW*tileH，
+    // 元件之间间隔 spacing 像素，每行 columns 个（为0时按纹理宽度计算）
+    bool loadGrid(HTEXTURE tex, int count, int tileW, int tileH,
+                  int x0 = 0, int y0 = 0, int columns = 0, int spacing = 0);
+
+    // 从描述文件读取元件排列，文件每行为 "编号 x y w h"，# 开头的行是注释
+    bool loadLayout(HTEXTURE tex, const char* layoutFile);
+
+    // 读取纹理像素得出每个元件的填充方式和平均颜色，用 addTile() 添加完元件后调用
+    // loadGrid() 和 loadLayout() 会自动调用
+    void classifyTiles();
+
+    HTEXTURE texture() const { return tex; }
+
+    // 创建带完整 mipmap 链的纹理副本，已经创建过时直接返回
+    bool createMipmaps();
+
+    // 释放 mipmap 纹理，必须在 System_Shutdown() 之前调用（全局对象析构时 HGE 的纹理已经释放了）
+    void release() { freeMipmaps(); }
+
+    // 缩小绘制时使用的纹理，没有创建 mipmap 时就是原纹理
+    HTEXTURE mipTexture() const { return mipTex ? mipTex : tex; }
+    int count() const { return static_cast<int>(u0s.size()); }
+
+    // 元件的UV矩形
+    const float* u0() const { return &u0s[0]; }
+    const float* v0() const { return &v0s[0]; }
+    const float* u1() const { return &u1s[0]; }
+    const float* v1() const { return &v1s[0]; }
+
+    // 元件的 TileFill，没有调用过 classifyTiles() 时都是 TILE_FILL_NONE
+    const unsigned char* fill() const { return &fills[0]; }
+
+    // 元件的平均颜色（小地图用），没有调用过 classifyTiles() 时都是白色
+    const DWORD* color() const { return &colors[0]; }
+
+private:
+    TileSet(const TileSet&);
+    TileSet& operator=(const TileSet&);
+
+    void setTile(int index, float x, float y, float w, float h);
+    void freeMipmaps();
+
+    static HGE* hge;
+
+    HTEXTURE tex;
+    HTEXTURE mipTex;    // 由元件集创建和释放
+    float texWidth, texHeight;
+
+    std::vector<float> u0s, v0s, u1s, v1s;
+    std::vector<unsigned char> fills;
+    std::vector<DWORD> colors;
+};
+
+#endif
@@ -0,0 +1,270 @@
+/*
+** 地图的区域统计
+** 每个地图块在入池时统计一次块内的格子：为1的位数（简单模式和魔兽模式下就是地形角的个数）、
+** 最小值和最大值。SummaryTree 以块为叶子，逐级把 2*2 个节点合并成上一级，
+** 修改一个块只需要重算它到根的 O(log n) 个节点。
+**
+** 查询矩形区域时从根往下走，完全在区域内的节点直接累加，所有格子都相同的节点按面积直接算出，
+** 只有区域边缘跨过的、内容不一致的块才逐格统计，
+** 所以与块对齐的区域（例如一张 LOD 图像覆盖的块）查询是 O(log n) 的。
+**
+** author : gouki04 2011-12-30
+*/
+
+#ifndef TILESUMMARY_H
+#define TILESUMMARY_H
+
+#include <vector>
+
+// 一个区域内格子的统计
+template <typename T>
+struct TileSummary
+{
+    int bits;               // 为1的位数
+    T minValue, maxValue;   // 没有格子时 minValue > maxValue
+
+    static TileSummary none()
+    {
+        TileSummary s;
+        s.bits = 0;
+        s.minValue = static_cast<T>(~T());
+        s.maxValue = T();
+        return s;
+    }
+
+    // n 个值都是 value 的格子
+    static TileSummary uniform(T value, int n)
+    {
+        TileSummary s;
+        s.bits = bitCount(value) * n;
+        s.minValue = s.maxValue = value;
+        return s;
+    }
+
+    static TileSummary of(const T* cells, int n)
+    {
+        TileSummary s = none();
+        for (int i = 0; i < n; ++i)
+            s.addCell(cells[i]);
+        return s;
+    }
+
+    // 区域内没有地形（所有格子都是0，或者区域内没有格子）
+    bool empty() const { return maxValue == T(); }
+
+    // 区域内所有格子都相同
+    bool isUniform() const { return minValue == maxValue; }
+
+    void addCell(T value)
+    {
+        bits += bitCount(value);
+        if (value < minValue) minValue = value;
+        if (value > maxValue) maxValue = value;
+    }
+
+    void add(const TileSummary& other)
+    {
+        bits += other.bits;
+        if (other.minValue < minValue) minValue = other.minValue;
+        if (other.maxValue > maxValue) maxValue = other.maxValue;
+    }
+
+    static int bitCount(unsigned int value)
+    {
+        int n = 0;
+        for (; value; value &= value - 1)
+            ++n;
+        return n;
+    }
+};
+
+// 以地图块为叶子的统计金字塔，第 level 级的节点 (r, c) 覆盖从第 (r << level) 行、第 (c << level) 列开始的块
+// 叶子只保存块的指针，块由使用者持有引用，换掉或修改叶子上的块之后要调用 set()
+template <typename Chunk>
+class SummaryTree
+{
+public:
+    typedef typename Chunk::ValueType ValueType;
+    typedef TileSummary<ValueType> Summary;
+
+    SummaryTree() : rowCount(0), colCount(0) {}
+
+    // rows*cols 个元件的地图，叶子全部为空，之后用 setLeaf() 填入所有块再调用 rebuild()
+    void reset(int rows, int cols)
+    {
+        rowCount = rows;
+        colCount = cols;
+
+        int chunkRows = (rows + Chunk::MASK) >> Chunk::SHIFT;
+        int chunkCols = (cols + Chunk::MASK) >> Chunk::SHIFT;
+        leaves.assign(chunkRows * chunkCols, static_cast<const Chunk*>(0));
+
+        levels.clear();
+        levelRows.clear();
+        levelCols.clear();
+        for (;;)
+        {
+            levels.push_back(std::vector<Summary>(chunkRows * chunkCols, Summary::none()));
+            levelRows.push_back(chunkRows);
+            levelCols.push_back(chunkCols);
+            if (chunkRows <= 1 && chunkCols <= 1)
+                break;
+
+            chunkRows = (chunkRows + 1) >> 1;
+            chunkCols = (chunkCols + 1) >> 1;
+        }
+    }
+
+    int levelCount() const { return static_cast<int>(levels.size()); }
+
+    // 只改叶子，不更新上级节点
+    void setLeaf(int cr, int cc, const Chunk* chunk)
+    {
+        int i = cr * levelCols[0] + cc;
+        leaves[i] = chunk;
+        levels[0][i] = leafSummary(cr, cc);
+    }
+
+    // 从叶子开始重算所有节点
+    void rebuild()
+    {
+        for (int level = 1; level < levelCount(); ++level)
+        {
+            for (int r = 0; r < levelRows[level]; ++r)
+                for (int c = 0; c < levelCols[level]; ++c)
+                    update(level, r, c);
+        }
+    }
+
+    // 换掉一个叶子，重算它的所有上级节点
+    void set(int cr, int cc, const Chunk* chunk)
+    {
+        setLeaf(cr, cc, chunk);
+        for (int level = 1; level < levelCount(); ++level)
+        {
+            cr >>= 1;
+            cc >>= 1;
+            update(level, cr, cc);
+        }
+    }
+
+    // 整张地图
+    const Summary& total() const { return levels.back()[0]; }
+
+    // 超过最高一级时返回根节点
+    const Summary& node(int level, int r, int c) const
+    {
+        if (level >= levelCount())
+            return total();
+        return levels[level][r * levelCols[level] + c];
+    }
+
+    // 第 r1 ~ r2 行、第 c1 ~ c2 列（不包含 r2, c2）的元件，超出地图的部分不算
+    Summary query(int r1, int c1, int r2, int c2) const
+    {
+        if (r1 < 0) r1 = 0;
+        if (c1 < 0) c1 = 0;
+        if (r2 > rowCount) r2 = rowCount;
+        if (c2 > colCount) c2 = colCount;
+
+        Summary s = Summary::none();
+        if (r1 < r2 && c1 < c2 && !levels.empty())
+            query(levelCount() - 1, 0, 0, r1, c1, r2, c2, s);
+        return s;
+    }
+
+    bool empty(int r1, int c1, int r2, int c2) const { return query(r1, c1, r2, c2).empty(); }
+
+private:
+    // 节点覆盖的元件范围，已经裁剪到地图内
+    void nodeTiles(int level, int r, int c, int& y1, int& x1, int& y2, int& x2) const
+    {
+        int shift = level + Chunk::SHIFT;
+        y1 = r << shift;
+        x1 = c << shift;
+        y2 = (r + 1) << shift;
+        x2 = (c + 1) << shift;
+        if (y2 > rowCount) y2 = rowCount;
+        if (x2 > colCount) x2 = colCount;
+    }
+
+    // 地图边缘的块只统计地图内的格子，还没有入池的块没有统计，也要逐格统计
+    Summary leafSummary(int cr, int cc) const
+    {
+        const Chunk* chunk = leaves[cr * levelCols[0] + cc];
+        if (!chunk)
+            return Summary::none();
+
+        int y1, x1, y2, x2;
+        nodeTiles(0, cr, cc, y1, x1, y2, x2);
+        if (chunk->shared && y2 - y1 == Chunk::SIZE && x2 - x1 == Chunk::SIZE)
+            return chunk->summary;
+
+        return scan(chunk, y1, x1, y2, x2);
+    }
+
+    // 逐格统计块内的一部分，坐标是地图上的元件坐标
+    static Summary scan(const Chunk* chunk, int r1, int c1, int r2, int c2)
+    {
+        Summary s = Summary::none();
+        for (int r = r1; r < r2; ++r)
+            for (int c = c1; c < c2; ++c)
+                s.addCell(chunk->get(r & Chunk::MASK, c & Chunk::MASK));
+        return s;
+    }
+
+    void update(int level, int r, int c)
+    {
+        Summary s = Summary::none();
+        const std::vector<Summary>& below = levels[level - 1];
+        int rows = levelRows[level - 1], cols = levelCols[level - 1];
+
+        for (int y = r * 2; y < r * 2 + 2 && y < rows; ++y)
+            for (int x = c * 2; x < c * 2 + 2 && x < cols; ++x)
+                s.add(below[y * cols + x]);
+
+        levels[level][r * levelCols[level] + c] = s;
+    }
+
+    void query(int level, int r, int c, int r1, int c1, int r2, int c2, Summary& out) const
+    {
+        int y1, x1, y2, x2;
+        nodeTiles(level, r, c, y1, x1, y2, x2);
+        if (y2 <= r1 || y1 >= r2 || x2 <= c1 || x1 >= c2)
+            return;
+
+        const Summary& s = levels[level][r * levelCols[level] + c];
+        if (r1 <= y1 && c1 <= x1 && y2 <= r2 && x2 <= c2)
+        {
+            out.add(s);
+            return;
+        }
+
+        // 节点内所有格子都相同时，部分区域的统计可以直接算出
+        int h = (y2 < r2 ? y2 : r2) - (y1 > r1 ? y1 : r1);
+        int w = (x2 < c2 ? x2 : c2) - (x1 > c1 ? x1 : c1);
+        if (s.isUniform())
+        {
+            out.add(Summary::uniform(s.minValue, h * w));
+            return;
+        }
+
+        if (level == 0)
+        {
+            out.add(scan(leaves[r * levelCols[0] + c], y1 > r1 ? y1 : r1, x1 > c1 ? x1 : c1,
+                y2 < r2 ? y2 : r2, x2 < c2 ? x2 : c2));
+            return;
+        }
+
+        for (int y = r * 2; y < r * 2 + 2 && y < levelRows[level - 1]; ++y)
+            for (int x = c * 2; x < c * 2 + 2 && x < levelCols[level - 1]; ++x)
+                query(level - 1, y, x, r1, c1, r2, c2, out);
+    }
+
+    int rowCount, colCount;
+    std::vector<const Chunk*> leaves;
+    std::vector<std::vector<Summary> > levels;  // levels[0] 是叶子，最后一级只有一个节点
+    std::vector<int> levelRows, levelCols;
+};
+
+#endif
@@ -0,0 +1,159 @@
+/*
+** 时间线记录
+**
+** author : gouki04 2011-12-30
+*/
+
+#include "TraceRecorder.h"
+
+#include <stdio.h>
+
+volatile bool TraceRecorder::on = false;
+Mutex TraceRecorder::mutex;
+std::vector<TraceRecorder::Buffer*> TraceRecorder::buffers;
+
+namespace
+{
+    // 当前线程的缓冲，第一次记录时创建
+    THREAD_LOCAL void* localBuffer = 0;
+
+    // 输出JSON字符串，名字都是代码里的常量，只需要处理引号和反斜杠
+    void writeString(FILE* file, const char* s)
+    {
+        fputc('"', file);
+        for (; *s; ++s)
+        {
+            if (*s == '"' || *s == '\\')
+                fputc('\\', file);
+            fputc(*s, file);
+        }
+        fputc('"', file);
+    }
+}
+
+TraceRecorder::Buffer* TraceRecorder::createBuffer(const char* name)
+{
+    ScopedLock lock(mutex);
+
+    // 缓冲只能有一个线程在写，同名的线程还在运行时另建一个
+    if (name)
+    {
+        for (size_t i = 0; i < buffers.size(); ++i)
+        {
+            if (buffers[i]->name == name && !buffers[i]->owned)
+            {
+                buffers[i]->owned = true;
+                return buffers[i];
+            }
+        }
+    }
+
+    Buffer* buffer = new Buffer;
+    buffer->tid = static_cast<int>(buffers.size()) + 1;
+    buffer->written = 0;
+    buffer->owned = true;
+
+    if (name)
+    {
+        buffer->name = name;
+    }
+    else
+    {
+        char defaultName[32];
+        sprintf(defaultName, "thread %d", buffer->tid);
+        buffer->name = defaultName;
+    }
+
+    // 缓冲在程序结束前一直保留，线程退出后记录仍然可以输出
+    buffers.push_back(buffer);
+    return buffer;
+}
+
+TraceRecorder::Buffer* TraceRecorder::threadBuffer()
+{
+    if (!localBuffer)
+        localBuffer = createBuffer(0);
+    return static_cast<Buffer*>(localBuffer);
+}
+
+void TraceRecorder::setThreadName(const char* name)
+{
+    threadExit();
+    localBuffer = createBuffer(name);
+}
+
+void TraceRecorder::threadExit()
+{
+    if (!localBuffer)
+        return;
+
+    ScopedLock lock(mutex);
+    static_cast<Buffer*>(localBuffer)->owned = false;
+    localBuffer = 0;
+}
+
+void TraceRecorder::record(const char* name, double start, double end, int row, int col)
+{
+    Buffer* buffer = threadBuffer();
+
+    long n = buffer->written;
+    Event& e = buffer->events[n % TRACE_BUFFER_EVENTS];
+    e.name = name;
+    e.start = start;
+    e.end = end;
+    e.row = row;
+    e.col = col;
+
+    // 先写完记录再公开，dump() 只读取已经公开的部分
+    atomicStore(&buffer->written, n + 1);
+}
+
+bool TraceRecorder::dump(const char* path)
+{
+    FILE* file = fopen(path, "w");
+    if (!file)
+        return false;
+
+    ScopedLock lock(mutex);
+
+    fprintf(file, "{\"traceEvents\":[\n");
+
+    bool first = true;
+    for (size_t b = 0; b < buffers.size(); ++b)
+    {
+        Buffer* buffer = buffers[b];
+
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":",
+            first ? "" : ",\n", buffer->tid);
+        writeString(file, buffer->name.c_str());
+        fprintf(file, "}}");
+        first = false;
+
+        long end = atomicLoad(&buffer->written);
+        long begin = end > TRACE_BUFFER_EVENTS ? end - TRACE_BUFFER_EVENTS : 0;
+
+        for (long i = begin; i < end; ++i)
+        {
+            Event e = buffer->events[i % TRACE_BUFFER_EVENTS];
+
+            // 所属线程可能正在覆盖最旧的记录，拷贝之后再检查一次，被覆盖了就丢掉
+            if (atomicLoad(&buffer->written) - i >= TRACE_BUFFER_EVENTS)
+                continue;
+
+            fprintf(file, ",\n{\"name\":");
+            writeString(file, e.name);
+            fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+                buffer->tid, e.start * 1e6, (e.end - e.start) * 1e6);
+
+            if (e.row != -1 || e.col != -1)
+                fprintf(file, ",\"args\":{\"row\":%d,\"col\":%d}", e.row, e.col);
+
+            fprintf(file, "}");
+        }
+    }
+
+    fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    fclose(file);
+
+    return true;
+}
@@ -0,0 +1,100 @@
+/*
+** 时间线记录
+** 用 TRACE_SCOPE / TRACE_SCOPE_AT 标记代码段，每个线程写自己的环形缓冲，写入时不加锁；
+** dump() 把所有线程最近的记录输出成 Chrome trace 格式的 JSON，可以在 chrome://tracing 或 Perfetto 中打开。
+**
+** 关闭时每个标记点只多一次判断；定义 TILE_NO_PROFILER 时标记完全不生成代码。
+**
+** author : gouki04 2011-12-30
+*/
+
+#ifndef TRACERECORDER_H
+#define TRACERECORDER_H
+
+#include <string>
+#include <vector>
+
+#include "Platform.h"
+
+#define TRACE_BUFFER_EVENTS 8192    // 每个线程保留最近多少条记录
+
+class TraceRecorder
+{
+public:
+    static void setEnabled(bool enable) { on = enable; }
+    static bool enabled() { return on; }
+
+    // 给当前线程命名。已经调用过 threadExit() 的同名线程的缓冲会被接着使用（比如退出后重新启动的工作线程），
+    // 同名的线程同时运行时（比如两个编辑器各自的工作线程）各用各的缓冲
+    static void setThreadName(const char* name);
+
+    // 线程退出前调用，把缓冲交给之后同名的线程；之后这个线程再记录时会另建一个缓冲
+    static void threadExit();
+
+    // 记录一段 [start, end)，单位为秒；row、col 不为 -1 时作为参数一起输出
+    static void record(const char* name, double start, double end, int row = -1, int col = -1);
+
+    // 输出到文件
+    static bool dump(const char* path);
+
+private:
+    struct Event
+    {
+        const char* name;   // 必须是常量字符串
+        double start, end;
+        int row, col;
+    };
+
+    struct Buffer
+    {
+        std::string name;
+        int tid;
+        Event events[TRACE_BUFFER_EVENTS];
+        volatile long written;  // 写入过的总条数，只由所属线程增加
+        bool owned;             // 是否有正在运行的线程在写，由 mutex 保护
+    };
+
+    static Buffer* threadBuffer();
+    static Buffer* createBuffer(const char* name);
+
+    static volatile bool on;
+    static Mutex mutex;                 // 只保护 buffers 列表和 owned
+    static std::vector<Buffer*> buffers;
+};
+
+// 作用域记录
+class TraceScope
+{
+public:
+    TraceScope(const char* n, int r = -1, int c = -1) : name(n), row(r), col(c), start(0)
+    {
+        if (TraceRecorder::enabled())
+            start = getTicks();
+    }
+
+    ~TraceScope()
+    {
+        if (start != 0)
+            TraceRecorder::record(name, start, getTicks(), row, col);
+    }
+
+private:
+    TraceScope(const TraceScope&);
+    TraceScope& operator=(const TraceScope&);
+
+    const char* name;
+    int row, col;
+    double start;
+};
+
+#ifdef TILE_NO_PROFILER
+#define TRACE_SCOPE(name)
+#define TRACE_SCOPE_AT(name, row, col)
+#else
+#define TRACE_SCOPE_NAME2(line) traceScope##line
+#define TRACE_SCOPE_NAME(line) TRACE_SCOPE_NAME2(line)
+#define TRACE_SCOPE(name) TraceScope TRACE_SCOPE_NAME(__LINE__)(name)
+#define TRACE_SCOPE_AT(name, row, col) TraceScope TRACE_SCOPE_NAME(__LINE__)(name, row, col)
+#endif
+
+#endif
@@ -0,0 +1,170 @@
+/*
+** 地形元胞自动机的性能测试
+**   check : 小地图上每一步都与逐个顶点计算的结果相同，与线程数无关；
+**           只重算变了的块之后的地图与整张 retile() 的结果相同
+**   load  : 从地图读出顶点网格
+**   step  : 每一步的耗时、变化的顶点数和累计要重算的块数
+**   store : 重算变了的块并 commit()
+**
+** author : gouki04 2011-12-30
+*/
+
+#include "Automaton.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+#include "../Common/JobScheduler.h"
+#include "../Common/Platform.h"
+#include "../Common/TileAutomaton.h"
+#include "../Common/TileChunk.h"
+#include "../Common/TileGen.h"
+
+#define AUTOMATON_CHECK_ROWS 300    // 检查用的地图大小，不是块大小的整数倍
+#define AUTOMATON_CHECK_COLS 301
+#define AUTOMATON_CHECK_STEPS 6     // 每种规则检查的步数
+
+namespace
+{
+    typedef ChunkMap<unsigned char> Map;
+
+    bool sameGrid(const CornerGrid& a, const CornerGrid& b)
+    {
+        for (int r = 0; r < a.rows(); ++r)
+        {
+            if (memcmp(a.row(r), b.row(r), a.wordsPerRow() * sizeof(unsigned int)) != 0)
+                return false;
+        }
+        return true;
+    }
+
+    // 逐个顶点数邻居的参照实现
+    void referenceStep(const CornerGrid& from, CornerGrid& to, const AutomatonRule& rule)
+    {
+        to.resize(from.rows(), from.cols());
+        for (int r = 0; r < from.rows(); ++r)
+        {
+            for (int c = 0; c < from.cols(); ++c)
+            {
+                int n = 0;
+                for (int dr = -1; dr <= 1; ++dr)
+                {
+                    for (int dc = -1; dc <= 1; ++dc)
+                    {
+                        int nr = r + dr, nc = c + dc;
+                        if ((dr || dc) && nr >= 0 && nr < from.rows() && nc >= 0 && nc < from.cols() && from.get(nr, nc))
+                            ++n;
+                    }
+                }
+                unsigned int set = from.get(r, c) ? rule.survive : rule.birth;
+                to.set(r, c, (set >> n) & 1);
+            }
+        }
+    }
+
+    template <typename M>
+    bool checkMap(const CornerGrid& start, JobScheduler* jobs)
+    {
+        M map(start.rows() - 1, start.cols() - 1);
+        retileChunks(map, start, jobs);
+
+        TerrainAutomaton automaton(jobs);
+        automaton.load(map);
+        if (!sameGrid(automaton.corners(), start))
+        {
+            printf("check  : load() differs from the generated corners\n");
+            return false;
+        }
+
+        CornerGrid expected = start, next;
+        for (int rule = 0; rule < AUTOMATON_RULES; ++rule)
+        {
+            for (int i = 0; i < AUTOMATON_CHECK_STEPS; ++i)
+            {
+                referenceStep(expected, next, automatonRule(rule));
+                std::swap(expected, next);
+                automaton.step(automatonRule(rule));
+                if (!sameGrid(automaton.corners(), expected))
+                {
+                    printf("check  : rule %d step %d differs from the reference\n", rule, i + 1);
+                    return false;
+                }
+            }
+
+            // 隔一种规则写回一次，另外几步的变化累积到下一次
+            if (rule != AUTOMATON_ERODE)
+            {
+                automaton.store(map);
+                map.commit();
+
+                M full(map.rows(), map.cols());
+                retile(full, expected);
+                full.commit();
+                if (full.contentHash() != map.contentHash())
+                {
+                    printf("check  : stored chunks differ from retile() after rule %d\n", rule);
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    bool check(JobScheduler& jobs)
+    {
+        TerrainNoise noise(7);
+        noise.wavelength = 16;
+        noise.octaves = 3;
+        CornerGrid start(AUTOMATON_CHECK_ROWS + 1, AUTOMATON_CHECK_COLS + 1);
+        generateCorners(start, noise);
+
+        JobScheduler other(3, "automaton check");
+        if (!checkMap<Map>(start, 0) || !checkMap<Map>(start, &jobs) || !checkMap<Map>(start, &other)
+            || !checkMap<ChunkMap<unsigned char, 4, MortonLayout> >(start, &other)
+            || !checkMap<ChunkMap<unsigned short, 5, RowMajorLayout> >(start, &jobs))
+            return false;
+
+        printf("check  : every step matches the reference with 0, 1, 3 workers, stored map matches retile()\n");
+        return true;
+    }
+}
+
+int runAutomatonBench(int size, int steps)
+{
+    JobScheduler jobs(hardwareThreads(), "automaton");
+
+    if (!check(jobs))
+        return 1;
+
+    TerrainNoise noise(1);
+    noise.wavelength = 64;
+    noise.octaves = 5;
+    Map map(size, size);
+    generateTerrain(map, noise, &jobs);
+
+    printf("map %dx%d, %d workers, smoothing %d steps\n", size, size, jobs.workerCount(), steps);
+
+    TerrainAutomaton automaton(&jobs);
+    double start = getTicks();
+    automaton.load(map);
+    printf("load   : %.1f ms\n", (getTicks() - start) * 1000.0);
+
+    for (int i = 0; i < steps; ++i)
+    {
+        automaton.step(AutomatonRule::smooth());
+        const AutomatonStats& stats = automaton.stats();
+        printf("step %-2d: %.1f ms, %d corners changed, %d chunks pending\n",
+            stats.steps, stats.stepTime * 1000.0, stats.changedCorners, stats.pendingChunks);
+    }
+
+    start = getTicks();
+    automaton.store(map);
+    map.commit();
+    const AutomatonStats& stats = automaton.stats();
+    printf("store  : %.1f ms (%d chunks retiled in %.1f ms)\n", (getTicks() - start) * 1000.0,
+        stats.storedChunks, stats.storeTime * 1000.0);
+    printf("total  : %.1f ms for %d steps, %.1f ms per step\n", stats.totalStepTime * 1000.0, stats.steps,
+        stats.steps ? stats.totalStepTime * 1000.0 / stats.steps : 0.0);
+    return 0;
+}
@@ -0,0 +1,13 @@
+/*
+** 地形元胞自动机的性能测试
+**
+** author : gouki04 2011-12-30
+*/
+
+#ifndef AUTOMATON_H
+#define AUTOMATON_H
+
+// 在 size*size 的生成地形上执行 steps 步平滑，检查结果与逐个顶点的实现相同，测量每一步和写回地图的耗时
+int runAutomatonBench(int size, int steps);
+
+#endif
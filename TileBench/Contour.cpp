@@ -0,0 +1,83 @@
+/*
+** 碰撞轮廓的性能测试
+** 在顶点网格上随机画一些圆形的地形，重算整张地图的掩码之后：
+**   full  : 第一次提取所有块的多边形
+**   scan  : 没有修改时检查一遍所有块（只比较块指针）
+**   edit  : 模拟魔兽模式的拖动绘制，每笔 commit 一次，只重新提取笔画范围内换了的块
+**
+** author : gouki04 2011-12-30
+*/
+
+#include "Contour.h"
+
+#include <stdio.h>
+
+#include "../Common/Platform.h"
+#include "../Common/TileChunk.h"
+#include "../Common/TileContour.h"
+#include "../Common/TileOps.h"
+
+#include "Terrain.h"
+
+#define CONTOUR_DISKS 400           // 随机地形的圆的个数
+#define CONTOUR_MAX_RADIUS 300      // 圆的最大半径（顶点）
+#define CONTOUR_STROKES 1000        // 编辑的笔画数
+#define CONTOUR_STROKE_LENGTH 16    // 每笔经过的顶点数
+
+namespace
+{
+    typedef ChunkMap<unsigned char> Map;
+}
+
+int runContourBench(int size)
+{
+    TerrainRandom rnd(1);
+    Map map(size, size);
+
+    double start = getTicks();
+    {
+        CornerGrid grid(size + 1, size + 1);
+        paintDisks(grid, rnd, CONTOUR_DISKS, CONTOUR_MAX_RADIUS);
+        retile(map, grid);
+        map.commit();
+    }
+    double generate = getTicks() - start;
+
+    ContourSet<Map> contours(map);
+
+    start = getTicks();
+    int extracted = contours.update();
+    double full = getTicks() - start;
+
+    start = getTicks();
+    contours.update();
+    double scan = getTicks() - start;
+
+    printf("map %dx%d, %d chunks, generated in %.1f ms\n", size, size, map.chunkRows() * map.chunkCols(), generate * 1000.0);
+    printf("full : %d chunks extracted in %.1f ms, %d polygons, %d points\n",
+        extracted, full * 1000.0, contours.polygonCount(), contours.pointCount());
+    printf("scan : %.2f ms with no changes\n", scan * 1000.0);
+
+    // 拖动绘制，每笔之后 commit 并更新笔画范围内的块
+    double total = 0, worst = 0;
+    long chunks = 0;
+    for (int s = 0; s < CONTOUR_STROKES; ++s)
+    {
+        int r1, c1, r2, c2;
+        paintStroke(map, rnd, CONTOUR_STROKE_LENGTH, (s & 3) != 3, r1, c1, r2, c2);
+        map.commit();
+
+        start = getTicks();
+        chunks += contours.update(r1, c1, r2, c2);
+        double t = getTicks() - start;
+
+        total += t;
+        if (t > worst) worst = t;
+    }
+
+    printf("edit : %d strokes, %ld chunks re-extracted, %.3f ms average, %.3f ms worst\n",
+        CONTOUR_STROKES, chunks, total * 1000.0 / CONTOUR_STROKES, worst * 1000.0);
+    printf("after edits: %d polygons, %d points\n", contours.polygonCount(), contours.pointCount());
+
+    return 0;
+}
@@ -0,0 +1,13 @@
+/*
+** 碰撞轮廓的性能测试
+**
+** author : gouki04 2011-12-30
+*/
+
+#ifndef CONTOUR_H
+#define CONTOUR_H
+
+// 在 size*size 的随机地形上提取整张地图的碰撞轮廓，再测量每次编辑之后增量更新的耗时
+int runContourBench(int size);
+
+#endif
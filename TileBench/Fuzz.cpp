@@ -0,0 +1,627 @@
+/*
+** 差分模糊测试
+** 把一段字节解释成一个测试用例：地图模式、地图大小和一串鼠标操作（位置、按键、是否在这一帧提交），
+** 同时交给参照实现（Oracle.h，原来 FrameFunc() 的代码）和每一种优化过的实现执行，
+** 每一帧之后逐格比较，任何一格不同就报告出错的实现、帧号和位置。
+** 提交过的帧还会比较地图的区域统计（TileSummary.h）和参照地图逐格数出来的结果，
+** 以及增量更新的碰撞轮廓（TileContour.h）围出来的面积，
+** 和增量修复的导航图（TileNav.h）上的寻路结果与在整个子格网格上直接搜索的结果，
+** 以及增量维护的地形区域（TileRegions.h）与在参照地图的顶点上直接做的填充。
+**
+** 接口与 libFuzzer 相同，定义 TILE_LIBFUZZER 编译这个文件和它用到的 Common 中的源文件即可交给 libFuzzer
+** （不在 Windows 上时再加 -lpthread）：
+**   clang++ -g -O1 -fsanitize=fuzzer,address -DTILE_LIBFUZZER TileBench/Fuzz.cpp
+**       Common/NavGraph.cpp Common/JobScheduler.cpp Common/TraceRecorder.cpp
+** 不使用 libFuzzer 时由 TileBench fuzz 随机生成用例。
+**
+** 新的实现（块大小、块内排列、格子位宽、批量或多线程的绘制路径……）加到 createBackends() 里。
+**
+** author : gouki04 2011-12-30
+*/
+
+#include "Fuzz.h"
+#include "Oracle.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <functional>
+#include <queue>
+#include <vector>
+
+#include "../Common/TileChunk.h"
+#include "../Common/TileContour.h"
+#include "../Common/TileMode.h"
+#include "../Common/TileNav.h"
+#include "../Common/TileOps.h"
+#include "../Common/TileRegions.h"
+
+#define FUZZ_TILE_SHIFT 5                   // 与参照实现的元件大小（32）一致
+#define FUZZ_MAX_SIZE 48                    // 地图最大边长，覆盖不满一块和跨多块的情况
+#define FUZZ_MAX_BYTES 4096                 // 随机用例的最大长度
+#define FUZZ_FAILURE_FILE "fuzz-failure.bin"
+
+namespace
+{
+    // 按顺序读取字节，读完之后返回0
+    struct ByteReader
+    {
+        const unsigned char* data;
+        size_t size;
+        size_t pos;
+
+        ByteReader(const unsigned char* d, size_t n) : data(d), size(n), pos(0) {}
+
+        bool empty() const { return pos >= size; }
+        unsigned int next8() { return pos < size ? data[pos++] : 0; }
+        unsigned int next16() { unsigned int lo = next8(); return lo | (next8() << 8); }
+    };
+
+    // 一帧的操作
+    struct FuzzEdit
+    {
+        int mx, my;         // 相对地图左上角的鼠标位置，可以在地图外
+        bool left, right;
+        bool commit;        // 为 false 时和下一帧的修改一起提交，检查未提交的写时复制块
+    };
+
+    struct FuzzCase
+    {
+        int mode;
+        int rows, cols;
+        std::vector<FuzzEdit> edits;
+    };
+
+    void decode(const unsigned char* data, size_t size, FuzzCase& fc)
+    {
+        ByteReader in(data, size);
+
+        fc.mode = (in.next8() & 1) ? TILEMODE_WARCRAFT : TILEMODE_EASY;
+        fc.rows = static_cast<int>(in.next8() % FUZZ_MAX_SIZE) + 1;
+        fc.cols = static_cast<int>(in.next8() % FUZZ_MAX_SIZE) + 1;
+
+        // 鼠标范围比地图四周各多出两个元件
+        int margin = 2 << FUZZ_TILE_SHIFT;
+        int width = (fc.cols << FUZZ_TILE_SHIFT) + margin * 2;
+        int height = (fc.rows << FUZZ_TILE_SHIFT) + margin * 2;
+
+        while (!in.empty())
+        {
+            FuzzEdit e;
+            e.mx = static_cast<int>(in.next16() % width) - margin;
+            e.my = static_cast<int>(in.next16() % height) - margin;
+
+            unsigned int action = in.next8();
+            e.left = (action & 1) != 0;
+            e.right = (action & 2) != 0;
+            e.commit = (action & 4) == 0;
+            fc.edits.push_back(e);
+        }
+    }
+
+    struct Mismatch
+    {
+        const char* backend;
+        int frame;
+        int row, col;
+        int expected, actual;
+    };
+
+    template <typename Map>
+    bool sameAs(const OracleMap& oracle, const Map& map, int frame, const char* backend, Mismatch& m)
+    {
+        for (int r = 0; r < oracle.rows; ++r)
+        {
+            for (int c = 0; c < oracle.cols; ++c)
+            {
+                int actual = static_cast<int>(map.get(r, c));
+                if (actual != oracle.get(r, c))
+                {
+                    m.backend = backend;
+                    m.frame = frame;
+                    m.row = r;
+                    m.col = c;
+                    m.expected = oracle.get(r, c);
+                    m.actual = actual;
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // 整张地图和一个随帧号变化的矩形（不与块对齐）内为1的位数和最大值，报告的位置是矩形左上角
+    template <typename Map>
+    bool summaryMatches(const OracleMap& oracle, const Map& map, int frame, Mismatch& m)
+    {
+        for (int k = 0; k < 2; ++k)
+        {
+            int r1 = 0, c1 = 0, r2 = oracle.rows, c2 = oracle.cols;
+            if (k == 1)
+            {
+                r1 = frame % oracle.rows;
+                c1 = (frame * 5) % oracle.cols;
+                r2 = r1 + 1 + (frame * 3) % (oracle.rows - r1);
+                c2 = c1 + 1 + (frame * 7) % (oracle.cols - c1);
+            }
+
+            int bits = 0, maxValue = 0;
+            for (int r = r1; r < r2; ++r)
+            {
+                for (int c = c1; c < c2; ++c)
+                {
+                    int value = oracle.get(r, c);
+                    bits += TileSummary<int>::bitCount(value);
+                    if (value > maxValue) maxValue = value;
+                }
+            }
+
+            typename Map::Summaries::Summary s = map.summary().query(r1, c1, r2, c2);
+            if (s.bits != bits || static_cast<int>(s.maxValue) != maxValue)
+            {
+                m.backend = "region summary";
+                m.frame = frame;
+                m.row = r1;
+                m.col = c1;
+                m.expected = s.bits != bits ? bits : maxValue;
+                m.actual = s.bits != bits ? s.bits : static_cast<int>(s.maxValue);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // 碰撞轮廓围出的面积（两倍，单位是半个元件的平方）必须等于每个元件里地形部分的面积之和
+    template <typename Map>
+    bool contourMatches(const OracleMap& oracle, const ContourSet<Map>& contours, int frame, Mismatch& m)
+    {
+        static const int DOUBLE_AREA[16] = { 0, 1, 1, 4, 1, 4, 2, 7, 1, 2, 4, 7, 4, 7, 7, 8 };
+
+        long expected = 0;
+        for (int r = 0; r < oracle.rows; ++r)
+            for (int c = 0; c < oracle.cols; ++c)
+                expected += DOUBLE_AREA[oracle.get(r, c) & 0xF];
+
+        long actual = contours.doubleArea();
+        if (actual == expected)
+            return true;
+
+        m.backend = "collision contours";
+        m.frame = frame;
+        m.row = m.col = -1;
+        m.expected = static_cast<int>(expected);
+        m.actual = static_cast<int>(actual);
+        return false;
+    }
+
+    // 参照的子格网格：地形能走，规则与 NavGraph 相同
+    bool oracleWalkable(const OracleMap& oracle, int y, int x)
+    {
+        return ((oracle.get(y >> 1, x >> 1) >> ((y & 1) * 2 + (x & 1))) & 1) != 0;
+    }
+
+    // 在整个子格网格上的 Dijkstra，走不到时返回 -1
+    int oracleDistance(const OracleMap& oracle, NavPoint from, NavPoint to)
+    {
+        static const int DY[8] = { -1, 1, 0, 0, -1, -1, 1, 1 };
+        static const int DX[8] = { 0, 0, -1, 1, -1, 1, -1, 1 };
+
+        int rows = oracle.rows * 2, cols = oracle.cols * 2;
+        std::vector<int> dist(rows * cols, -1);
+
+        typedef std::pair<int, int> Item;
+        std::priority_queue<Item, std::vector<Item>, std::greater<Item> > queue;
+        dist[from.y * cols + from.x] = 0;
+        queue.push(Item(0, from.y * cols + from.x));
+
+        while (!queue.empty())
+        {
+            Item item = queue.top();
+            queue.pop();
+            if (item.first != dist[item.second])
+                continue;
+
+            int y = item.second / cols, x = item.second % cols;
+            if (y == to.y && x == to.x)
+                return item.first;
+
+            for (int k = 0; k < 8; ++k)
+            {
+                int ny = y + DY[k], nx = x + DX[k];
+                if (ny < 0 || ny >= rows || nx < 0 || nx >= cols || !oracleWalkable(oracle, ny, nx))
+                    continue;
+                if (k >= 4 && (!oracleWalkable(oracle, ny, x) || !oracleWalkable(oracle, y, nx)))
+                    continue;
+
+                int d = item.first + (k < 4 ? NavGraph::COST_STRAIGHT : NavGraph::COST_DIAGONAL);
+                int j = ny * cols + nx;
+                if (dist[j] < 0 || d < dist[j])
+                {
+                    dist[j] = d;
+                    queue.push(Item(d, j));
+                }
+            }
+        }
+        return -1;
+    }
+
+    // 从 seed 对应的子格开始找第一个能走的子格，没有时返回 false
+    bool oracleCell(const OracleMap& oracle, unsigned int seed, NavPoint& p)
+    {
+        int cells = oracle.rows * oracle.cols * 4;
+        for (int i = 0; i < cells; ++i)
+        {
+            int k = static_cast<int>((seed + i) % cells);
+            p.y = k / (oracle.cols * 2);
+            p.x = k % (oracle.cols * 2);
+            if (oracleWalkable(oracle, p.y, p.x))
+                return true;
+        }
+        return false;
+    }
+
+    // 分层寻路：能不能走到必须与参照一致，展开的路径每一步都合法，长度不短于最短路径
+    // 报告的位置是起点子格，期望值是最短距离，实际值是路径长度（走不通为 -1，路径不合法为 -2）
+    bool navMatches(const OracleMap& oracle, NavGraph& nav, int frame, Mismatch& m)
+    {
+        NavPoint start, goal;
+        if (!oracleCell(oracle, frame * 2654435761u, start) || !oracleCell(oracle, frame * 40503u + 17, goal))
+            return true;
+
+        int expected = oracleDistance(oracle, start, goal);
+
+        std::vector<NavPoint> waypoints, path;
+        int actual = -1;
+        if (nav.findPath(start, goal, waypoints))
+        {
+            actual = -2;
+            if (nav.refinePath(waypoints, path) && path.front().y == start.y && path.front().x == start.x
+                && path.back().y == goal.y && path.back().x == goal.x)
+            {
+                actual = 0;
+                for (size_t i = 1; i < path.size() && actual >= 0; ++i)
+                {
+                    int dy = path[i].y - path[i - 1].y, dx = path[i].x - path[i - 1].x;
+                    bool legal = dy >= -1 && dy <= 1 && dx >= -1 && dx <= 1 && (dy || dx)
+                        && oracleWalkable(oracle, path[i].y, path[i].x)
+                        && (!dy || !dx || (oracleWalkable(oracle, path[i].y, path[i - 1].x)
+                            && oracleWalkable(oracle, path[i - 1].y, path[i].x)));
+                    actual = legal ? actual + (dy && dx ? NavGraph::COST_DIAGONAL : NavGraph::COST_STRAIGHT) : -2;
+                }
+            }
+        }
+
+        if (expected < 0 ? actual == -1 : actual >= expected)
+            return true;
+
+        m.backend = "navigation";
+        m.frame = frame;
+        m.row = start.y;
+        m.col = start.x;
+        m.expected = expected;
+        m.actual = actual;
+        return false;
+    }
+
+    // 参照地图的顶点，规则与 RegionLabels 相同
+    bool oracleCorner(const OracleMap& oracle, int y, int x)
+    {
+        int bit = 0x1;
+        if (y == oracle.rows) { --y; bit <<= 2; }
+        if (x == oracle.cols) { --x; bit <<= 1; }
+        return (oracle.get(y, x) & bit) != 0;
+    }
+
+    // 地形区域：参照顶点上4邻接的填充，每个区域必须正好对应一个填充出来的连通块，大小、地形和是否是湖都相同，
+    // 并且没有多余的区域。报告的位置是顶点，期望值和实际值是格点数（对应关系不对时是区域编号）
+    template <typename Map>
+    bool regionsMatch(const OracleMap& oracle, const RegionLabels<Map>& regions, int frame, Mismatch& m)
+    {
+        int rows = oracle.rows + 1, cols = oracle.cols + 1;
+        std::vector<int> label(rows * cols, -1), sizes, toRegion, toLabel(regions.regionCapacity(), -1);
+        std::vector<bool> touchesEdge;
+        std::vector<int> stack;
+
+        m.backend = "terrain regions";
+        m.frame = frame;
+
+        for (int start = 0; start < rows * cols; ++start)
+        {
+            if (label[start] >= 0)
+                continue;
+
+            int id = static_cast<int>(sizes.size());
+            bool value = oracleCorner(oracle, start / cols, start % cols);
+            sizes.push_back(0);
+            touchesEdge.push_back(false);
+            toRegion.push_back(regions.regionAt(start / cols, start % cols));
+
+            label[start] = id;
+            stack.assign(1, start);
+            while (!stack.empty())
+            {
+                int i = stack.back();
+                stack.pop_back();
+                int y = i / cols, x = i % cols;
+                ++sizes[id];
+                if (y == 0 || x == 0 || y == rows - 1 || x == cols - 1)
+                    touchesEdge[id] = true;
+
+                // 同一个连通块必须是同一个区域，不同的连通块不能是同一个区域
+                int actual = regions.regionAt(y, x);
+                if (actual != toRegion[id] || (toLabel[actual] >= 0 && toLabel[actual] != id))
+                {
+                    m.row = y;
+                    m.col = x;
+                    m.expected = toRegion[id];
+                    m.actual = actual;
+                    return false;
+                }
+                toLabel[actual] = id;
+
+                int around[4][2] = { { y - 1, x }, { y + 1, x }, { y, x - 1 }, { y, x + 1 } };
+                for (int d = 0; d < 4; ++d)
+                {
+                    int ny = around[d][0], nx = around[d][1];
+                    if (ny < 0 || nx < 0 || ny >= rows || nx >= cols || label[ny * cols + nx] >= 0
+                        || oracleCorner(oracle, ny, nx) != value)
+                        continue;
+                    label[ny * cols + nx] = id;
+                    stack.push_back(ny * cols + nx);
+                }
+            }
+
+            const TerrainRegion& g = regions.region(toRegion[id]);
+            if (g.size != sizes[id] || g.terrain != value || g.lake() != (!value && !touchesEdge[id]))
+            {
+                m.row = start / cols;
+                m.col = start % cols;
+                m.expected = sizes[id];
+                m.actual = g.size;
+                return false;
+            }
+        }
+
+        RegionStats s = regions.stats();
+        if (s.regions == static_cast<int>(sizes.size()))
+            return true;
+
+        m.row = m.col = -1;
+        m.expected = static_cast<int>(sizes.size());
+        m.actual = s.regions;
+        return false;
+    }
+
+    // 绘制的方式：编辑器用的模式代码，或者先改顶点再重算掩码（TileOps）
+    enum StampPath
+    {
+        STAMP_MODE,
+        STAMP_CORNERS
+    };
+
+    // 一种优化过的实现：地图存储方式 + 绘制方式
+    class Backend
+    {
+    public:
+        virtual ~Backend() {}
+        virtual const char* name() const = 0;
+        virtual void apply(const FuzzEdit& e) = 0;
+        virtual bool check(const OracleMap& oracle, int frame, Mismatch& m) = 0;
+
+        // 所有操作结束后，从顶点重算整张地图也必须得到同样的结果
+        virtual bool checkRetile(const OracleMap& oracle, int frame, Mismatch& m) = 0;
+    };
+
+    template <typename Mode, typename Map, int PATH>
+    class BackendT : public Backend
+    {
+    public:
+        BackendT(const char* n, int rows, int cols)
+            : backendName(n), map(rows, cols), contours(map), nav(map, true, 1), regions(map), committed(true)
+        {
+            regions.build();
+        }
+
+        virtual const char* name() const { return backendName; }
+
+        virtual void apply(const FuzzEdit& e)
+        {
+            int row, col;
+            pickTile<Mode, FUZZ_TILE_SHIFT>(e.mx, e.my, map.rows(), map.cols(), row, col);
+
+            if (row != -1 && col != -1 && (e.left || e.right))
+            {
+                // 和编辑器一样，左键优先
+                if (PATH == STAMP_CORNERS && static_cast<int>(Mode::ID) == TILEMODE_EASY)
+                    stampTile(map, row, col, e.left);
+                else
+                    Mode::stamp(map, row, col, e.left);
+            }
+
+            if (e.commit)
+                map.commit();
+            committed = e.commit;
+        }
+
+        virtual bool check(const OracleMap& oracle, int frame, Mismatch& m)
+        {
+            if (!sameAs(oracle, map, frame, backendName, m))
+                return false;
+
+            // 区域统计和碰撞轮廓只反映提交过的内容
+            if (!committed)
+                return true;
+
+            contours.update();
+            nav.update();
+            regions.update();
+            return summaryMatches(oracle, map, frame, m) && contourMatches(oracle, contours, frame, m)
+                && navMatches(oracle, nav.graph(), frame, m) && regionsMatch(oracle, regions, frame, m);
+        }
+
+        virtual bool checkRetile(const OracleMap& oracle, int frame, Mismatch& m)
+        {
+            map.commit();
+
+            CornerGrid grid;
+            readCorners(map, grid);
+
+            Map rebuilt(map.rows(), map.cols());
+            retile(rebuilt, grid);
+            rebuilt.commit();
+
+            return sameAs(oracle, rebuilt, frame, "retile from corners", m);
+        }
+
+    private:
+        const char* backendName;
+        Map map;
+        ContourSet<Map> contours;
+        NavMap<Map> nav;
+        RegionLabels<Map> regions;
+        bool committed;     // 最后一帧的修改已经提交
+    };
+
+    template <typename Mode>
+    void createBackends(int rows, int cols, std::vector<Backend*>& backends)
+    {
+#define FUZZ_BACKEND(T, BITS, LAYOUT, PATH) \
+        backends.push_back(new BackendT<Mode, ChunkMap<T, BITS, LAYOUT>, PATH>( \
+            #T " " #BITS " " #LAYOUT " " #PATH, rows, cols));
+
+        FUZZ_BACKEND(unsigned char, 3, RowMajorLayout, STAMP_MODE)
+        FUZZ_BACKEND(unsigned char, 3, MortonLayout, STAMP_MODE)
+        FUZZ_BACKEND(unsigned char, 4, RowMajorLayout, STAMP_MODE)
+        FUZZ_BACKEND(unsigned char, 5, MortonLayout, STAMP_MODE)
+        FUZZ_BACKEND(unsigned short, 3, RowMajorLayout, STAMP_MODE)
+        FUZZ_BACKEND(unsigned short, 4, MortonLayout, STAMP_MODE)
+        FUZZ_BACKEND(unsigned char, 3, RowMajorLayout, STAMP_CORNERS)
+        FUZZ_BACKEND(unsigned char, 4, MortonLayout, STAMP_CORNERS)
+
+#undef FUZZ_BACKEND
+    }
+
+    template <typename Oracle, typename Mode>
+    bool runCase(const FuzzCase& fc, Mismatch& m)
+    {
+        OracleMap oracle(fc.rows, fc.cols);
+
+        std::vector<Backend*> backends;
+        createBackends<Mode>(fc.rows, fc.cols, backends);
+
+        bool ok = true;
+        int frame = 0;
+
+        for (; ok && frame < static_cast<int>(fc.edits.size()); ++frame)
+        {
+            const FuzzEdit& e = fc.edits[frame];
+
+            // 参照实现：原来的 FrameFunc()
+            int row, col;
+            Oracle::pick(static_cast<float>(e.mx), static_cast<float>(e.my), fc.rows, fc.cols, row, col);
+            if (e.left)
+            {
+                if (row != -1 && col != -1)
+                    Oracle::fill(oracle, row, col);
+            }
+            else if (e.right)
+            {
+                if (row != -1 && col != -1)
+                    Oracle::erase(oracle, row, col);
+            }
+
+            for (size_t b = 0; ok && b < backends.size(); ++b)
+            {
+                backends[b]->apply(e);
+                ok = backends[b]->check(oracle, frame, m);
+            }
+        }
+
+        for (size_t b = 0; ok && b < backends.size(); ++b)
+            ok = backends[b]->checkRetile(oracle, frame, m);
+
+        for (size_t b = 0; b < backends.size(); ++b)
+            delete backends[b];
+
+        return ok;
+    }
+}
+
+int fuzzOne(const unsigned char* data, size_t size, bool verbose)
+{
+    FuzzCase fc;
+    decode(data, size, fc);
+
+    Mismatch m;
+    bool ok = fc.mode == TILEMODE_EASY
+        ? runCase<OracleEasy, EasyMode>(fc, m)
+        : runCase<OracleWarcraft, WarcraftMode>(fc, m);
+
+    if (!ok && verbose)
+    {
+        const FuzzEdit& e = fc.edits[m.frame < static_cast<int>(fc.edits.size()) ? m.frame : fc.edits.size() - 1];
+        printf("MISMATCH in %s: %s map %dx%d, frame %d (mouse %d,%d%s%s), cell (%d,%d) expected 0x%x got 0x%x\n",
+            m.backend, fc.mode == TILEMODE_EASY ? "easy" : "warcraft", fc.rows, fc.cols, m.frame,
+            e.mx, e.my, e.left ? " left" : "", e.right ? " right" : "", m.row, m.col, m.expected, m.actual);
+    }
+
+    return ok ? 0 : 1;
+}
+
+int runFuzz(int iterations, unsigned int seed)
+{
+    srand(seed);
+    std::vector<unsigned char> data;
+
+    for (int i = 0; i < iterations; ++i)
+    {
+        data.resize(3 + rand() % FUZZ_MAX_BYTES);
+        for (size_t k = 0; k < data.size(); ++k)
+            data[k] = static_cast<unsigned char>(rand() & 0xFF);
+
+        if (fuzzOne(&data[0], data.size(), true) != 0)
+        {
+            FILE* file = fopen(FUZZ_FAILURE_FILE, "wb");
+            if (file)
+            {
+                fwrite(&data[0], 1, data.size(), file);
+                fclose(file);
+            }
+            printf("iteration %d (seed %u), case written to %s\n", i, seed, FUZZ_FAILURE_FILE);
+            return 1;
+        }
+    }
+
+    printf("%d cases, all backends match the reference\n", iterations);
+    return 0;
+}
+
+int runFuzzCase(const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file)
+    {
+        printf("can't read %s\n", path);
+        return 1;
+    }
+
+    std::vector<unsigned char> data;
+    int ch;
+    while ((ch = fgetc(file)) != EOF)
+        data.push_back(static_cast<unsigned char>(ch));
+    fclose(file);
+
+    int result = fuzzOne(data.empty() ? 0 : &data[0], data.size(), true);
+    if (result == 0)
+        printf("%s: all backends match the reference\n", path);
+    return result;
+}
+
+#ifdef TILE_LIBFUZZER
+extern "C" int LLVMFuzzerTestOneInput(const unsigned char* data, size_t size)
+{
+    if (fuzzOne(data, size, true) != 0)
+        abort();
+    return 0;
+}
+#endif
@@ -0,0 +1,21 @@
+/*
+** 差分模糊测试
+**
+** author : gouki04 2011-12-30
+*/
+
+#ifndef FUZZ_H
+#define FUZZ_H
+
+#include <stddef.h>
+
+// 执行一个测试用例，所有实现都与参照实现一致时返回0
+int fuzzOne(const unsigned char* data, size_t size, bool verbose = false);
+
+// 随机生成 iterations 个用例，发现不一致时把用例写入 FUZZ_FAILURE_FILE 并返回非0
+int runFuzz(int iterations, unsigned int seed);
+
+// 重新执行保存下来的用例
+int runFuzzCase(const char* path);
+
+#endif
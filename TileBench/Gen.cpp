@@ -0,0 +1,116 @@
+/*
+** 程序生成地形的性能测试
+**   check  : 小地图上 retileChunks() 与逐格的 retile() 结果相同，不同线程数生成的顶点网格相同
+**   noise  : 填满顶点网格
+**   retile : 按块重算掩码并入池
+**
+** author : gouki04 2011-12-30
+*/
+
+#include "Gen.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../Common/JobScheduler.h"
+#include "../Common/Platform.h"
+#include "../Common/TileChunk.h"
+#include "../Common/TileGen.h"
+
+#define GEN_CHECK_ROWS 1000     // 检查用的地图大小，不是块大小的整数倍
+#define GEN_CHECK_COLS 1003
+
+namespace
+{
+    typedef ChunkMap<unsigned char> Map;
+
+    bool sameGrid(const CornerGrid& a, const CornerGrid& b)
+    {
+        for (int r = 0; r < a.rows(); ++r)
+        {
+            if (memcmp(a.row(r), b.row(r), a.wordsPerRow() * sizeof(unsigned int)) != 0)
+                return false;
+        }
+        return true;
+    }
+
+    template <typename M>
+    bool retileMatches(const CornerGrid& grid, JobScheduler* jobs)
+    {
+        M expected(grid.rows() - 1, grid.cols() - 1), actual(grid.rows() - 1, grid.cols() - 1);
+        retile(expected, grid);
+        expected.commit();
+        retileChunks(actual, grid, jobs);
+        return expected.contentHash() == actual.contentHash();
+    }
+
+    bool check(const TerrainNoise& noise, JobScheduler& jobs)
+    {
+        CornerGrid single(GEN_CHECK_ROWS + 1, GEN_CHECK_COLS + 1);
+        generateCorners(single, noise);
+
+        int counts[] = { 1, 3, 7 };
+        for (int i = 0; i < 3; ++i)
+        {
+            JobScheduler other(counts[i], "gen check");
+            CornerGrid grid(GEN_CHECK_ROWS + 1, GEN_CHECK_COLS + 1);
+            generateCorners(grid, noise, &other);
+            if (!sameGrid(single, grid))
+            {
+                printf("check  : corners differ with %d workers\n", counts[i]);
+                return false;
+            }
+        }
+
+        if (!retileMatches<Map>(single, &jobs) || !retileMatches<ChunkMap<unsigned char, 5, MortonLayout> >(single, &jobs)
+            || !retileMatches<ChunkMap<unsigned short, 4, RowMajorLayout> >(single, 0))
+        {
+            printf("check  : retileChunks() differs from retile()\n");
+            return false;
+        }
+
+        printf("check  : same corners with 0, 1, 3, 7 workers, retileChunks() matches retile()\n");
+        return true;
+    }
+}
+
+int runGenBench(int size, unsigned int seed)
+{
+    TerrainNoise noise(seed);
+    JobScheduler jobs(hardwareThreads(), "gen");
+
+    if (!check(noise, jobs))
+        return 1;
+
+    double start = getTicks();
+    CornerGrid grid(size + 1, size + 1);
+    double allocate = getTicks() - start;
+
+    start = getTicks();
+    generateCorners(grid, noise, &jobs);
+    double generate = getTicks() - start;
+
+    long land = 0;
+    for (int r = 0; r < grid.rows(); ++r)
+    {
+        const unsigned int* row = grid.row(r);
+        for (int i = 0; i < grid.wordsPerRow(); ++i)
+        {
+            for (unsigned int w = row[i]; w; w &= w - 1)
+                ++land;
+        }
+    }
+
+    Map map(size, size);
+    start = getTicks();
+    retileChunks(map, grid, &jobs);
+    double mask = getTicks() - start;
+
+    printf("map %dx%d, seed %u, %d workers, %.1f%% terrain\n", size, size, seed, jobs.workerCount(),
+        land * 100.0 / (static_cast<double>(grid.rows()) * grid.cols()));
+    printf("noise  : %.1f ms (%.1f ms to allocate the corner grid)\n", generate * 1000.0, allocate * 1000.0);
+    printf("retile : %.1f ms, %d unique chunks of %d, %.1f MB resident\n", mask * 1000.0,
+        map.chunkPool().uniqueCount(), map.chunkRows() * map.chunkCols(), map.chunkPool().residentBytes() / 1048576.0);
+    printf("total  : %.1f ms\n", (generate + mask) * 1000.0);
+    return 0;
+}
@@ -0,0 +1,13 @@
+/*
+** 程序生成地形的性能测试
+**
+** author : gouki04 2011-12-30
+*/
+
+#ifndef GEN_H
+#define GEN_H
+
+// 生成 size*size 的地图，检查结果与线程数无关，测量噪声和掩码两步的耗时
+int runGenBench(int size, unsigned int seed);
+
+#endif
@@ -0,0 +1,134 @@
+/*
+** 分层寻路的性能测试
+** 在顶点网格上随机画一些圆形的地形（地形不能走），重算整张地图的掩码之后：
+**   build : 第一次生成所有子格、入口和簇内边
+**   path  : 随机的起点和终点之间在抽象图上寻路
+**   refine: 把找到的路径展开成逐格的路径
+**   edit  : 模拟魔兽模式的拖动绘制，每笔 commit 一次，只修复笔画范围内换了的块
+**
+** author : gouki04 2011-12-30
+*/
+
+#include "Nav.h"
+
+#include <stdio.h>
+#include <vector>
+
+#include "../Common/Platform.h"
+#include "../Common/TileChunk.h"
+#include "../Common/TileNav.h"
+
+#include "Terrain.h"
+
+#define NAV_DISKS 160               // 随机地形的圆的个数
+#define NAV_MAX_RADIUS 160          // 圆的最大半径（顶点）
+#define NAV_QUERIES 1000            // 寻路的次数
+#define NAV_STROKES 1000            // 编辑的笔画数
+#define NAV_STROKE_LENGTH 16        // 每笔经过的顶点数
+
+namespace
+{
+    typedef ChunkMap<unsigned char> Map;
+
+    NavPoint randomCell(const NavGraph& graph, TerrainRandom& rnd)
+    {
+        NavPoint p;
+        do
+        {
+            p.y = rnd.next(graph.rows());
+            p.x = rnd.next(graph.cols());
+        } while (!graph.walkable(p.y, p.x));
+        return p;
+    }
+
+    void runQueries(NavGraph& graph, TerrainRandom& rnd, const char* label)
+    {
+        std::vector<NavPoint> waypoints, path;
+        double total = 0, worst = 0, refine = 0;
+        long expanded = 0, cells = 0;
+        int found = 0;
+
+        for (int i = 0; i < NAV_QUERIES; ++i)
+        {
+            NavPoint start = randomCell(graph, rnd), goal = randomCell(graph, rnd);
+
+            double t = getTicks();
+            bool ok = graph.findPath(start, goal, waypoints);
+            t = getTicks() - t;
+
+            total += t;
+            if (t > worst) worst = t;
+            expanded += graph.expandedCount();
+
+            if (!ok)
+                continue;
+
+            ++found;
+            t = getTicks();
+            graph.refinePath(waypoints, path);
+            refine += getTicks() - t;
+            cells += static_cast<long>(path.size());
+        }
+
+        printf("%s: %d queries, %d found, %.3f ms average, %.3f ms worst, %ld nodes expanded on average\n",
+            label, NAV_QUERIES, found, total * 1000.0 / NAV_QUERIES, worst * 1000.0, expanded / NAV_QUERIES);
+        if (found > 0)
+        {
+            printf("refine: %.3f ms average, %ld cells per path on average\n",
+                refine * 1000.0 / found, cells / found);
+        }
+    }
+}
+
+int runNavBench(int size)
+{
+    TerrainRandom rnd(1);
+    Map map(size, size);
+
+    double start = getTicks();
+    {
+        CornerGrid grid(size + 1, size + 1);
+        paintDisks(grid, rnd, NAV_DISKS, NAV_MAX_RADIUS);
+        retile(map, grid);
+        map.commit();
+    }
+    double generate = getTicks() - start;
+
+    NavMap<Map> nav(map, false);
+    NavGraph& graph = nav.graph();
+
+    start = getTicks();
+    nav.update();
+    double build = getTicks() - start;
+
+    printf("map %dx%d, %dx%d cells, %d clusters, generated in %.1f ms\n", size, size, graph.rows(), graph.cols(),
+        graph.clusterRows() * graph.clusterCols(), generate * 1000.0);
+    printf("build : %.1f ms, %d nodes, %d edges, %d region nodes\n", build * 1000.0, graph.nodeCount(), graph.edgeCount(),
+        graph.regionNodeCount());
+
+    runQueries(graph, rnd, "path  ");
+
+    // 拖动绘制，每笔之后 commit 并修复笔画范围内的块
+    double total = 0, worst = 0;
+    long clusters = 0;
+    for (int s = 0; s < NAV_STROKES; ++s)
+    {
+        int r1, c1, r2, c2;
+        paintStroke(map, rnd, NAV_STROKE_LENGTH, (s & 3) != 3, r1, c1, r2, c2);
+        map.commit();
+
+        start = getTicks();
+        clusters += nav.update(r1, c1, r2, c2);
+        double t = getTicks() - start;
+
+        total += t;
+        if (t > worst) worst = t;
+    }
+
+    printf("edit  : %d strokes, %ld clusters repaired, %.3f ms average, %.3f ms worst\n",
+        NAV_STROKES, clusters, total * 1000.0 / NAV_STROKES, worst * 1000.0);
+
+    runQueries(graph, rnd, "path after edits");
+
+    return 0;
+}
@@ -0,0 +1,13 @@
+/*
+** 分层寻路的性能测试
+**
+** author : gouki04 2011-12-30
+*/
+
+#ifndef NAV_H
+#define NAV_H
+
+// 在 size*size 的随机地形上建立导航图，测量寻路和每次编辑之后增量修复的耗时
+int runNavBench(int size);
+
+#endif
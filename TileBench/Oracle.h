@@ -0,0 +1,144 @@
+/*
+** 参照实现
+** 原来 FrameFunc() 中计算高亮位置和绘制 / 擦除的代码，只把固定的地图大小换成了运行期的参数，
+** 作为差分测试（Fuzz.cpp）的标准答案。除非确认原来的行为本身有错，否则不要修改这里。
+**
+** author : gouki04 2011-12-30
+*/
+
+#ifndef ORACLE_H
+#define ORACLE_H
+
+#include <vector>
+
+#define ORACLE_TILEWIDTH 32
+#define ORACLE_TILEHEIGHT 32
+
+// 用 easyMap[r][c] 的写法访问，和原来的二维数组一样
+struct OracleMap
+{
+    int rows, cols;
+    std::vector<int> cells;
+
+    OracleMap(int r, int c) : rows(r), cols(c), cells(r * c, 0) {}
+
+    int* operator[](int r) { return &cells[r * cols]; }
+    int get(int r, int c) const { return cells[r * cols + c]; }
+};
+
+// 简单模式（AutoTile）
+struct OracleEasy
+{
+    static void pick(float mx, float my, int MAPROW, int MAPCOL, int& highlight_row, int& highlight_col)
+    {
+        highlight_col = static_cast<int>(mx / ORACLE_TILEWIDTH);
+        highlight_row = static_cast<int>(my / ORACLE_TILEHEIGHT);
+
+        if (highlight_col < 0|| highlight_col >= MAPCOL) highlight_col = -1;
+        if (highlight_row < 0 || highlight_row >= MAPROW) highlight_row = -1;
+    }
+
+    static void fill(OracleMap& easyMap, int r, int c)
+    {
+        int MAPROW = easyMap.rows, MAPCOL = easyMap.cols;
+
+        // 将中心点周围的16个小格填为1
+
+        if (r > 0)
+        {
+            if (c > 0) easyMap[r - 1][c - 1] |= 0x8;    // 1000
+            easyMap[r - 1][c] |= 0xC;   // 1100
+            if (c < MAPCOL - 1) easyMap[r - 1][c + 1] |= 0x4;   // 0100
+        }
+
+        if (c > 0) easyMap[r][c - 1] |= 0xA;    // 1010
+        easyMap[r][c] |= 0xF;   // 1111
+        if (c < MAPCOL - 1) easyMap[r][c + 1] |= 0x5;   // 0101
+
+        if (r < MAPROW - 1)
+        {
+            if (c > 0) easyMap[r + 1][c - 1] |= 0x2;    // 0010
+            easyMap[r + 1][c] |= 0x3;   // 0011
+            if (c < MAPCOL - 1) easyMap[r + 1][c + 1] |= 0x1;   // 0001
+        }
+    }
+
+    static void erase(OracleMap& easyMap, int r, int c)
+    {
+        int MAPROW = easyMap.rows, MAPCOL = easyMap.cols;
+
+        // 将中心点周围的16个小格填为0
+
+        if (r > 0)
+        {
+            if (c > 0) easyMap[r - 1][c - 1] &= ~0x8;   // 0111
+            easyMap[r - 1][c] &= ~0xC;  // 0011
+            if (c < MAPCOL - 1) easyMap[r - 1][c + 1] &= ~0x4;  // 1011
+        }
+
+        if (c > 0) easyMap[r][c - 1] &= ~0xA;   // 0101
+        easyMap[r][c] &= ~0xF;  // 0000
+        if (c < MAPCOL - 1) easyMap[r][c + 1] &= ~0x5;   // 1010
+
+        if (r < MAPROW - 1)
+        {
+            if (c > 0) easyMap[r + 1][c - 1] &= ~0x2;   // 1101
+            easyMap[r + 1][c] &= ~0x3;  // 1100
+            if (c < MAPCOL - 1) easyMap[r + 1][c + 1] &= ~0x1;   // 1110
+        }
+    }
+};
+
+// 魔兽争霸模式（WarcraftAutoTile）
+struct OracleWarcraft
+{
+    static void pick(float mx, float my, int MAPROW, int MAPCOL, int& highlight_row, int& highlight_col)
+    {
+        // 计算时要将当前位置加上半个Tile大小，是为了四舍五入
+        highlight_col = static_cast<int>((mx + ORACLE_TILEWIDTH / 2) / ORACLE_TILEWIDTH);
+        highlight_row = static_cast<int>((my + ORACLE_TILEHEIGHT / 2) / ORACLE_TILEHEIGHT);
+
+        if (highlight_col < 0|| highlight_col > MAPCOL) highlight_col = -1;
+        if (highlight_row < 0 || highlight_row > MAPROW) highlight_row = -1;
+    }
+
+    static void fill(OracleMap& easyMap, int r, int c)
+    {
+        int MAPROW = easyMap.rows, MAPCOL = easyMap.cols;
+
+        // 将中心点周围的4个小格填为1
+
+        if (r > 0)
+        {
+            if (c > 0) easyMap[r - 1][c - 1] |= 0x8;    // 1000
+            if (c < MAPCOL) easyMap[r - 1][c] |= 0x4;   // 0100
+        }
+
+        if (r < MAPROW)
+        {
+            if (c > 0) easyMap[r][c - 1] |= 0x2;    // 0010
+            if (c < MAPCOL) easyMap[r][c] |= 0x1;   // 0001
+        }
+    }
+
+    static void erase(OracleMap& easyMap, int r, int c)
+    {
+        int MAPROW = easyMap.rows, MAPCOL = easyMap.cols;
+
+        // 将中心点周围的4个小格填为0
+
+        if (r > 0)
+        {
+            if (c > 0) easyMap[r - 1][c - 1] &= ~0x8;    // 0111
+            if (c < MAPCOL) easyMap[r - 1][c] &= ~0x4;   // 1011
+        }
+
+        if (r < MAPROW)
+        {
+            if (c > 0) easyMap[r][c - 1] &= ~0x2;    // 1101
+            if (c < MAPCOL) easyMap[r][c] &= ~0x1;   // 1110
+        }
+    }
+};
+
+#endif
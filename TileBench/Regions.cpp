@@ -0,0 +1,111 @@
+/*
+** 地形区域标记的性能测试
+** 在顶点网格上随机画一些圆形的地形，重算整张地图的掩码之后：
+**   build   : 在调用线程中标记整张地图
+**   parallel: 块内标记和块行内的合并交给工作线程，结果必须与 build 相同
+**   edit    : 模拟魔兽模式的拖动绘制，每笔 commit 一次，只在笔画范围内换了的块附近判断合并和分裂
+**
+** author : gouki04 2011-12-30
+*/
+
+#include "Regions.h"
+
+#include <stdio.h>
+
+#include "../Common/JobScheduler.h"
+#include "../Common/Platform.h"
+#include "../Common/TileChunk.h"
+#include "../Common/TileRegions.h"
+
+#include "Terrain.h"
+
+#define REGIONS_DISKS 400           // 随机地形的圆的个数
+#define REGIONS_MAX_RADIUS 96       // 圆的最大半径（顶点）
+#define REGIONS_STROKES 1000        // 编辑的笔画数
+#define REGIONS_STROKE_LENGTH 16    // 每笔经过的顶点数
+
+namespace
+{
+    typedef ChunkMap<unsigned char> Map;
+
+    void printStats(const char* label, double seconds, const RegionStats& s)
+    {
+        printf("%s: %.1f ms, %d regions, %d islands (largest %d), %d lakes (largest %d)\n", label, seconds * 1000.0,
+            s.regions, s.islands, s.largestIsland, s.lakes, s.largestLake);
+    }
+
+    bool sameStats(const RegionStats& a, const RegionStats& b)
+    {
+        return a.regions == b.regions && a.islands == b.islands && a.lakes == b.lakes
+            && a.largestIsland == b.largestIsland && a.largestLake == b.largestLake;
+    }
+}
+
+int runRegionsBench(int size)
+{
+    TerrainRandom rnd(1);
+    Map map(size, size);
+
+    {
+        CornerGrid grid(size + 1, size + 1);
+        paintDisks(grid, rnd, REGIONS_DISKS, REGIONS_MAX_RADIUS);
+        retile(map, grid);
+        map.commit();
+    }
+
+    printf("map %dx%d, %dx%d chunks\n", size, size, map.chunkRows(), map.chunkCols());
+
+    RegionLabels<Map> regions(map);
+    double start = getTicks();
+    regions.build();
+    double sequential = getTicks() - start;
+    printStats("build   ", sequential, regions.stats());
+
+    JobScheduler jobs(hardwareThreads(), "regions");
+    RegionLabels<Map> parallel(map);
+    start = getTicks();
+    parallel.build(&jobs);
+    double t = getTicks() - start;
+    printStats("parallel", t, parallel.stats());
+    printf("          %d workers, %.2fx\n", jobs.workerCount(), sequential / t);
+
+    if (!sameStats(regions.stats(), parallel.stats()))
+    {
+        printf("parallel build does not match\n");
+        return 1;
+    }
+
+    // 拖动绘制，每笔之后 commit 并更新笔画范围内的块
+    double total = 0, worst = 0;
+    long chunks = 0;
+    for (int s = 0; s < REGIONS_STROKES; ++s)
+    {
+        int r1, c1, r2, c2;
+        paintStroke(map, rnd, REGIONS_STROKE_LENGTH, (s & 1) == 0, r1, c1, r2, c2);
+        map.commit();
+
+        start = getTicks();
+        chunks += regions.update(r1, c1, r2, c2);
+        t = getTicks() - start;
+
+        total += t;
+        if (t > worst) worst = t;
+    }
+
+    printf("edit    : %d strokes, %ld chunks relabelled, %.3f ms average, %.3f ms worst\n",
+        REGIONS_STROKES, chunks, total * 1000.0 / REGIONS_STROKES, worst * 1000.0);
+
+    // 编辑之后重新标记整张地图，结果必须与增量维护的相同
+    RegionLabels<Map> rebuilt(map);
+    start = getTicks();
+    rebuilt.build(&jobs);
+    printStats("rebuilt ", getTicks() - start, rebuilt.stats());
+    printStats("updated ", total, regions.stats());
+
+    if (!sameStats(regions.stats(), rebuilt.stats()))
+    {
+        printf("incremental labels do not match a rebuild\n");
+        return 1;
+    }
+    return 0;
+}
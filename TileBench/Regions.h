@@ -0,0 +1,13 @@
+/*
+** 地形区域标记的性能测试
+**
+** author : gouki04 2011-12-30
+*/
+
+#ifndef REGIONS_H
+#define REGIONS_H
+
+// 在 size*size 的随机地形上标记地形区域，测量并行标记和每次编辑之后增量维护的耗时
+int runRegionsBench(int size);
+
+#endif
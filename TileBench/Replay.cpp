@@ -0,0 +1,266 @@
+/*
+** 输入记录的回放
+** 不开窗口，按记录的输入重新执行编辑器每帧的工作：选中元件、绘制、合并地图块，
+** 输入用和编辑器同一个 EditInput 换算成编辑操作（见 EditInput.h），包括生成地形的种子和元胞自动机的规则，
+** 再把需要重绘的块转换成四边形（开启块缓存时只转换内容变化的块，关闭时每帧转换整张地图）。
+** 不等待帧间隔，尽可能快地执行，输出总耗时、每帧耗时的分布、四边形的个数和面积，以及最终的地图内容哈希。
+** 元件按空白元件透明、地形内的元件单色来合并（见 TileMesh.h），加上 nomerge 时逐个元件转换，用来比较。
+**
+** author : gouki04 2011-12-30
+*/
+
+#include "Replay.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "../Common/Platform.h"
+#include "../Common/EditInput.h"
+#include "../Common/InputTrace.h"
+#include "../Common/TileAutomaton.h"
+#include "../Common/TileChunk.h"
+#include "../Common/TileGen.h"
+#include "../Common/TileMode.h"
+#include "../Common/TileMesh.h"
+
+#define REPLAY_TILE_COUNT 48            // UV表的大小，所有模式都够用
+
+namespace
+{
+    // 只统计不绘制的批次，累加坐标是为了不让转换的工作被优化掉
+    struct CountingBatch
+    {
+        long long quads;
+        double pixels;      // 填充的面积
+        double checksum;
+
+        void add(float x1, float y1, float x2, float y2, float u0, float v0, float u1, float v1)
+        {
+            ++quads;
+            pixels += (x2 - x1) * (y2 - y1);
+            checksum += x1 + y1 + x2 + y2 + u0 + v0 + u1 + v1;
+        }
+    };
+
+    struct ReplayResult
+    {
+        const char* mode;
+        std::vector<double> frameTimes;
+        double total;
+        long long quads;
+        double pixels;
+        ContentHash hash;
+    };
+
+    template <typename Mode, int CELL_BITS, int TILE_SHIFT>
+    void replay(const InputTrace& trace, bool merge, ReplayResult& result)
+    {
+        typedef ChunkMap<typename TileCell<CELL_BITS>::Type> Map;
+        typedef typename Map::Chunk Chunk;
+
+        const InputTraceHeader& header = trace.header();
+        Map map(header.rows, header.cols);
+        typename Map::Pool& pool = map.chunkPool();
+
+        // 元件在一张纹理上横向排开
+        float u0[REPLAY_TILE_COUNT], v0[REPLAY_TILE_COUNT], u1[REPLAY_TILE_COUNT], v1[REPLAY_TILE_COUNT];
+        for (int i = 0; i < REPLAY_TILE_COUNT; ++i)
+        {
+            u0[i] = static_cast<float>(i) / REPLAY_TILE_COUNT;
+            u1[i] = static_cast<float>(i + 1) / REPLAY_TILE_COUNT;
+            v0[i] = 0;
+            v1[i] = 1;
+        }
+
+        unsigned char fill[REPLAY_TILE_COUNT];
+        memset(fill, TILE_FILL_NONE, sizeof(fill));
+        fill[0] = TILE_FILL_EMPTY;
+        fill[Mode::fullTile()] = TILE_FILL_SOLID;
+
+        TileUVs uv = { u0, v0, u1, v1, REPLAY_TILE_COUNT, merge ? fill : 0 };
+
+        CountingBatch batch = { 0, 0, 0 };
+        bool chunkCache = true;
+        int zoom = 0;
+        EditInput editInput;
+
+        // 和编辑器一样保留顶点网格，绘制或生成之后才重新读
+        TerrainAutomaton automaton;
+        bool cornersStale = true;
+
+        result.mode = Mode::name();
+        result.frameTimes.resize(trace.frameCount());
+
+        double start = getTicks();
+
+        for (int f = 0; f < trace.frameCount(); ++f)
+        {
+            double frameStart = getTicks();
+            EditActions actions = editInput.actions(trace.frame(f));
+
+            if (actions.toggleChunkCache)
+                chunkCache = !chunkCache;
+
+            // 缩放只影响选中的元件，与编辑器的 setZoom() 一样限制级数
+            if (actions.zoom > 0 && zoom < LOD_LEVELS && zoom < TILE_SHIFT)
+                ++zoom;
+            else if (actions.zoom < 0 && zoom > 0)
+                --zoom;
+
+            // 与编辑器的 generate() 一样在这一帧的绘制之前替换整张地图，8邻接模式不支持
+            if (actions.generate && static_cast<int>(Mode::ID) != TILEMODE_BLOB)
+            {
+                generateTerrain(map, actions.noise);
+                cornersStale = true;
+            }
+
+            // 与编辑器的 simulate() 一样在这一帧的绘制之前执行
+            if (actions.rule != -1 && static_cast<int>(Mode::ID) != TILEMODE_BLOB)
+            {
+                if (cornersStale)
+                {
+                    automaton.load(map);
+                    cornersStale = false;
+                }
+                automaton.step(automatonRule(actions.rule));
+                automaton.store(map);
+                map.commit();
+            }
+
+            int row, col;
+            pickTile<Mode, TILE_SHIFT>((actions.mouseX - header.originX) * (1 << zoom),
+                (actions.mouseY - header.originY) * (1 << zoom), map.rows(), map.cols(), row, col);
+
+            if (row != -1 && col != -1 && actions.stamp != -1)
+            {
+                Mode::stamp(map, row, col, actions.stamp == 1);
+                cornersStale = true;
+            }
+
+            map.commit();
+
+            // 对应编辑器的 updateCache() 和 drawMap()
+            for (int cr = 0; cr < map.chunkRows(); ++cr)
+            {
+                for (int cc = 0; cc < map.chunkCols(); ++cc)
+                {
+                    Chunk* chunk = map.chunkAt(cr, cc);
+                    int r0 = cr << Map::CHUNK_BITS;
+                    int c0 = cc << Map::CHUNK_BITS;
+
+                    if (chunkCache)
+                    {
+                        if (pool.isCacheValid(chunk))
+                            continue;
+
+                        chunk->renderCache = 1;
+                        chunk->cacheGeneration = pool.cacheGeneration();
+                        emitChunkTiles<Mode, TILE_SHIFT>(batch, chunk, Map::CHUNK_SIZE, Map::CHUNK_SIZE, 0, 0, uv);
+                    }
+                    else
+                    {
+                        int rows = std::min<int>(Map::CHUNK_SIZE, map.rows() - r0);
+                        int cols = std::min<int>(Map::CHUNK_SIZE, map.cols() - c0);
+                        emitChunkTiles<Mode, TILE_SHIFT>(batch, chunk, rows, cols,
+                            header.originX + (c0 << TILE_SHIFT), header.originY + (r0 << TILE_SHIFT), uv);
+                    }
+                }
+            }
+
+            result.frameTimes[f] = getTicks() - frameStart;
+        }
+
+        result.total = getTicks() - start;
+        result.quads = batch.quads;
+        result.pixels = batch.pixels;
+        result.hash = map.contentHash();
+
+        // 校验和只是为了保留转换的工作，输出到 stderr 不影响结果比较
+        fprintf(stderr, "checksum %.0f\n", batch.checksum);
+    }
+
+    // 排好序的耗时中第 p% 个，单位为微秒
+    double percentile(const std::vector<double>& sorted, int p)
+    {
+        if (sorted.empty())
+            return 0;
+
+        size_t rank = (sorted.size() * p + 99) / 100;
+        if (rank > 0) --rank;
+        return sorted[rank] * 1e6;
+    }
+}
+
+// 支持的组合与 createTileEditor() 一致
+#define REPLAY_CASE(MODE, BITS, SHIFT) \
+    case TILE_EDITOR_TAG(MODE::ID, BITS, SHIFT): \
+        replay<MODE, BITS, SHIFT>(trace, merge, result); \
+        break;
+
+#define REPLAY_CASES(MODE, BITS) \
+    REPLAY_CASE(MODE, BITS, 4) \
+    REPLAY_CASE(MODE, BITS, 5) \
+    REPLAY_CASE(MODE, BITS, 6)
+
+int runReplay(const char* path, bool merge)
+{
+    InputTrace trace;
+    if (!trace.load(path))
+    {
+        printf("can't read input trace %s\n", path);
+        return 1;
+    }
+
+    const InputTraceHeader& header = trace.header();
+    if (header.rows <= 0 || header.cols <= 0)
+    {
+        printf("bad map size %dx%d\n", header.rows, header.cols);
+        return 1;
+    }
+
+    ReplayResult result;
+    result.mode = 0;
+
+    switch (header.tag)
+    {
+        REPLAY_CASES(EasyMode, 8)
+        REPLAY_CASES(EasyMode, 16)
+        REPLAY_CASES(WarcraftMode, 8)
+        REPLAY_CASES(WarcraftMode, 16)
+        REPLAY_CASES(BlobMode, 16)
+    }
+
+    if (!result.mode)
+    {
+        printf("unsupported map format 0x%x\n", header.tag);
+        return 1;
+    }
+
+    std::vector<double> sorted = result.frameTimes;
+    std::sort(sorted.begin(), sorted.end());
+
+    double sum = 0;
+    for (size_t i = 0; i < sorted.size(); ++i)
+        sum += sorted[i];
+
+    printf("%s: %s map %dx%d, %d frames\n", path, result.mode, header.rows, header.cols, trace.frameCount());
+    printf("total %.3f ms, %lld quads, %.0f pixels%s\n", result.total * 1000.0, result.quads, result.pixels,
+        merge ? "" : " (not merged)");
+    printf("frame (us): min %.2f  avg %.2f  p50 %.2f  p90 %.2f  p99 %.2f  max %.2f\n",
+        percentile(sorted, 0), sorted.empty() ? 0 : sum / sorted.size() * 1e6,
+        percentile(sorted, 50), percentile(sorted, 90), percentile(sorted, 99), percentile(sorted, 100));
+    printf("map hash %016llx", result.hash);
+
+    if (!trace.hasFinalHash())
+    {
+        printf(" (recording has no final hash)\n");
+        return 0;
+    }
+
+    bool match = trace.finalHash() == result.hash;
+    printf(", recorded %016llx: %s\n", trace.finalHash(), match ? "match" : "MISMATCH");
+
+    return match ? 0 : 1;
+}
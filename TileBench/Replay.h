@@ -0,0 +1,14 @@
+/*
+** 输入记录的回放
+**
+** author : gouki04 2011-12-30
+*/
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+// 回放输入记录并输出统计，结果与录制时不一致时返回非0
+// merge 为 false 时不合并相同的元件，逐个转换
+int runReplay(const char* path, bool merge = true);
+
+#endif
@@ -0,0 +1,77 @@
+/*
+** 性能测试用的随机地形
+**
+** author : gouki04 2011-12-30
+*/
+
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+#include "../Common/TileOps.h"
+
+// 简单的线性同余随机数，同样的种子得到同样的地形
+struct TerrainRandom
+{
+    unsigned int state;
+    TerrainRandom(unsigned int seed) : state(seed) {}
+    int next(int n)
+    {
+        state = state * 1664525u + 1013904223u;
+        return static_cast<int>((state >> 8) % static_cast<unsigned int>(n));
+    }
+};
+
+// 在顶点网格上随机画 count 个圆，每4个里有1个是挖洞
+inline void paintDisks(CornerGrid& grid, TerrainRandom& rnd, int count, int maxRadius)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        int cr = rnd.next(grid.rows()), cc = rnd.next(grid.cols());
+        int radius = 8 + rnd.next(maxRadius);
+        bool value = (i & 3) != 3;
+
+        for (int r = cr - radius; r <= cr + radius; ++r)
+        {
+            if (r < 0 || r >= grid.rows()) continue;
+            for (int c = cc - radius; c <= cc + radius; ++c)
+            {
+                if (c < 0 || c >= grid.cols()) continue;
+                if ((r - cr) * (r - cr) + (c - cc) * (c - cc) <= radius * radius)
+                    grid.set(r, c, value);
+            }
+        }
+    }
+}
+
+// 魔兽模式的拖动绘制：从随机的顶点开始随机游走 length 步，范围是涉及的元件（不包含 r2, c2）
+template <typename Map>
+void paintStroke(Map& map, TerrainRandom& rnd, int length, bool value, int& r1, int& c1, int& r2, int& c2)
+{
+    int r = rnd.next(map.rows() + 1), c = rnd.next(map.cols() + 1);
+    r1 = r2 = r;
+    c1 = c2 = c;
+
+    for (int i = 0; i < length; ++i)
+    {
+        setCorner(map, r, c, value);
+
+        r += rnd.next(3) - 1;
+        c += rnd.next(3) - 1;
+        if (r < 0) r = 0;
+        if (c < 0) c = 0;
+        if (r > map.rows()) r = map.rows();
+        if (c > map.cols()) c = map.cols();
+        if (r < r1) r1 = r;
+        if (c < c1) c1 = c;
+        if (r > r2) r2 = r;
+        if (c > c2) c2 = c;
+    }
+
+    // 顶点 (r, c) 影响元件 (r - 1 ~ r, c - 1 ~ c)
+    --r1;
+    --c1;
+    ++r2;
+    ++c2;
+}
+
+#endif
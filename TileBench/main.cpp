@@ -0,0 +1,201 @@
+/*
+** 地图核心操作的性能测试
+** 比较不同的块大小和块内排列方式（按行 / Morton序）在以下操作上的耗时：
+**   stamp : 模拟鼠标拖动的连续绘制，每帧 commit 一次
+**   fill  : 在随机地形上做顶点泛洪填充
+**   retile: 从顶点网格重新计算整张地图的掩码
+**
+** 用法：TileBench [地图边长]
+**       TileBench replay 输入记录文件 [nomerge]  （回放编辑器用 -record 记录的输入，见 Replay.cpp）
+**       TileBench fuzz [用例数] [随机种子]  （与参照实现对比的差分测试，见 Fuzz.cpp）
+**       TileBench fuzzcase 用例文件       （重新执行 fuzz 保存下来的出错用例）
+**       TileBench contour [地图边长]      （碰撞轮廓的提取和增量更新，见 Contour.cpp）
+**       TileBench nav [地图边长]          （分层寻路和导航图的增量修复，见 Nav.cpp）
+**       TileBench regions [地图边长]      （地形区域的并行标记和增量维护，见 Regions.cpp）
+**       TileBench gen [地图边长] [随机种子] （程序生成地形，见 Gen.cpp）
+**       TileBench automaton [地图边长] [步数] （地形元胞自动机，见 Automaton.cpp）
+**
+** author : gouki04 2011-12-30
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../Common/Platform.h"
+#include "../Common/TileChunk.h"
+#include "../Common/TileOps.h"
+
+#include "Replay.h"
+#include "Fuzz.h"
+#include "Contour.h"
+#include "Nav.h"
+#include "Regions.h"
+#include "Gen.h"
+#include "Automaton.h"
+
+#define STROKES 2000        // 绘制的笔画数
+#define STROKE_LENGTH 64    // 每笔经过的元件数
+#define STAMPS_PER_FRAME 4  // 每帧绘制的元件数
+
+// 简单的线性同余随机数，保证每种配置的输入完全一样
+struct BenchRandom
+{
+    unsigned int state;
+    BenchRandom(unsigned int seed) : state(seed) {}
+    int next(int n)
+    {
+        state = state * 1664525u + 1013904223u;
+        return static_cast<int>((state >> 8) % static_cast<unsigned int>(n));
+    }
+};
+
+template <typename Map>
+double benchStamp(Map& map)
+{
+    BenchRandom rnd(1);
+    double start = getTicks();
+
+    for (int s = 0; s < STROKES; ++s)
+    {
+        int r = rnd.next(map.rows());
+        int c = rnd.next(map.cols());
+        bool value = (s & 3) != 3;
+
+        for (int i = 0; i < STROKE_LENGTH; ++i)
+        {
+            stampTile(map, r, c, value);
+
+            // 笔画在8个方向上随机游走
+            r += rnd.next(3) - 1;
+            c += rnd.next(3) - 1;
+            if (r < 0) r = 0;
+            if (c < 0) c = 0;
+            if (r >= map.rows()) r = map.rows() - 1;
+            if (c >= map.cols()) c = map.cols() - 1;
+
+            if (i % STAMPS_PER_FRAME == 0)
+                map.commit();
+        }
+    }
+    map.commit();
+
+    return getTicks() - start;
+}
+
+template <typename Map>
+double benchFill(Map& map)
+{
+    double start = getTicks();
+
+    floodFill(map, 0, 0, true);
+    map.commit();
+    floodFill(map, 0, 0, false);
+    map.commit();
+
+    return getTicks() - start;
+}
+
+template <typename Map>
+double benchRetile(Map& map)
+{
+    CornerGrid grid;
+    double start = getTicks();
+
+    readCorners(map, grid);
+    retile(map, grid);
+    map.commit();
+
+    return getTicks() - start;
+}
+
+template <typename Map>
+void runBench(int size)
+{
+    Map map(size, size);
+
+    double stamp = benchStamp(map);
+    double fill = benchFill(map);
+    double re = benchRetile(map);
+
+    printf("%-10s %5d %10.2f %10.2f %10.2f %8d\n",
+        Map::CellLayout::name(), static_cast<int>(Map::CHUNK_SIZE),
+        stamp * 1000.0, fill * 1000.0, re * 1000.0, map.chunkPool().uniqueCount());
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1 && strcmp(argv[1], "replay") == 0)
+    {
+        if (argc < 3)
+        {
+            printf("usage: TileBench replay file [nomerge]\n");
+            return 1;
+        }
+        return runReplay(argv[2], !(argc > 3 && strcmp(argv[3], "nomerge") == 0));
+    }
+
+    if (argc > 1 && strcmp(argv[1], "fuzz") == 0)
+    {
+        int iterations = argc > 2 ? atoi(argv[2]) : 10000;
+        unsigned int seed = argc > 3 ? static_cast<unsigned int>(atoi(argv[3])) : 1;
+        return runFuzz(iterations, seed);
+    }
+
+    if (argc > 1 && strcmp(argv[1], "fuzzcase") == 0)
+    {
+        if (argc < 3)
+        {
+            printf("usage: TileBench fuzzcase file\n");
+            return 1;
+        }
+        return runFuzzCase(argv[2]);
+    }
+
+    if (argc > 1 && strcmp(argv[1], "contour") == 0)
+    {
+        int size = argc > 2 ? atoi(argv[2]) : 10000;
+        return runContourBench(size > 0 ? size : 10000);
+    }
+
+    if (argc > 1 && strcmp(argv[1], "nav") == 0)
+    {
+        int size = argc > 2 ? atoi(argv[2]) : 4096;
+        return runNavBench(size > 0 ? size : 4096);
+    }
+
+    if (argc > 1 && strcmp(argv[1], "regions") == 0)
+    {
+        int size = argc > 2 ? atoi(argv[2]) : 4096;
+        return runRegionsBench(size > 0 ? size : 4096);
+    }
+
+    if (argc > 1 && strcmp(argv[1], "gen") == 0)
+    {
+        int size = argc > 2 ? atoi(argv[2]) : 32768;
+        unsigned int seed = argc > 3 ? static_cast<unsigned int>(atoi(argv[3])) : 1;
+        return runGenBench(size > 0 ? size : 32768, seed);
+    }
+
+    if (argc > 1 && strcmp(argv[1], "automaton") == 0)
+    {
+        int size = argc > 2 ? atoi(argv[2]) : 8192;
+        int steps = argc > 3 ? atoi(argv[3]) : 10;
+        return runAutomatonBench(size > 0 ? size : 8192, steps > 0 ? steps : 10);
+    }
+
+    int size = argc > 1 ? atoi(argv[1]) : 2048;
+    if (size <= 0) size = 2048;
+
+    printf("map %dx%d, %d strokes x %d tiles\n", size, size, STROKES, STROKE_LENGTH);
+    printf("%-10s %5s %10s %10s %10s %8s\n", "layout", "chunk", "stamp(ms)", "fill(ms)", "retile(ms)", "chunks");
+
+    runBench<ChunkMap<unsigned char, 3, RowMajorLayout> >(size);
+    runBench<ChunkMap<unsigned char, 3, MortonLayout> >(size);
+    runBench<ChunkMap<unsigned char, 4, RowMajorLayout> >(size);
+    runBench<ChunkMap<unsigned char, 4, MortonLayout> >(size);
+    runBench<ChunkMap<unsigned char, 5, RowMajorLayout> >(size);
+    runBench<ChunkMap<unsigned char, 5, MortonLayout> >(size);
+
+    return 0;
+}